@@ -0,0 +1,70 @@
+#!/usr/bin/env ruby
+# frozen_string_literal: true
+
+# Released under the MIT License.
+# Copyright, 2022, by Samuel Williams.
+
+# Shut down many idle connections, each with a fiber waiting for it to become readable, e.g. `benchmark/cancel.rb 50000`. Every fiber is woken by raising into it one at a time, and then (if supported) by `io_cancel`. Each connection needs two descriptors, so the count is limited by `ulimit -n`.
+
+$LOAD_PATH << File.expand_path("../lib", __dir__)
+$LOAD_PATH << File.expand_path("../ext", __dir__)
+
+require 'io/event'
+require 'socket'
+require 'fiber'
+
+soft, hard = Process.getrlimit(Process::RLIMIT_NOFILE)
+Process.setrlimit(Process::RLIMIT_NOFILE, hard) if soft < hard
+
+COUNT = [Integer(ARGV.pop || 50_000), (hard - 256) / 2].min
+
+def measure(selector, name, method)
+	connections = COUNT.times.map{UNIXSocket.pair}
+	woken = 0
+	
+	fibers = connections.map do |local, remote|
+		Fiber.new do
+			selector.io_wait(Fiber.current, local, IO::READABLE)
+		rescue Errno::ECANCELED
+			woken += 1
+		end
+	end
+	
+	fibers.each(&:transfer)
+	
+	# Otherwise, the garbage from the previous run is collected during this one:
+	GC.start
+	
+	start_time = Process.clock_gettime(Process::CLOCK_MONOTONIC)
+	
+	case method
+	when :raise
+		fibers.each do |fiber|
+			selector.raise(fiber, Errno::ECANCELED)
+		end
+	when :io_cancel
+		connections.each do |local, remote|
+			selector.io_cancel(local)
+		end
+	end
+	
+	while fibers.any?(&:alive?)
+		selector.select(0)
+	end
+	
+	duration = Process.clock_gettime(Process::CLOCK_MONOTONIC) - start_time
+	
+	puts "#{name} #{method}: woke #{woken}/#{COUNT} fibers in #{duration.round(3)}s (#{(woken / duration).round} fibers/s)"
+ensure
+	connections&.each{|sockets| sockets.each(&:close)}
+end
+
+IO::Event::Selector.constants.each do |name|
+	klass = IO::Event::Selector.const_get(name)
+	selector = klass.new(Fiber.current)
+	
+	measure(selector, name, :raise)
+	measure(selector, name, :io_cancel) if selector.respond_to?(:io_cancel)
+ensure
+	selector&.close
+end
@@ -0,0 +1,97 @@
+#!/usr/bin/env ruby
+# frozen_string_literal: true
+
+# Released under the MIT License.
+# Copyright, 2022, by Samuel Williams.
+
+# Send and receive many small datagrams over loopback, e.g. `benchmark/datagram.rb 1000000`. Selectors which support `io_recvmsg`/`io_sendmsg` transfer a batch of datagrams at a time, others use one system call per datagram. Set `SEGMENT=1` to send each batch as a single segmented write (`UDP_SEGMENT`) and receive it coalesced (`UDP_GRO`).
+
+$LOAD_PATH << File.expand_path("../lib", __dir__)
+$LOAD_PATH << File.expand_path("../ext", __dir__)
+
+require 'io/event'
+require 'socket'
+require 'fiber'
+
+COUNT = Integer(ARGV.pop || 100_000)
+BATCH = Integer(ENV.fetch('BATCH', 64))
+SIZE = Integer(ENV.fetch('SIZE', 64))
+SEGMENT = ENV.key?('SEGMENT')
+
+# Not defined by the socket extension:
+UDP_GRO = 104
+
+IO::Event::Selector.constants.each do |name|
+	klass = IO::Event::Selector.const_get(name)
+	selector = klass.new(Fiber.current)
+	batched = selector.respond_to?(:io_recvmsg)
+	
+	receiver = UDPSocket.new
+	receiver.bind("127.0.0.1", 0)
+	receiver.setsockopt(Socket::IPPROTO_UDP, UDP_GRO, 1) if SEGMENT
+	
+	sender = UDPSocket.new
+	sender.connect("127.0.0.1", receiver.local_address.ip_port)
+	
+	received = 0
+	
+	start_time = Process.clock_gettime(Process::CLOCK_MONOTONIC)
+	
+	reader = Fiber.new do
+		if batched
+			buffers = BATCH.times.map{IO::Buffer.new(SEGMENT ? BATCH * SIZE : SIZE)}
+			
+			while received < COUNT
+				selector.io_recvmsg(Fiber.current, receiver, buffers).each do |length, address, segment_size|
+					received += segment_size ? (length + segment_size - 1) / segment_size : 1
+				end
+			end
+		else
+			while received < COUNT
+				selector.io_wait(Fiber.current, receiver, IO::READABLE)
+				
+				while receiver.recvfrom_nonblock(SIZE, exception: false) != :wait_readable
+					received += 1
+				end
+			end
+		end
+	end
+	
+	writer = Fiber.new do
+		data = "." * SIZE
+		messages = BATCH.times.map{[IO::Buffer.for(data), SIZE]}
+		sent = 0
+		
+		while sent < COUNT
+			batch = messages.first(COUNT - sent)
+			
+			if batched and SEGMENT
+				selector.io_sendmsg(Fiber.current, sender, [[IO::Buffer.for(data * batch.size), SIZE * batch.size, nil, SIZE]])
+				sent += batch.size
+			elsif batched
+				sent += selector.io_sendmsg(Fiber.current, sender, batch)
+			else
+				batch.each{sender.send(data, 0)}
+				sent += batch.size
+			end
+			
+			# Give the reader a chance to catch up, otherwise the receive buffer will overflow:
+			selector.yield
+		end
+	end
+	
+	reader.transfer
+	writer.transfer
+	
+	while reader.alive?
+		# Datagrams can be dropped, in which case we stop once there is nothing left to receive:
+		break if selector.select(1).zero? and !writer.alive?
+	end
+	
+	duration = Process.clock_gettime(Process::CLOCK_MONOTONIC) - start_time
+	
+	puts "#{name}: #{received}/#{COUNT} datagrams in #{duration.round(2)}s (#{(received / duration).round} datagrams/s)"
+ensure
+	sender&.close
+	receiver&.close
+end
@@ -0,0 +1,53 @@
+#!/usr/bin/env ruby
+# frozen_string_literal: true
+
+# Released under the MIT License.
+# Copyright, 2022, by Samuel Williams.
+
+# Spawn and wait for many child processes concurrently, e.g. `benchmark/process_wait.rb 10000`.
+
+$LOAD_PATH << File.expand_path("../lib", __dir__)
+$LOAD_PATH << File.expand_path("../ext", __dir__)
+
+require 'io/event'
+require 'fiber'
+
+COUNT = Integer(ARGV.pop || 10_000)
+# Limit the number of simultaneous children, to stay within process and file descriptor limits:
+CONCURRENCY = Integer(ENV.fetch('CONCURRENCY', 100))
+
+IO::Event::Selector.constants.each do |name|
+	klass = IO::Event::Selector.const_get(name)
+	next unless klass.instance_methods.include?(:process_wait)
+	
+	selector = klass.new(Fiber.current)
+	remaining = COUNT
+	failures = 0
+	
+	start_time = Process.clock_gettime(Process::CLOCK_MONOTONIC)
+	
+	fibers = CONCURRENCY.times.map do
+		Fiber.new do
+			while remaining > 0
+				remaining -= 1
+				
+				pid = Process.spawn("true")
+				status = selector.process_wait(Fiber.current, pid, 0)
+				
+				failures += 1 unless status.success?
+			end
+		end
+	end
+	
+	fibers.each(&:transfer)
+	
+	while fibers.any?(&:alive?)
+		selector.select(1)
+	end
+	
+	duration = Process.clock_gettime(Process::CLOCK_MONOTONIC) - start_time
+	
+	puts "#{name}: #{COUNT} processes in #{duration.round(2)}s (#{(COUNT / duration).round} processes/s, #{failures} failures)"
+	
+	selector.close
+end
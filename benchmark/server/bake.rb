@@ -7,6 +7,9 @@ SERVERS = [
 	"compiled",
 	"event.rb",
 	"buffer.rb",
+	"file.rb",
+	"sendfile.rb",
+	"zerocopy.rb",
 	"loop.rb",
 	"async.rb",
 	"thread.rb",
@@ -20,8 +20,13 @@ Fiber.schedule do
 	server.listen(Socket::SOMAXCONN)
 	
 	loop do
-		peer, address = server.accept
-
+		# Accepting in batches avoids a wakeup per connection:
+		if scheduler.respond_to?(:io_accept)
+			peer = scheduler.io_accept(server)
+		else
+			peer = server.accept
+		end
+		
 		Fiber.schedule do
 			peer.readpartial(1024) rescue nil
 			peer.write(RESPONSE)
@@ -0,0 +1,48 @@
+#!/usr/bin/env ruby
+# frozen_string_literal: true
+
+# Released under the MIT License.
+# Copyright, 2021-2022, by Samuel Williams.
+
+# Serves a static file by reading it into a buffer and writing it to the peer. Compare with `sendfile.rb`.
+
+require_relative 'scheduler'
+require 'tempfile'
+
+scheduler = DirectScheduler.new
+Fiber.set_scheduler(scheduler)
+
+port = Integer(ARGV.pop || 9090)
+size = Integer(ENV.fetch('FILE_SIZE', 1024*64))
+
+FILE = Tempfile.new
+FILE.write("." * size)
+FILE.flush
+
+RESPONSE_STRING = "HTTP/1.1 200 OK\r\nContent-Length: #{size}\r\nConnection: close\r\n\r\n"
+
+REQUEST = IO::Buffer.new(1024)
+RESPONSE = IO::Buffer.new(RESPONSE_STRING.bytesize + size)
+
+RESPONSE_HEADER_SIZE = RESPONSE.set_string(RESPONSE_STRING)
+
+Fiber.schedule do
+	server = TCPServer.new('localhost', port)
+	server.listen(Socket::SOMAXCONN)
+	
+	loop do
+		peer, address = server.accept
+		
+		Fiber.schedule do
+			scheduler.io_read(peer, REQUEST, 1)
+			
+			File.open(FILE.path) do |file|
+				body = RESPONSE.slice(RESPONSE_HEADER_SIZE, size)
+				scheduler.io_read(file, body, size)
+			end
+			
+			scheduler.io_write(peer, RESPONSE, RESPONSE.size)
+			peer.close
+		end
+	end
+end
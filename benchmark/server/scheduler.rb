@@ -22,6 +22,10 @@ class Scheduler
 			instance_eval{undef io_close}
 		end
 		
+		unless @selector.respond_to?(:io_accept)
+			instance_eval{undef io_accept}
+		end
+		
 		@mutex = Mutex.new
 	end
 	
@@ -40,11 +44,20 @@ class Scheduler
 	ensure
 		@waiting.delete(fiber)
 	end
-
+	
 	def io_close(io)
 		@selector.io_close(io)
 	end
 	
+	# Not a fiber scheduler hook, so servers must call it directly.
+	def io_accept(server)
+		fiber = Fiber.current
+		@waiting[fiber] = server
+		@selector.io_accept(fiber, server)
+	ensure
+		@waiting.delete(fiber)
+	end
+	
 	def kernel_sleep(duration)
 		@selector.defer
 	end
@@ -78,7 +91,7 @@ class DirectScheduler < Scheduler
 	ensure
 		@waiting.delete(fiber)
 	end
-
+	
 	def io_write(io, buffer, length)
 		fiber = Fiber.current
 		@waiting[fiber] = io
@@ -86,4 +99,20 @@ class DirectScheduler < Scheduler
 	ensure
 		@waiting.delete(fiber)
 	end
+	
+	def io_sendfile(out, input, offset, length)
+		fiber = Fiber.current
+		@waiting[fiber] = out
+		@selector.io_sendfile(fiber, out, input, offset, length)
+	ensure
+		@waiting.delete(fiber)
+	end
+	
+	def io_write_zerocopy(io, buffer, length)
+		fiber = Fiber.current
+		@waiting[fiber] = io
+		@selector.io_write_zerocopy(fiber, io, buffer, length, 0)
+	ensure
+		@waiting.delete(fiber)
+	end
 end
@@ -0,0 +1,38 @@
+#!/usr/bin/env ruby
+# frozen_string_literal: true
+
+# Released under the MIT License.
+# Copyright, 2021-2022, by Samuel Williams.
+
+# Serves a large body from memory using `io_write_zerocopy`, so the kernel transmits it directly from the buffer. Compare with `buffer.rb`.
+
+require_relative 'scheduler'
+
+scheduler = DirectScheduler.new
+Fiber.set_scheduler(scheduler)
+
+port = Integer(ARGV.pop || 9090)
+size = Integer(ENV.fetch('BODY_SIZE', 1024*256))
+
+REQUEST = IO::Buffer.new(1024)
+RESPONSE = IO::Buffer.new(size + 128)
+
+RESPONSE_SIZE = RESPONSE.set_string("HTTP/1.1 200 OK\r\nContent-Length: #{size}\r\nConnection: close\r\n\r\n" + "." * size)
+
+Fiber.schedule do
+	server = TCPServer.new('localhost', port)
+	server.listen(Socket::SOMAXCONN)
+	
+	loop do
+		peer, address = server.accept
+		
+		Fiber.schedule do
+			scheduler.io_read(peer, REQUEST, 1)
+			
+			# Each connection locks the shared buffer while the kernel refers to it, so concurrent responses need their own slice:
+			scheduler.io_write_zerocopy(peer, RESPONSE.slice(0, RESPONSE_SIZE), RESPONSE_SIZE)
+			
+			peer.close
+		end
+	end
+end
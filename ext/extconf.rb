@@ -48,6 +48,7 @@ end
 
 if have_header('sys/epoll.h')
 	$srcs << "io/event/selector/epoll.c"
+	$srcs << "io/event/worker.c"
 end
 
 # The order matters, because we MUST have EV_UDATA_SPECIFIC.
@@ -56,6 +57,10 @@ if have_const('EV_UDATA_SPECIFIC', 'sys/event.h') and have_header('sys/event.h')
 	$srcs << "io/event/selector/kqueue.c"
 end
 
+if have_header('poll.h')
+	$srcs << "io/event/selector/poll.c"
+end
+
 have_header('sys/eventfd.h')
 $srcs << "io/event/interrupt.c"
 
@@ -64,6 +69,10 @@ have_func("&rb_process_status_wait")
 have_func("rb_fiber_current")
 have_func("&rb_fiber_raise")
 have_func("epoll_pwait2")
+have_func("ppoll")
+have_func("preadv2")
+have_func("memmem", "string.h")
+have_func("rb_fiber_scheduler_blocking_operation_extract", "ruby/fiber/scheduler.h")
 
 have_header('ruby/io/buffer.h')
 
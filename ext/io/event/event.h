@@ -37,3 +37,7 @@ void Init_IO_Event(void);
 #ifdef HAVE_SYS_EVENT_H
 #include "selector/kqueue.h"
 #endif
+
+#ifdef HAVE_POLL_H
+#include "selector/poll.h"
+#endif
@@ -21,10 +21,10 @@
 // static const int DEBUG = 0;
 
 #include "interrupt.h"
-#include <unistd.h>
-
 #include "selector/selector.h"
 
+#include <unistd.h>
+
 #ifdef HAVE_SYS_EVENTFD_H
 #include <sys/eventfd.h>
 
@@ -27,6 +27,18 @@
 
 #include "pidfd.c"
 #include "../interrupt.h"
+#include "../worker.h"
+
+#include <sys/uio.h>
+#include <sys/ioctl.h>
+#include <sys/sendfile.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <limits.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <linux/errqueue.h>
 
 enum {
 	DEBUG = 0,
@@ -36,11 +48,34 @@ static VALUE IO_Event_Selector_EPoll = Qnil;
 
 enum {EPOLL_MAX_EVENTS = 64};
 
+// The maximum number of threads used to execute blocking file operations:
+enum {EPOLL_MAX_WORKERS = 4};
+
 struct IO_Event_Selector_EPoll {
 	struct IO_Event_Selector backend;
 	int descriptor;
 	int blocked;
 	struct IO_Event_Interrupt interrupt;
+	
+	struct IO_Event_Selector_Descriptors descriptors;
+	
+	// Maps the pids of processes spawned by `process_spawn` to their pidfds:
+	st_table *pidfds;
+	
+	// Maps descriptors to the state of their in-progress (coalesced) `fsync` requests:
+	st_table *syncs;
+	
+	// Operations waiting with a deadline, which are resumed by `select` if they don't complete in time:
+	struct IO_Event_Selector_Timers timers;
+	
+	// Maps descriptors to the fibers waiting on them, so that `io_cancel` can wake them:
+	st_table *waiters;
+	
+	// Waiters released by `io_wait_many`, which are freed at the end of `select`:
+	struct io_wait_many *released;
+	
+	// Regular files can't be monitored by epoll, so operations on them are executed by the worker pool, which signals the interrupt when they complete:
+	struct IO_Event_Worker_Pool pool;
 };
 
 void IO_Event_Selector_EPoll_Type_mark(void *_data)
@@ -55,16 +90,29 @@ void close_internal(struct IO_Event_Selector_EPoll *data) {
 		close(data->descriptor);
 		data->descriptor = -1;
 		
+		// The workers signal the interrupt, so they must be stopped first:
+		IO_Event_Worker_Pool_close(&data->pool);
 		IO_Event_Interrupt_close(&data->interrupt);
 	}
+	
+	IO_Event_Selector_process_pidfds_free(&data->pidfds);
 }
 
+static void io_wait_many_free(struct io_wait_many **released);
+
 void IO_Event_Selector_EPoll_Type_free(void *_data)
 {
 	struct IO_Event_Selector_EPoll *data = _data;
 	
 	close_internal(data);
 	
+	IO_Event_Worker_Pool_free(&data->pool);
+	IO_Event_Selector_Descriptors_free(&data->descriptors);
+	IO_Event_Selector_syncs_free(&data->syncs);
+	IO_Event_Selector_Timers_free(&data->timers);
+	io_wait_many_free(&data->released);
+	IO_Event_Selector_Waiters_free(&data->waiters);
+	
 	free(data);
 }
 
@@ -91,6 +139,15 @@ VALUE IO_Event_Selector_EPoll_allocate(VALUE self) {
 	IO_Event_Selector_initialize(&data->backend, Qnil);
 	data->descriptor = -1;
 	
+	IO_Event_Selector_Descriptors_initialize(&data->descriptors);
+	data->pidfds = NULL;
+	data->syncs = NULL;
+	IO_Event_Selector_Timers_initialize(&data->timers);
+	data->waiters = NULL;
+	data->released = NULL;
+	
+	IO_Event_Worker_Pool_initialize(&data->pool, &data->interrupt, EPOLL_MAX_WORKERS);
+	
 	return instance;
 }
 
@@ -200,6 +257,8 @@ struct process_wait_arguments {
 	pid_t pid;
 	int flags;
 	int descriptor;
+	
+	struct IO_Event_Selector_Timer timer;
 };
 
 static
@@ -208,7 +267,7 @@ VALUE process_wait_transfer(VALUE _arguments) {
 	
 	IO_Event_Selector_fiber_transfer(arguments->data->backend.loop, 0, NULL);
 	
-	return IO_Event_Selector_process_status_wait(arguments->pid);
+	return IO_Event_Selector_process_status_wait(arguments->pid, arguments->flags);
 }
 
 static
@@ -219,26 +278,48 @@ VALUE process_wait_ensure(VALUE _arguments) {
 	
 	close(arguments->descriptor);
 	
+	IO_Event_Selector_Timers_remove(&arguments->data->timers, &arguments->timer);
+	
 	return Qnil;
 }
 
-VALUE IO_Event_Selector_EPoll_process_wait(VALUE self, VALUE fiber, VALUE pid, VALUE flags) {
+// Wait for the given process to exit. If a timeout (in seconds) is given and the process is still running when it expires, returns nil.
+VALUE IO_Event_Selector_EPoll_process_wait(int argc, VALUE *argv, VALUE self) {
 	struct IO_Event_Selector_EPoll *data = NULL;
 	TypedData_Get_Struct(self, struct IO_Event_Selector_EPoll, &IO_Event_Selector_EPoll_Type, data);
 	
+	rb_check_arity(argc, 3, 4);
+	
+	VALUE fiber = argv[0], pid = argv[1], flags = argv[2];
+	VALUE timeout = argc == 4 ? argv[3] : Qnil;
+	
 	struct process_wait_arguments process_wait_arguments = {
 		.data = data,
 		.pid = NUM2PIDT(pid),
 		.flags = NUM2INT(flags),
+		.timer = {.fiber = fiber, .index = SIZE_MAX},
 	};
 	
-	process_wait_arguments.descriptor = pidfd_open(process_wait_arguments.pid, 0);
+	// If the process was spawned by `process_spawn`, we already have a pidfd for it:
+	process_wait_arguments.descriptor = IO_Event_Selector_process_pidfd(data->pidfds, process_wait_arguments.pid);
 	
-	if (process_wait_arguments.descriptor == -1) {
-		rb_sys_fail("IO_Event_Selector_EPoll_process_wait:pidfd_open");
+	// If the process has already exited, we can avoid allocating a pidfd and registering it:
+	VALUE status = IO_Event_Selector_process_status_wait(process_wait_arguments.pid, process_wait_arguments.flags);
+	if (!NIL_P(status)) {
+		if (process_wait_arguments.descriptor >= 0) close(process_wait_arguments.descriptor);
+		
+		return status;
 	}
 	
-	rb_update_max_fd(process_wait_arguments.descriptor);
+	if (process_wait_arguments.descriptor == -1) {
+		process_wait_arguments.descriptor = pidfd_open(process_wait_arguments.pid, 0);
+		
+		if (process_wait_arguments.descriptor == -1) {
+			rb_sys_fail("IO_Event_Selector_EPoll_process_wait:pidfd_open");
+		}
+		
+		rb_update_max_fd(process_wait_arguments.descriptor);
+	}
 	
 	struct epoll_event event = {
 		.events = EPOLLIN|EPOLLERR|EPOLLHUP|EPOLLONESHOT,
@@ -252,9 +333,23 @@ VALUE IO_Event_Selector_EPoll_process_wait(VALUE self, VALUE fiber, VALUE pid, V
 		rb_sys_fail("IO_Event_Selector_EPoll_process_wait:epoll_ctl");
 	}
 	
+	if (IO_Event_Selector_deadline(timeout, &process_wait_arguments.timer.deadline)) {
+		IO_Event_Selector_Timers_add(&data->timers, &process_wait_arguments.timer);
+	}
+	
 	return rb_ensure(process_wait_transfer, (VALUE)&process_wait_arguments, process_wait_ensure, (VALUE)&process_wait_arguments);
 }
 
+VALUE IO_Event_Selector_EPoll_process_spawn(int argc, VALUE *argv, VALUE self) {
+	struct IO_Event_Selector_EPoll *data = NULL;
+	TypedData_Get_Struct(self, struct IO_Event_Selector_EPoll, &IO_Event_Selector_EPoll_Type, data);
+	
+	rb_check_arity(argc, 2, UNLIMITED_ARGUMENTS);
+	
+	// The first argument is the fiber, which is not needed since spawning doesn't block:
+	return IO_Event_Selector_process_spawn(&data->pidfds, argc - 1, argv + 1);
+}
+
 static inline
 uint32_t epoll_flags_from_events(int events) {
 	uint32_t flags = 0;
@@ -263,6 +358,9 @@ uint32_t epoll_flags_from_events(int events) {
 	if (events & IO_EVENT_PRIORITY) flags |= EPOLLPRI;
 	if (events & IO_EVENT_WRITABLE) flags |= EPOLLOUT;
 	
+	// The peer shutting down its side of the connection is only reported if requested:
+	if (events & IO_EVENT_HANGUP) flags |= EPOLLRDHUP;
+	
 	flags |= EPOLLHUP;
 	flags |= EPOLLERR;
 	
@@ -274,8 +372,9 @@ uint32_t epoll_flags_from_events(int events) {
 	return flags;
 }
 
+// Convert the flags reported by epoll into events. Hangups and errors are always reported as readable for compatibility, but are also reported separately if they were requested.
 static inline
-int events_from_epoll_flags(uint32_t flags) {
+int events_from_epoll_flags(uint32_t flags, int requested) {
 	int events = 0;
 	
 	if (DEBUG) fprintf(stderr, "events_from_epoll_flags flags=%d\n", flags);
@@ -286,13 +385,23 @@ int events_from_epoll_flags(uint32_t flags) {
 	if (flags & EPOLLPRI) events |= IO_EVENT_PRIORITY;
 	if (flags & EPOLLOUT) events |= IO_EVENT_WRITABLE;
 	
+	if (flags & (EPOLLHUP|EPOLLRDHUP)) events |= (requested & IO_EVENT_HANGUP);
+	if (flags & EPOLLERR) events |= (requested & IO_EVENT_ERROR);
+	
 	return events;
 }
 
 struct io_wait_arguments {
 	struct IO_Event_Selector_EPoll *data;
+	int events;
 	int descriptor;
 	int duplicate;
+	
+	// Whether cancellation by `io_cancel` raises `Errno::ECANCELED`, rather than returning nil:
+	int raise_cancelled;
+	
+	struct IO_Event_Selector_Timer timer;
+	struct IO_Event_Selector_Waiter waiter;
 };
 
 static
@@ -307,6 +416,9 @@ VALUE io_wait_ensure(VALUE _arguments) {
 		epoll_ctl(arguments->data->descriptor, EPOLL_CTL_DEL, arguments->descriptor, NULL);
 	}
 	
+	IO_Event_Selector_Timers_remove(&arguments->data->timers, &arguments->timer);
+	IO_Event_Selector_Waiter_remove(&arguments->data->backend, &arguments->data->waiters, &arguments->waiter);
+	
 	return Qnil;
 };
 
@@ -318,7 +430,15 @@ VALUE io_wait_transfer(VALUE _arguments) {
 	
 	if (DEBUG) fprintf(stderr, "io_wait_transfer errno=%d\n", errno);
 	
-	// If the fiber is being cancelled, it might be resumed with nil:
+	// If the descriptor was cancelled by `io_cancel` before it became ready, the fiber is resumed from the ready queue:
+	if (NIL_P(result) && arguments->waiter.cancelled) {
+		if (!arguments->raise_cancelled) return Qnil;
+		
+		// Many fibers may be cancelled at once, so we avoid formatting a message for each of them:
+		rb_syserr_fail(ECANCELED, NULL);
+	}
+	
+	// If the fiber is being cancelled, it might be resumed with nil, or false if the deadline expired:
 	if (!RTEST(result)) {
 		if (DEBUG) fprintf(stderr, "io_wait_transfer flags=false\n");
 		return Qfalse;
@@ -326,10 +446,12 @@ VALUE io_wait_transfer(VALUE _arguments) {
 	
 	if (DEBUG) fprintf(stderr, "io_wait_transfer flags=%d\n", NUM2INT(result));
 	
-	return INT2NUM(events_from_epoll_flags(NUM2INT(result)));
+	return INT2NUM(events_from_epoll_flags(NUM2INT(result), arguments->events));
 };
 
-VALUE IO_Event_Selector_EPoll_io_wait(VALUE self, VALUE fiber, VALUE io, VALUE events) {
+// Wait for the given events, or until the deadline (if not NULL) expires, in which case false is returned. If cancelled by `io_cancel`, either raises `Errno::ECANCELED` or returns nil.
+static
+VALUE io_wait_events(VALUE self, VALUE fiber, VALUE io, VALUE events, struct timespec *deadline, int raise_cancelled) {
 	struct IO_Event_Selector_EPoll *data = NULL;
 	TypedData_Get_Struct(self, struct IO_Event_Selector_EPoll, &IO_Event_Selector_EPoll_Type, data);
 	
@@ -378,204 +500,2043 @@ VALUE IO_Event_Selector_EPoll_io_wait(VALUE self, VALUE fiber, VALUE io, VALUE e
 	
 	struct io_wait_arguments io_wait_arguments = {
 		.data = data,
+		.events = NUM2INT(events),
 		.descriptor = descriptor,
-		.duplicate = duplicate
+		.duplicate = duplicate,
+		.raise_cancelled = raise_cancelled,
+		.timer = {.fiber = fiber, .index = SIZE_MAX},
 	};
 	
+	if (deadline) {
+		io_wait_arguments.timer.deadline = *deadline;
+		IO_Event_Selector_Timers_add(&data->timers, &io_wait_arguments.timer);
+	}
+	
+	IO_Event_Selector_Waiter_add(&data->waiters, &io_wait_arguments.waiter, fiber, IO_Event_Selector_io_descriptor(io));
+	
 	return rb_ensure(io_wait_transfer, (VALUE)&io_wait_arguments, io_wait_ensure, (VALUE)&io_wait_arguments);
 }
 
-#ifdef HAVE_RUBY_IO_BUFFER_H
+static
+VALUE io_wait(VALUE self, VALUE fiber, VALUE io, VALUE events, struct timespec *deadline) {
+	return io_wait_events(self, fiber, io, events, deadline, 1);
+}
 
-struct io_read_arguments {
-	VALUE self;
+// Like `io_wait`, but returns nil if cancelled by `io_cancel`, so that operations which return an error code can fail with -ECANCELED as they do on io_uring.
+static
+VALUE io_wait_operation(VALUE self, VALUE fiber, VALUE io, VALUE events, struct timespec *deadline) {
+	return io_wait_events(self, fiber, io, events, deadline, 0);
+}
+
+VALUE IO_Event_Selector_EPoll_io_wait(VALUE self, VALUE fiber, VALUE io, VALUE events) {
+	return io_wait(self, fiber, io, events, NULL);
+}
+
+// Wait for the given events. If a timeout (in seconds) is given and none of the events occur before it expires, returns false.
+VALUE IO_Event_Selector_EPoll_io_wait_compatible(int argc, VALUE *argv, VALUE self)
+{
+	rb_check_arity(argc, 3, 4);
+	
+	struct timespec storage;
+	struct timespec *deadline = IO_Event_Selector_deadline(argc == 4 ? argv[3] : Qnil, &storage);
+	
+	return io_wait(self, argv[0], argv[1], argv[2], deadline);
+}
+
+struct io_select_arguments {
+	struct IO_Event_Selector_EPoll *data;
 	VALUE fiber;
-	VALUE io;
 	
-	int flags;
+	struct IO_Event_Selector_IO_Select select;
 	
+	// All the descriptors are registered with a nested epoll instance, which becomes readable when any of them are ready, so that the fiber is only resumed once:
 	int descriptor;
 	
-	VALUE buffer;
-	size_t length;
-	size_t offset;
+	VALUE timeout;
+	struct timespec *deadline;
 };
 
 static
-VALUE io_read_loop(VALUE _arguments) {
-	struct io_read_arguments *arguments = (struct io_read_arguments *)_arguments;
+VALUE io_select_loop(VALUE _arguments) {
+	struct io_select_arguments *arguments = (struct io_select_arguments *)_arguments;
+	struct IO_Event_Selector_EPoll *data = arguments->data;
 	
-	void *base;
-	size_t size;
-	rb_io_buffer_get_bytes_for_writing(arguments->buffer, &base, &size);
+	VALUE ready = IO_Event_Selector_IO_Select_ready(&arguments->select);
+	if (!NIL_P(ready)) return ready;
 	
-	size_t length = arguments->length;
-	size_t offset = arguments->offset;
+	if (!NIL_P(arguments->timeout) && NUM2DBL(arguments->timeout) <= 0) {
+		return Qnil;
+	}
+	
+	arguments->descriptor = IO_Event_Selector_IO_Select_epoll(&arguments->select);
 	
 	while (true) {
-		size_t maximum_size = size - offset;
-		ssize_t result = read(arguments->descriptor, (char*)base+offset, maximum_size);
+		struct epoll_event event = {.events = EPOLLIN|EPOLLONESHOT, .data.ptr = (void*)arguments->fiber};
 		
-		if (result > 0) {
-			offset += result;
-			if ((size_t)result >= length) break;
-			length -= result;
-		} else if (result == 0) {
-			break;
-		} else if (length > 0 && IO_Event_try_again(errno)) {
-			IO_Event_Selector_EPoll_io_wait(arguments->self, arguments->fiber, arguments->io, RB_INT2NUM(IO_EVENT_READABLE));
-		} else {
-			return rb_fiber_scheduler_io_result(-1, errno);
+		if (epoll_ctl(data->descriptor, EPOLL_CTL_ADD, arguments->descriptor, &event) == -1) {
+			rb_sys_fail("IO_Event_Selector_EPoll_io_select:epoll_ctl");
 		}
+		
+		struct io_wait_arguments io_wait_arguments = {
+			.data = data,
+			.events = IO_EVENT_READABLE,
+			.descriptor = arguments->descriptor,
+			.duplicate = -1,
+			.timer = {.fiber = arguments->fiber, .index = SIZE_MAX},
+		};
+		
+		if (arguments->deadline) {
+			io_wait_arguments.timer.deadline = *arguments->deadline;
+			IO_Event_Selector_Timers_add(&data->timers, &io_wait_arguments.timer);
+		}
+		
+		VALUE events = rb_ensure(io_wait_transfer, (VALUE)&io_wait_arguments, io_wait_ensure, (VALUE)&io_wait_arguments);
+		
+		if (!RTEST(events)) return Qnil;
+		
+		// Another fiber may have consumed the readiness before we were resumed:
+		ready = IO_Event_Selector_IO_Select_ready(&arguments->select);
+		if (!NIL_P(ready)) return ready;
 	}
-	
-	return rb_fiber_scheduler_io_result(offset, 0);
 }
 
 static
-VALUE io_read_ensure(VALUE _arguments) {
-	struct io_read_arguments *arguments = (struct io_read_arguments *)_arguments;
+VALUE io_select_ensure(VALUE _arguments) {
+	struct io_select_arguments *arguments = (struct io_select_arguments *)_arguments;
+	
+	if (arguments->descriptor >= 0) {
+		close(arguments->descriptor);
+	}
 	
-	IO_Event_Selector_nonblock_restore(arguments->descriptor, arguments->flags);
+	IO_Event_Selector_IO_Select_free(&arguments->select);
 	
 	return Qnil;
 }
 
-VALUE IO_Event_Selector_EPoll_io_read(VALUE self, VALUE fiber, VALUE io, VALUE buffer, VALUE _length, VALUE _offset) {
-	int descriptor = IO_Event_Selector_io_descriptor(io);
+// Wait until any of the given IOs are ready, or the timeout (in seconds, or nil to wait indefinitely) expires, returning `[readable, writable, priority]` like `IO.select`, or nil if the timeout expired.
+VALUE IO_Event_Selector_EPoll_io_select(VALUE self, VALUE readable, VALUE writable, VALUE priority, VALUE timeout) {
+	struct IO_Event_Selector_EPoll *data = NULL;
+	TypedData_Get_Struct(self, struct IO_Event_Selector_EPoll, &IO_Event_Selector_EPoll_Type, data);
 	
-	size_t offset = NUM2SIZET(_offset);
-	size_t length = NUM2SIZET(_length);
+	struct timespec storage;
 	
-	struct io_read_arguments io_read_arguments = {
-		.self = self,
-		.fiber = fiber,
-		.io = io,
-		
-		.flags = IO_Event_Selector_nonblock_set(descriptor),
-		.descriptor = descriptor,
-		.buffer = buffer,
-		.length = length,
-		.offset = offset,
+	struct io_select_arguments io_select_arguments = {
+		.data = data,
+		.fiber = IO_Event_Selector_fiber_current(),
+		.descriptor = -1,
+		.timeout = timeout,
+		.deadline = IO_Event_Selector_deadline(timeout, &storage),
 	};
 	
-	return rb_ensure(io_read_loop, (VALUE)&io_read_arguments, io_read_ensure, (VALUE)&io_read_arguments);
+	IO_Event_Selector_IO_Select_initialize(&io_select_arguments.select, readable, writable, priority);
+	
+	return rb_ensure(io_select_loop, (VALUE)&io_select_arguments, io_select_ensure, (VALUE)&io_select_arguments);
 }
 
-VALUE IO_Event_Selector_EPoll_io_read_compatible(int argc, VALUE *argv, VALUE self)
-{
-	rb_check_arity(argc, 4, 5);
+// Registrations made by `io_wait_many` refer to an entry rather than a fiber, and are tagged so that `select` can distinguish them:
+#define IO_EVENT_EPOLL_WAIT_MANY_TAG ((uintptr_t)1)
+
+struct io_wait_many_entry {
+	struct io_wait_many *waiter;
 	
-	VALUE _offset = SIZET2NUM(0);
+	VALUE io;
+	int events;
 	
-	if (argc == 5) {
-		_offset = argv[4];
+	int descriptor;
+	int duplicate;
+	int registered;
+};
+
+// The waiter is shared by the registrations of all its descriptors, so that whichever becomes ready first resumes the fiber exactly once:
+struct io_wait_many {
+	VALUE fiber;
+	
+	// The entry which became ready first, and the events it reported:
+	struct io_wait_many_entry *ready;
+	int events;
+	
+	// Events for the other descriptors may be reported in the same batch as the one which resumed the fiber, so released waiters are only freed at the end of `select`:
+	struct io_wait_many *next;
+	
+	size_t count;
+	struct io_wait_many_entry entries[];
+};
+
+static
+void io_wait_many_free(struct io_wait_many **released) {
+	while (*released) {
+		struct io_wait_many *waiter = *released;
+		*released = waiter->next;
+		
+		free(waiter);
 	}
+}
+
+static
+void io_wait_many_ready(struct io_wait_many_entry *entry, uint32_t flags) {
+	struct io_wait_many *waiter = entry->waiter;
+	
+	// Only the first entry to become ready resumes the fiber:
+	if (waiter->ready || NIL_P(waiter->fiber)) return;
 	
-	return IO_Event_Selector_EPoll_io_read(self, argv[0], argv[1], argv[2], argv[3], _offset);
+	waiter->ready = entry;
+	waiter->events = events_from_epoll_flags(flags, entry->events);
+	
+	VALUE result = Qtrue;
+	IO_Event_Selector_fiber_transfer(waiter->fiber, 1, &result);
 }
 
-struct io_write_arguments {
-	VALUE self;
-	VALUE fiber;
-	VALUE io;
+struct io_wait_many_arguments {
+	struct IO_Event_Selector_EPoll *data;
 	
-	int flags;
+	VALUE pairs;
+	size_t count;
 	
-	int descriptor;
+	struct io_wait_many *waiter;
 	
-	VALUE buffer;
-	size_t length;
-	size_t offset;
+	struct timespec *deadline;
+	struct IO_Event_Selector_Timer timer;
 };
 
 static
-VALUE io_write_loop(VALUE _arguments) {
-	struct io_write_arguments *arguments = (struct io_write_arguments *)_arguments;
+void io_wait_many_register(struct IO_Event_Selector_EPoll *data, struct io_wait_many_entry *entry) {
+	struct epoll_event event = {
+		.events = epoll_flags_from_events(entry->events),
+		.data = {.ptr = (void*)((uintptr_t)entry | IO_EVENT_EPOLL_WAIT_MANY_TAG)},
+	};
 	
-	const void *base;
-	size_t size;
-	rb_io_buffer_get_bytes_for_reading(arguments->buffer, &base, &size);
+	int result = epoll_ctl(data->descriptor, EPOLL_CTL_ADD, entry->descriptor, &event);
 	
-	size_t length = arguments->length;
-	size_t offset = arguments->offset;
+	if (result == -1 && errno == EEXIST) {
+		// Another fiber is already waiting on this descriptor, so register a duplicate:
+		entry->duplicate = dup(entry->descriptor);
+		
+		if (entry->duplicate == -1) {
+			rb_sys_fail("IO_Event_Selector_EPoll_io_wait_many:dup");
+		}
+		
+		rb_update_max_fd(entry->duplicate);
+		
+		result = epoll_ctl(data->descriptor, EPOLL_CTL_ADD, entry->duplicate, &event);
+	}
 	
-	if (length > size) {
-		rb_raise(rb_eRuntimeError, "Length exceeds size of buffer!");
+	if (result == -1) {
+		// Regular files can't be monitored, but they are always ready:
+		if (errno == EPERM) {
+			entry->waiter->ready = entry;
+			entry->waiter->events = entry->events;
+			
+			return;
+		}
+		
+		rb_sys_fail("IO_Event_Selector_EPoll_io_wait_many:epoll_ctl");
 	}
 	
-	while (true) {
-		size_t maximum_size = size - offset;
-		ssize_t result = write(arguments->descriptor, (char*)base+offset, maximum_size);
+	entry->registered = 1;
+}
+
+static
+VALUE io_wait_many_transfer(VALUE _arguments) {
+	struct io_wait_many_arguments *arguments = (struct io_wait_many_arguments *)_arguments;
+	struct IO_Event_Selector_EPoll *data = arguments->data;
+	struct io_wait_many *waiter = arguments->waiter;
+	
+	for (size_t i = 0; i < arguments->count && !waiter->ready; i += 1) {
+		VALUE pair = RARRAY_AREF(arguments->pairs, i);
+		Check_Type(pair, T_ARRAY);
 		
-		if (result > 0) {
-			offset += result;
-			if ((size_t)result >= length) break;
-			length -= result;
-		} else if (result == 0) {
-			break;
-		} else if (length > 0 && IO_Event_try_again(errno)) {
-			IO_Event_Selector_EPoll_io_wait(arguments->self, arguments->fiber, arguments->io, RB_INT2NUM(IO_EVENT_WRITABLE));
-		} else {
-			return rb_fiber_scheduler_io_result(-1, errno);
+		struct io_wait_many_entry *entry = &waiter->entries[i];
+		entry->waiter = waiter;
+		entry->io = rb_ary_entry(pair, 0);
+		entry->events = NUM2INT(rb_ary_entry(pair, 1));
+		entry->descriptor = IO_Event_Selector_io_descriptor(entry->io);
+		entry->duplicate = -1;
+		
+		// The entry must be fully initialized before it is counted, as the ensure handler deregisters every counted entry:
+		waiter->count += 1;
+		
+		io_wait_many_register(data, entry);
+	}
+	
+	if (waiter->ready) {
+		// Regular files are always ready, but give other fibers a chance to run, as `io_wait` does:
+		IO_Event_Selector_queue_push(&data->backend, waiter->fiber);
+		IO_Event_Selector_yield(&data->backend);
+	} else {
+		if (arguments->deadline) {
+			arguments->timer.deadline = *arguments->deadline;
+			IO_Event_Selector_Timers_add(&data->timers, &arguments->timer);
 		}
+		
+		VALUE result = IO_Event_Selector_fiber_transfer(data->backend.loop, 0, NULL);
+		
+		// If the fiber is being cancelled, it might be resumed with nil, or false if the deadline expired:
+		if (!RTEST(result)) return Qfalse;
 	}
 	
-	return rb_fiber_scheduler_io_result(offset, 0);
-};
+	if (!waiter->ready) return Qfalse;
+	
+	return rb_ary_new_from_args(2, waiter->ready->io, INT2NUM(waiter->events));
+}
 
 static
-VALUE io_write_ensure(VALUE _arguments) {
-	struct io_write_arguments *arguments = (struct io_write_arguments *)_arguments;
+VALUE io_wait_many_ensure(VALUE _arguments) {
+	struct io_wait_many_arguments *arguments = (struct io_wait_many_arguments *)_arguments;
+	struct IO_Event_Selector_EPoll *data = arguments->data;
+	struct io_wait_many *waiter = arguments->waiter;
+	
+	for (size_t i = 0; i < waiter->count; i += 1) {
+		struct io_wait_many_entry *entry = &waiter->entries[i];
+		
+		if (entry->duplicate >= 0) {
+			if (entry->registered) epoll_ctl(data->descriptor, EPOLL_CTL_DEL, entry->duplicate, NULL);
+			
+			close(entry->duplicate);
+		} else if (entry->registered) {
+			epoll_ctl(data->descriptor, EPOLL_CTL_DEL, entry->descriptor, NULL);
+		}
+	}
+	
+	IO_Event_Selector_Timers_remove(&data->timers, &arguments->timer);
 	
-	IO_Event_Selector_nonblock_restore(arguments->descriptor, arguments->flags);
+	waiter->fiber = Qnil;
+	waiter->next = data->released;
+	data->released = waiter;
 	
 	return Qnil;
-};
+}
 
-VALUE IO_Event_Selector_EPoll_io_write(VALUE self, VALUE fiber, VALUE io, VALUE buffer, VALUE _length, VALUE _offset) {
-	int descriptor = IO_Event_Selector_io_descriptor(io);
+// Wait for the first of several `[io, events]` pairs to become ready, returning `[io, events]` for it, or false if the timeout (in seconds) expires first. Every descriptor is registered with the same waiter, so the fiber is only resumed once.
+VALUE IO_Event_Selector_EPoll_io_wait_many(int argc, VALUE *argv, VALUE self) {
+	struct IO_Event_Selector_EPoll *data = NULL;
+	TypedData_Get_Struct(self, struct IO_Event_Selector_EPoll, &IO_Event_Selector_EPoll_Type, data);
 	
-	size_t length = NUM2SIZET(_length);
-	size_t offset = NUM2SIZET(_offset);
+	rb_check_arity(argc, 2, 3);
 	
-	struct io_write_arguments io_write_arguments = {
-		.self = self,
-		.fiber = fiber,
-		.io = io,
-		
-		.flags = IO_Event_Selector_nonblock_set(descriptor),
-		.descriptor = descriptor,
-		.buffer = buffer,
-		.length = length,
-		.offset = offset,
+	VALUE fiber = argv[0], pairs = argv[1];
+	Check_Type(pairs, T_ARRAY);
+	
+	// Nothing could ever wake us up:
+	if (RARRAY_LEN(pairs) == 0) {
+		rb_raise(rb_eArgError, "No IOs to wait for!");
+	}
+	
+	struct timespec storage;
+	
+	struct io_wait_many_arguments io_wait_many_arguments = {
+		.data = data,
+		.pairs = pairs,
+		.count = RARRAY_LEN(pairs),
+		.deadline = IO_Event_Selector_deadline(argc == 3 ? argv[2] : Qnil, &storage),
+		.timer = {.fiber = fiber, .index = SIZE_MAX},
 	};
 	
-	return rb_ensure(io_write_loop, (VALUE)&io_write_arguments, io_write_ensure, (VALUE)&io_write_arguments);
+	struct io_wait_many *waiter = calloc(1, sizeof(struct io_wait_many) + io_wait_many_arguments.count * sizeof(struct io_wait_many_entry));
+	if (waiter == NULL) rb_sys_fail("IO_Event_Selector_EPoll_io_wait_many:calloc");
+	
+	waiter->fiber = fiber;
+	io_wait_many_arguments.waiter = waiter;
+	
+	return rb_ensure(io_wait_many_transfer, (VALUE)&io_wait_many_arguments, io_wait_many_ensure, (VALUE)&io_wait_many_arguments);
 }
 
-VALUE IO_Event_Selector_EPoll_io_write_compatible(int argc, VALUE *argv, VALUE self)
-{
-	rb_check_arity(argc, 4, 5);
+// Wake every fiber waiting on the given IO, unless their operation has already completed. Waits raise `Errno::ECANCELED`, while reads and writes return -ECANCELED. Returns the number of fibers which were woken.
+VALUE IO_Event_Selector_EPoll_io_cancel(VALUE self, VALUE io) {
+	struct IO_Event_Selector_EPoll *data = NULL;
+	TypedData_Get_Struct(self, struct IO_Event_Selector_EPoll, &IO_Event_Selector_EPoll_Type, data);
 	
-	VALUE _offset = SIZET2NUM(0);
+	int descriptor = IO_Event_Selector_io_descriptor(io);
+	size_t count = 0;
 	
-	if (argc == 5) {
-		_offset = argv[4];
+	// The fibers remove their own registrations when they are resumed:
+	struct IO_Event_Selector_Waiter *waiter = IO_Event_Selector_Waiters_cancel(&data->backend, &data->waiters, descriptor);
+	
+	for (; waiter; waiter = waiter->next) {
+		count += 1;
 	}
 	
-	return IO_Event_Selector_EPoll_io_write(self, argv[0], argv[1], argv[2], argv[3], _offset);
+	return SIZET2NUM(count);
 }
 
-#endif
+// Forget the cached state of the descriptor, as it may be reused once closed. The IO is not closed, so false is returned and Ruby closes it as usual.
+VALUE IO_Event_Selector_EPoll_io_close(VALUE self, VALUE io) {
+	struct IO_Event_Selector_EPoll *data = NULL;
+	TypedData_Get_Struct(self, struct IO_Event_Selector_EPoll, &IO_Event_Selector_EPoll_Type, data);
+	
+	IO_Event_Selector_Descriptors_forget(&data->descriptors, IO_Event_Selector_io_descriptor(io));
+	
+	return Qfalse;
+}
 
+// Connections which were accepted ahead of time are kept on the server in a hidden instance variable, so they are closed by the garbage collector if they are never used:
+static ID id_accepted;
+
+// Accept every pending connection, so that subsequent calls to `io_accept` don't need to wait for readiness.
 static
-struct timespec * make_timeout(VALUE duration, struct timespec * storage) {
-	if (duration == Qnil) {
-		return NULL;
-	}
+void io_accept_drain(VALUE server, int descriptor) {
+	VALUE accepted = Qnil;
 	
-	if (FIXNUM_P(duration)) {
+	while (true) {
+		int result = accept4(descriptor, NULL, NULL, SOCK_NONBLOCK|SOCK_CLOEXEC);
+		
+		if (result == -1) {
+			if (errno == EINTR) continue;
+			
+			// Any other error will be reported by the next call to `io_accept`:
+			break;
+		}
+		
+		if (NIL_P(accepted)) {
+			accepted = rb_ivar_get(server, id_accepted);
+			
+			if (NIL_P(accepted)) {
+				accepted = rb_ary_new();
+				rb_ivar_set(server, id_accepted, accepted);
+			}
+		}
+		
+		rb_ary_push(accepted, IO_Event_Selector_socket_for_fd(result));
+	}
+}
+
+static
+VALUE io_accept_shift(VALUE server) {
+	VALUE accepted = rb_ivar_get(server, id_accepted);
+	
+	if (!NIL_P(accepted)) {
+		return rb_ary_shift(accepted);
+	}
+	
+	return Qnil;
+}
+
+// Accept a connection from the given server, returning a `Socket`. Every readiness event drains the accept queue, and the extra connections are returned by subsequent calls.
+VALUE IO_Event_Selector_EPoll_io_accept(VALUE self, VALUE fiber, VALUE server) {
+	VALUE socket = io_accept_shift(server);
+	if (!NIL_P(socket)) return socket;
+	
+	int descriptor = IO_Event_Selector_io_descriptor(server);
+	
+	while (true) {
+		int result = accept4(descriptor, NULL, NULL, SOCK_NONBLOCK|SOCK_CLOEXEC);
+		
+		if (result >= 0) {
+			socket = IO_Event_Selector_socket_for_fd(result);
+			io_accept_drain(server, descriptor);
+			
+			return socket;
+		} else if (errno == EINTR) {
+			continue;
+		} else if (IO_Event_try_again(errno)) {
+			IO_Event_Selector_EPoll_io_wait(self, fiber, server, RB_INT2NUM(IO_EVENT_READABLE));
+			
+			// Another fiber may have drained the accept queue while we were waiting:
+			socket = io_accept_shift(server);
+			if (!NIL_P(socket)) return socket;
+		} else {
+			rb_sys_fail("IO_Event_Selector_EPoll_io_accept:accept4");
+		}
+	}
+}
+
+#pragma mark - Worker Pool
+
+struct worker_wait_arguments {
+	struct IO_Event_Selector_EPoll *data;
+	struct IO_Event_Worker_Job *job;
+	
+	int executed;
+};
+
+static
+VALUE worker_wait_transfer(VALUE _arguments) {
+	struct worker_wait_arguments *arguments = (struct worker_wait_arguments *)_arguments;
+	
+	IO_Event_Selector_fiber_transfer(arguments->data->backend.loop, 0, NULL);
+	
+	return Qnil;
+}
+
+static
+VALUE worker_wait_ensure(VALUE _arguments) {
+	struct worker_wait_arguments *arguments = (struct worker_wait_arguments *)_arguments;
+	
+	// If the fiber was cancelled, the job may still be pending or running, and it refers to memory owned by the caller:
+	arguments->executed = IO_Event_Worker_Pool_cancel(&arguments->data->pool, arguments->job);
+	
+	return Qnil;
+}
+
+// Execute the job on the worker pool, transferring to the event loop until it completes. Returns true if the job was executed.
+static
+int worker_execute(struct IO_Event_Selector_EPoll *data, VALUE fiber, struct IO_Event_Worker_Job *job) {
+	job->fiber = fiber;
+	
+	IO_Event_Worker_Pool_submit(&data->pool, job);
+	
+	struct worker_wait_arguments worker_wait_arguments = {
+		.data = data,
+		.job = job,
+	};
+	
+	rb_ensure(worker_wait_transfer, (VALUE)&worker_wait_arguments, worker_wait_ensure, (VALUE)&worker_wait_arguments);
+	
+	return worker_wait_arguments.executed;
+}
+
+#ifdef HAVE_RB_FIBER_SCHEDULER_BLOCKING_OPERATION_EXTRACT
+struct blocking_operation_job {
+	struct IO_Event_Worker_Job job;
+	
+	rb_fiber_scheduler_blocking_operation_t *blocking_operation;
+};
+
+static
+void blocking_operation_job_function(struct IO_Event_Worker_Job *_job) {
+	struct blocking_operation_job *job = (struct blocking_operation_job *)_job;
+	
+	rb_fiber_scheduler_blocking_operation_execute(job->blocking_operation);
+}
+
+VALUE IO_Event_Selector_EPoll_blocking_operation_wait(VALUE self, VALUE fiber, VALUE work) {
+	struct IO_Event_Selector_EPoll *data = NULL;
+	TypedData_Get_Struct(self, struct IO_Event_Selector_EPoll, &IO_Event_Selector_EPoll_Type, data);
+	
+	struct blocking_operation_job job = {
+		.job = {.function = blocking_operation_job_function},
+		.blocking_operation = rb_fiber_scheduler_blocking_operation_extract(work),
+	};
+	
+	if (job.blocking_operation == NULL) {
+		rb_raise(rb_eArgError, "Invalid blocking operation!");
+	}
+	
+	worker_execute(data, fiber, &job.job);
+	
+	return Qnil;
+}
+#endif
+
+// epoll can't perform file system operations asynchronously, so they are executed on the worker pool:
+struct file_job {
+	struct IO_Event_Worker_Job job;
+	
+	const char *path;
+	const char *other;
+	int descriptor;
+	int flags;
+	mode_t mode;
+	struct stat status;
+	
+	int result;
+	int error;
+};
+
+static
+void file_open_job_function(struct IO_Event_Worker_Job *_job) {
+	struct file_job *job = (struct file_job *)_job;
+	
+	job->result = open(job->path, job->flags, job->mode);
+	if (job->result == -1) job->error = errno;
+}
+
+static
+void file_stat_job_function(struct IO_Event_Worker_Job *_job) {
+	struct file_job *job = (struct file_job *)_job;
+	
+	job->result = stat(job->path, &job->status);
+	if (job->result == -1) job->error = errno;
+}
+
+static
+void io_fsync_job_function(struct IO_Event_Worker_Job *_job) {
+	struct file_job *job = (struct file_job *)_job;
+	
+	job->result = job->flags ? fdatasync(job->descriptor) : fsync(job->descriptor);
+	if (job->result == -1) job->error = errno;
+}
+
+static
+void file_unlink_job_function(struct IO_Event_Worker_Job *_job) {
+	struct file_job *job = (struct file_job *)_job;
+	
+	job->result = unlink(job->path);
+	if (job->result == -1) job->error = errno;
+}
+
+static
+void file_rename_job_function(struct IO_Event_Worker_Job *_job) {
+	struct file_job *job = (struct file_job *)_job;
+	
+	job->result = rename(job->path, job->other);
+	if (job->result == -1) job->error = errno;
+}
+
+static
+void file_execute(VALUE self, VALUE fiber, struct file_job *job) {
+	struct IO_Event_Selector_EPoll *data = NULL;
+	TypedData_Get_Struct(self, struct IO_Event_Selector_EPoll, &IO_Event_Selector_EPoll_Type, data);
+	
+	if (!worker_execute(data, fiber, &job->job)) {
+		job->result = -1;
+		job->error = EINTR;
+	}
+}
+
+// Open the file at the given path, returning a `File` instance. The descriptor is always opened with `O_CLOEXEC`.
+VALUE IO_Event_Selector_EPoll_file_open(VALUE self, VALUE fiber, VALUE path, VALUE _flags, VALUE _mode) {
+	FilePathValue(path);
+	
+	struct file_job job = {
+		.job = {.function = file_open_job_function},
+		.path = RSTRING_PTR(path),
+		.flags = NUM2INT(_flags) | O_CLOEXEC,
+		.mode = NUM2MODET(_mode),
+	};
+	
+	file_execute(self, fiber, &job);
+	RB_GC_GUARD(path);
+	
+	if (job.result == -1) {
+		rb_syserr_fail_str(job.error, path);
+	}
+	
+	rb_update_max_fd(job.result);
+	
+	return rb_io_fdopen(job.result, job.flags, RSTRING_PTR(path));
+}
+
+// Get the status of the file at the given path, following symbolic links, returning a `File::Stat` instance.
+VALUE IO_Event_Selector_EPoll_file_stat(VALUE self, VALUE fiber, VALUE path) {
+	FilePathValue(path);
+	
+	struct file_job job = {
+		.job = {.function = file_stat_job_function},
+		.path = RSTRING_PTR(path),
+	};
+	
+	file_execute(self, fiber, &job);
+	RB_GC_GUARD(path);
+	
+	if (job.result == -1) {
+		rb_syserr_fail_str(job.error, path);
+	}
+	
+	return rb_stat_new(&job.status);
+}
+
+static
+int io_fsync_function(VALUE self, VALUE fiber, int descriptor, int datasync) {
+	struct file_job job = {
+		.job = {.function = io_fsync_job_function},
+		.descriptor = descriptor,
+		.flags = datasync,
+	};
+	
+	file_execute(self, fiber, &job);
+	
+	return job.result == -1 ? -job.error : 0;
+}
+
+static
+VALUE io_fsync(VALUE self, VALUE fiber, VALUE io, int datasync) {
+	struct IO_Event_Selector_EPoll *data = NULL;
+	TypedData_Get_Struct(self, struct IO_Event_Selector_EPoll, &IO_Event_Selector_EPoll_Type, data);
+	
+	int descriptor = IO_Event_Selector_io_descriptor(io);
+	
+	// Concurrent requests for the same descriptor share a single flush:
+	int result = IO_Event_Selector_sync(&data->backend, &data->syncs, self, fiber, descriptor, datasync, io_fsync_function);
+	
+	if (result < 0) {
+		rb_syserr_fail(-result, "IO_Event_Selector_EPoll_io_fsync:fsync");
+	}
+	
+	return INT2NUM(0);
+}
+
+// Flush the file's data and metadata to the storage device.
+VALUE IO_Event_Selector_EPoll_io_fsync(VALUE self, VALUE fiber, VALUE io) {
+	return io_fsync(self, fiber, io, 0);
+}
+
+// Flush the file's data (and only the metadata required to read it) to the storage device.
+VALUE IO_Event_Selector_EPoll_io_fdatasync(VALUE self, VALUE fiber, VALUE io) {
+	return io_fsync(self, fiber, io, 1);
+}
+
+VALUE IO_Event_Selector_EPoll_file_unlink(VALUE self, VALUE fiber, VALUE path) {
+	FilePathValue(path);
+	
+	struct file_job job = {
+		.job = {.function = file_unlink_job_function},
+		.path = RSTRING_PTR(path),
+	};
+	
+	file_execute(self, fiber, &job);
+	RB_GC_GUARD(path);
+	
+	if (job.result == -1) {
+		rb_syserr_fail_str(job.error, path);
+	}
+	
+	return Qnil;
+}
+
+VALUE IO_Event_Selector_EPoll_file_rename(VALUE self, VALUE fiber, VALUE from, VALUE to) {
+	FilePathValue(from);
+	FilePathValue(to);
+	
+	struct file_job job = {
+		.job = {.function = file_rename_job_function},
+		.path = RSTRING_PTR(from),
+		.other = RSTRING_PTR(to),
+	};
+	
+	file_execute(self, fiber, &job);
+	RB_GC_GUARD(from);
+	RB_GC_GUARD(to);
+	
+	if (job.result == -1) {
+		rb_syserr_fail_str(job.error, from);
+	}
+	
+	return Qnil;
+}
+
+#ifdef HAVE_RUBY_IO_BUFFER_H
+
+// Regular files are always considered ready by epoll, so reading from a slow disk would block the event loop. Instead, we read from the page cache if possible, and otherwise execute the read on the worker pool.
+struct io_read_job {
+	struct IO_Event_Worker_Job job;
+	
+	int descriptor;
+	char *base;
+	size_t size;
+	
+	size_t length;
+	size_t offset;
+	
+	// The position in the file to read from, or -1 to use the current file position:
+	off_t from;
+	
+	int error;
+};
+
+static
+void io_read_job_function(struct IO_Event_Worker_Job *_job) {
+	struct io_read_job *job = (struct io_read_job *)_job;
+	
+	while (true) {
+		ssize_t result;
+		
+		if (job->from == -1) {
+			result = read(job->descriptor, job->base + job->offset, job->size - job->offset);
+		} else {
+			result = pread(job->descriptor, job->base + job->offset, job->size - job->offset, job->from);
+		}
+		
+		if (result > 0) {
+			if (job->from != -1) job->from += result;
+			job->offset += result;
+			if ((size_t)result >= job->length) break;
+			job->length -= result;
+		} else if (result == 0) {
+			break;
+		} else if (errno != EINTR || job->job.cancelled) {
+			job->error = errno;
+			break;
+		}
+	}
+}
+
+// Read without blocking if the data is in the page cache, otherwise fail with EAGAIN.
+static
+ssize_t io_read_nowait(int descriptor, void *base, size_t size, off_t from) {
+#if defined(HAVE_PREADV2) && defined(RWF_NOWAIT)
+	struct iovec iovec = {.iov_base = base, .iov_len = size};
+	
+	// An offset of -1 uses (and updates) the current file position:
+	return preadv2(descriptor, &iovec, 1, from, RWF_NOWAIT);
+#else
+	errno = EAGAIN;
+	return -1;
+#endif
+}
+
+static
+VALUE io_read_file(struct IO_Event_Selector_EPoll *data, VALUE fiber, int descriptor, void *base, size_t size, size_t length, size_t offset, off_t from) {
+	while (true) {
+		ssize_t result = io_read_nowait(descriptor, (char*)base+offset, size - offset, from);
+		
+		if (result > 0) {
+			if (from != -1) from += result;
+			offset += result;
+			if ((size_t)result >= length) return rb_fiber_scheduler_io_result(offset, 0);
+			length -= result;
+		} else if (result == 0) {
+			return rb_fiber_scheduler_io_result(offset, 0);
+		} else {
+			// Either the data is not cached, or `RWF_NOWAIT` is not supported:
+			break;
+		}
+	}
+	
+	struct io_read_job job = {
+		.job = {.function = io_read_job_function},
+		.descriptor = descriptor,
+		.base = base,
+		.size = size,
+		.length = length,
+		.offset = offset,
+		.from = from,
+	};
+	
+	if (!worker_execute(data, fiber, &job.job)) {
+		job.error = EINTR;
+	}
+	
+	if (job.error) {
+		return rb_fiber_scheduler_io_result(-1, job.error);
+	}
+	
+	return rb_fiber_scheduler_io_result(job.offset, 0);
+}
+
+struct io_read_arguments {
+	VALUE self;
+	VALUE fiber;
+	VALUE io;
+	
+	struct IO_Event_Selector_Nonblock nonblock;
+	
+	int descriptor;
+	
+	VALUE buffer;
+	size_t length;
+	size_t offset;
+	
+	struct timespec *deadline;
+};
+
+static
+VALUE io_read_loop(VALUE _arguments) {
+	struct io_read_arguments *arguments = (struct io_read_arguments *)_arguments;
+	
+	void *base;
+	size_t size;
+	rb_io_buffer_get_bytes_for_writing(arguments->buffer, &base, &size);
+	
+	size_t length = arguments->length;
+	size_t offset = arguments->offset;
+	
+	while (true) {
+		size_t maximum_size = size - offset;
+		ssize_t result = IO_Event_Selector_Nonblock_read(&arguments->nonblock, (char*)base+offset, maximum_size);
+		
+		if (result > 0) {
+			offset += result;
+			if ((size_t)result >= length) break;
+			length -= result;
+			
+			// A short read means the descriptor was drained, so reading again would fail with `EAGAIN`:
+			if ((size_t)result == maximum_size) continue;
+		} else if (result == 0) {
+			break;
+		} else if (length == 0 || !IO_Event_try_again(errno)) {
+			return rb_fiber_scheduler_io_result(-1, errno);
+		}
+		
+		VALUE ready = io_wait_operation(arguments->self, arguments->fiber, arguments->io, RB_INT2NUM(IO_EVENT_READABLE), arguments->deadline);
+		
+		if (!RTEST(ready)) {
+			// The deadline expired (or the operation was cancelled), so return whatever we managed to read:
+			if (offset > arguments->offset) break;
+			return rb_fiber_scheduler_io_result(-1, NIL_P(ready) ? ECANCELED : ETIMEDOUT);
+		}
+	}
+	
+	return rb_fiber_scheduler_io_result(offset, 0);
+}
+
+static
+VALUE io_read_ensure(VALUE _arguments) {
+	struct io_read_arguments *arguments = (struct io_read_arguments *)_arguments;
+	
+	IO_Event_Selector_Nonblock_restore(&arguments->nonblock);
+	
+	return Qnil;
+}
+
+static
+VALUE io_read(VALUE self, VALUE fiber, VALUE io, VALUE buffer, VALUE _length, VALUE _offset, struct timespec *deadline) {
+	struct IO_Event_Selector_EPoll *data = NULL;
+	TypedData_Get_Struct(self, struct IO_Event_Selector_EPoll, &IO_Event_Selector_EPoll_Type, data);
+	
+	int descriptor = IO_Event_Selector_io_descriptor(io);
+	
+	size_t offset = NUM2SIZET(_offset);
+	size_t length = NUM2SIZET(_length);
+	
+	if (IO_Event_Selector_Descriptors_regular_p(&data->descriptors, descriptor)) {
+		void *base;
+		size_t size;
+		rb_io_buffer_get_bytes_for_writing(buffer, &base, &size);
+		
+		return io_read_file(data, fiber, descriptor, base, size, length, offset, -1);
+	}
+	
+	struct io_read_arguments io_read_arguments = {
+		.self = self,
+		.fiber = fiber,
+		.io = io,
+		
+		.descriptor = descriptor,
+		.buffer = buffer,
+		.length = length,
+		.offset = offset,
+		.deadline = deadline,
+	};
+	
+	IO_Event_Selector_Nonblock_set(&io_read_arguments.nonblock, &data->descriptors, descriptor);
+	
+	return rb_ensure(io_read_loop, (VALUE)&io_read_arguments, io_read_ensure, (VALUE)&io_read_arguments);
+}
+
+VALUE IO_Event_Selector_EPoll_io_read(VALUE self, VALUE fiber, VALUE io, VALUE buffer, VALUE _length, VALUE _offset) {
+	return io_read(self, fiber, io, buffer, _length, _offset, NULL);
+}
+
+// If a timeout (in seconds) is given and nothing could be read before it expires, returns -ETIMEDOUT.
+VALUE IO_Event_Selector_EPoll_io_read_compatible(int argc, VALUE *argv, VALUE self)
+{
+	rb_check_arity(argc, 4, 6);
+	
+	VALUE _offset = SIZET2NUM(0);
+	
+	if (argc >= 5) {
+		_offset = argv[4];
+	}
+	
+	struct timespec storage;
+	struct timespec *deadline = IO_Event_Selector_deadline(argc == 6 ? argv[5] : Qnil, &storage);
+	
+	return io_read(self, argv[0], argv[1], argv[2], argv[3], _offset, deadline);
+}
+
+// Positioned reads don't depend on (or modify) the file position, so concurrent fibers can read different parts of the same file. Only files support this, so there is no need to wait for readiness.
+VALUE IO_Event_Selector_EPoll_io_pread(VALUE self, VALUE fiber, VALUE io, VALUE buffer, VALUE _from, VALUE _length, VALUE _offset) {
+	struct IO_Event_Selector_EPoll *data = NULL;
+	TypedData_Get_Struct(self, struct IO_Event_Selector_EPoll, &IO_Event_Selector_EPoll_Type, data);
+	
+	int descriptor = IO_Event_Selector_io_descriptor(io);
+	
+	off_t from = NUM2OFFT(_from);
+	size_t length = NUM2SIZET(_length);
+	size_t offset = NUM2SIZET(_offset);
+	
+	void *base;
+	size_t size;
+	rb_io_buffer_get_bytes_for_writing(buffer, &base, &size);
+	
+	return io_read_file(data, fiber, descriptor, base, size, length, offset, from);
+}
+
+struct io_read_until_arguments {
+	struct IO_Event_Selector_EPoll *data;
+	VALUE self;
+	VALUE fiber;
+	VALUE io;
+	
+	struct IO_Event_Selector_Nonblock nonblock;
+	
+	int descriptor;
+	int regular;
+	
+	VALUE buffer;
+	VALUE delimiter;
+	size_t maximum;
+	size_t offset;
+};
+
+static
+VALUE io_read_until_loop(VALUE _arguments) {
+	struct io_read_until_arguments *arguments = (struct io_read_until_arguments *)_arguments;
+	
+	size_t offset = arguments->offset;
+	size_t from = 0;
+	
+	while (true) {
+		// The buffer may have been resized while we were waiting:
+		void *base;
+		size_t size;
+		rb_io_buffer_get_bytes_for_writing(arguments->buffer, &base, &size);
+		
+		size_t maximum = arguments->maximum < size ? arguments->maximum : size;
+		if (offset > size) offset = size;
+		
+		ssize_t index = IO_Event_Selector_search(base, offset, &from, RSTRING_PTR(arguments->delimiter), RSTRING_LEN(arguments->delimiter));
+		
+		if (index >= 0) {
+			return rb_ary_new_from_args(2, SSIZET2NUM(index), SIZET2NUM(offset));
+		} else if (offset >= maximum) {
+			break;
+		}
+		
+		if (arguments->regular) {
+			// Reads the available data (without blocking the event loop), returning the new offset:
+			ssize_t result = NUM2SSIZET(io_read_file(arguments->data, arguments->fiber, arguments->descriptor, base, maximum, 0, offset, -1));
+			
+			if (result < 0) rb_syserr_fail(-result, "IO_Event_Selector_EPoll_io_read_until:read");
+			if ((size_t)result == offset) break;
+			
+			offset = result;
+			continue;
+		}
+		
+		ssize_t result = IO_Event_Selector_Nonblock_read(&arguments->nonblock, (char*)base+offset, maximum - offset);
+		
+		if (result > 0) {
+			offset += result;
+		} else if (result == 0) {
+			break;
+		} else if (IO_Event_try_again(errno)) {
+			io_wait(arguments->self, arguments->fiber, arguments->io, RB_INT2NUM(IO_EVENT_READABLE), NULL);
+		} else {
+			rb_sys_fail("IO_Event_Selector_EPoll_io_read_until:read");
+		}
+	}
+	
+	// The end of the stream, or the maximum size, was reached without finding the delimiter:
+	return rb_ary_new_from_args(2, Qnil, SIZET2NUM(offset));
+}
+
+static
+VALUE io_read_until_ensure(VALUE _arguments) {
+	struct io_read_until_arguments *arguments = (struct io_read_until_arguments *)_arguments;
+	
+	if (!arguments->regular) {
+		IO_Event_Selector_Nonblock_restore(&arguments->nonblock);
+	}
+	
+	return Qnil;
+}
+
+// Read into the buffer until it contains the delimiter, scanning only the bytes which arrived since the previous read. The first `offset` bytes of the buffer are data which was already read, e.g. left over from the previous line. Returns `[index, length]`, where `index` is the offset of the delimiter (or nil if the stream ended, or `maximum` bytes were read, before it was found) and `length` is the number of bytes in the buffer, which may include data following the delimiter.
+VALUE IO_Event_Selector_EPoll_io_read_until(int argc, VALUE *argv, VALUE self) {
+	rb_check_arity(argc, 5, 6);
+	
+	struct IO_Event_Selector_EPoll *data = NULL;
+	TypedData_Get_Struct(self, struct IO_Event_Selector_EPoll, &IO_Event_Selector_EPoll_Type, data);
+	
+	VALUE delimiter = rb_str_new_frozen(StringValue(argv[3]));
+	if (RSTRING_LEN(delimiter) == 0) {
+		rb_raise(rb_eArgError, "Delimiter must not be empty!");
+	}
+	
+	int descriptor = IO_Event_Selector_io_descriptor(argv[1]);
+	
+	struct io_read_until_arguments io_read_until_arguments = {
+		.data = data,
+		.self = self,
+		.fiber = argv[0],
+		.io = argv[1],
+		
+		.descriptor = descriptor,
+		.regular = IO_Event_Selector_Descriptors_regular_p(&data->descriptors, descriptor),
+		
+		.buffer = argv[2],
+		.delimiter = delimiter,
+		.maximum = NUM2SIZET(argv[4]),
+		.offset = argc == 6 ? NUM2SIZET(argv[5]) : 0,
+	};
+	
+	if (!io_read_until_arguments.regular) {
+		IO_Event_Selector_Nonblock_set(&io_read_until_arguments.nonblock, &data->descriptors, descriptor);
+	}
+	
+	return rb_ensure(io_read_until_loop, (VALUE)&io_read_until_arguments, io_read_until_ensure, (VALUE)&io_read_until_arguments);
+}
+
+struct io_read_adaptive_arguments {
+	struct IO_Event_Selector_EPoll *data;
+	VALUE self;
+	VALUE fiber;
+	VALUE io;
+	
+	struct IO_Event_Selector_Nonblock nonblock;
+	
+	int descriptor;
+	
+	VALUE buffer;
+	size_t maximum;
+	size_t offset;
+};
+
+// Grow the buffer so that it can hold the given number of bytes, up to the maximum, returning the space after the offset. A buffer larger than the maximum is only used up to the maximum.
+static
+size_t io_read_adaptive_reserve(struct io_read_adaptive_arguments *arguments, size_t offset, size_t length, void **base) {
+	size_t size;
+	rb_io_buffer_get_bytes_for_writing(arguments->buffer, base, &size);
+	
+	size_t required = offset + length;
+	if (required > arguments->maximum) required = arguments->maximum;
+	
+	if (required > size) {
+		rb_io_buffer_resize(arguments->buffer, required);
+		rb_io_buffer_get_bytes_for_writing(arguments->buffer, base, &size);
+	}
+	
+	if (size > arguments->maximum) size = arguments->maximum;
+	
+	return offset < size ? size - offset : 0;
+}
+
+// The number of bytes which can be read without blocking, or zero if unknown.
+static
+size_t io_read_adaptive_pending(int descriptor) {
+	int pending = 0;
+	
+	if (ioctl(descriptor, FIONREAD, &pending) == -1 || pending < 0) {
+		return 0;
+	}
+	
+	return pending;
+}
+
+static
+VALUE io_read_adaptive_loop(VALUE _arguments) {
+	struct io_read_adaptive_arguments *arguments = (struct io_read_adaptive_arguments *)_arguments;
+	
+	size_t offset = arguments->offset;
+	size_t length = IO_Event_Selector_Descriptors_lookup(&arguments->data->descriptors, arguments->descriptor)->read_size;
+	
+	while (true) {
+		if (length < IO_EVENT_SELECTOR_READ_SIZE_MINIMUM) length = IO_EVENT_SELECTOR_READ_SIZE_MINIMUM;
+		
+		void *base;
+		size_t maximum_size = io_read_adaptive_reserve(arguments, offset, length, &base);
+		
+		// There is no space left, and reading zero bytes would look like the end of the stream:
+		if (maximum_size == 0) break;
+		
+		ssize_t result = IO_Event_Selector_Nonblock_read(&arguments->nonblock, (char*)base+offset, maximum_size);
+		
+		if (result > 0) {
+			offset += result;
+			
+			// If we filled the buffer, there may be more data which we can read without waiting:
+			if ((size_t)result == maximum_size && offset < arguments->maximum) {
+				length = io_read_adaptive_pending(arguments->descriptor);
+				if (length) continue;
+			}
+			
+			break;
+		} else if (result == 0) {
+			break;
+		} else if (offset > arguments->offset) {
+			// We already read some data, so return it rather than waiting (or failing):
+			break;
+		} else if (IO_Event_try_again(errno)) {
+			if (NIL_P(io_wait_operation(arguments->self, arguments->fiber, arguments->io, RB_INT2NUM(IO_EVENT_READABLE), NULL))) {
+				return rb_fiber_scheduler_io_result(-1, ECANCELED);
+			}
+			
+			// Now that the descriptor is readable, we can find out how much data is waiting:
+			length = io_read_adaptive_pending(arguments->descriptor);
+		} else {
+			return rb_fiber_scheduler_io_result(-1, errno);
+		}
+	}
+	
+	size_t total = offset - arguments->offset;
+	
+	if (total) {
+		IO_Event_Selector_Descriptor_read(IO_Event_Selector_Descriptors_lookup(&arguments->data->descriptors, arguments->descriptor), total);
+	}
+	
+	return rb_fiber_scheduler_io_result(total, 0);
+}
+
+static
+VALUE io_read_adaptive_ensure(VALUE _arguments) {
+	struct io_read_adaptive_arguments *arguments = (struct io_read_adaptive_arguments *)_arguments;
+	
+	IO_Event_Selector_Nonblock_restore(&arguments->nonblock);
+	
+	return Qnil;
+}
+
+// Read whatever data is available at the given offset, waiting if there is none, and grow the buffer (up to `maximum` bytes) to fit it. The amount of data waiting is checked using `FIONREAD` once the descriptor is readable, and a moving average of the size of previous reads from the same descriptor is used to size the buffer in advance. Returns the number of bytes read, zero at the end of the stream, or -errno.
+VALUE IO_Event_Selector_EPoll_io_read_adaptive(int argc, VALUE *argv, VALUE self) {
+	rb_check_arity(argc, 4, 5);
+	
+	struct IO_Event_Selector_EPoll *data = NULL;
+	TypedData_Get_Struct(self, struct IO_Event_Selector_EPoll, &IO_Event_Selector_EPoll_Type, data);
+	
+	int descriptor = IO_Event_Selector_io_descriptor(argv[1]);
+	size_t maximum = NUM2SIZET(argv[3]);
+	size_t offset = argc == 5 ? NUM2SIZET(argv[4]) : 0;
+	
+	if (offset >= maximum) {
+		rb_raise(rb_eArgError, "Offset must be less than the maximum size!");
+	}
+	
+	if (IO_Event_Selector_Descriptors_regular_p(&data->descriptors, descriptor)) {
+		// Files are always readable, so there is nothing to adapt to:
+		void *base;
+		size_t size;
+		rb_io_buffer_get_bytes_for_writing(argv[2], &base, &size);
+		
+		if (size > maximum) size = maximum;
+		
+		ssize_t result = NUM2SSIZET(io_read_file(data, argv[0], descriptor, base, size, 0, offset, -1));
+		
+		return result < 0 ? SSIZET2NUM(result) : SIZET2NUM((size_t)result - offset);
+	}
+	
+	struct io_read_adaptive_arguments io_read_adaptive_arguments = {
+		.data = data,
+		.self = self,
+		.fiber = argv[0],
+		.io = argv[1],
+		
+		.descriptor = descriptor,
+		
+		.buffer = argv[2],
+		.maximum = maximum,
+		.offset = offset,
+	};
+	
+	IO_Event_Selector_Nonblock_set(&io_read_adaptive_arguments.nonblock, &data->descriptors, descriptor);
+	
+	return rb_ensure(io_read_adaptive_loop, (VALUE)&io_read_adaptive_arguments, io_read_adaptive_ensure, (VALUE)&io_read_adaptive_arguments);
+}
+
+struct io_write_job {
+	struct IO_Event_Worker_Job job;
+	
+	int descriptor;
+	const char *base;
+	size_t size;
+	
+	size_t length;
+	size_t offset;
+	
+	// The position in the file to write to, or -1 to use the current file position:
+	off_t from;
+	
+	int error;
+};
+
+static
+void io_write_job_function(struct IO_Event_Worker_Job *_job) {
+	struct io_write_job *job = (struct io_write_job *)_job;
+	
+	while (true) {
+		ssize_t result;
+		
+		if (job->from == -1) {
+			result = write(job->descriptor, job->base + job->offset, job->size - job->offset);
+		} else {
+			result = pwrite(job->descriptor, job->base + job->offset, job->size - job->offset, job->from);
+		}
+		
+		if (result > 0) {
+			if (job->from != -1) job->from += result;
+			job->offset += result;
+			if ((size_t)result >= job->length) break;
+			job->length -= result;
+		} else if (result == 0) {
+			break;
+		} else if (errno != EINTR || job->job.cancelled) {
+			job->error = errno;
+			break;
+		}
+	}
+}
+
+static
+VALUE io_write_file(struct IO_Event_Selector_EPoll *data, VALUE fiber, int descriptor, VALUE buffer, size_t length, size_t offset, off_t from) {
+	const void *base;
+	size_t size;
+	rb_io_buffer_get_bytes_for_reading(buffer, &base, &size);
+	
+	if (length > size) {
+		rb_raise(rb_eRuntimeError, "Length exceeds size of buffer!");
+	}
+	
+	struct io_write_job job = {
+		.job = {.function = io_write_job_function},
+		.descriptor = descriptor,
+		.base = base,
+		.size = size,
+		.length = length,
+		.offset = offset,
+		.from = from,
+	};
+	
+	if (!worker_execute(data, fiber, &job.job)) {
+		job.error = EINTR;
+	}
+	
+	if (job.error) {
+		return rb_fiber_scheduler_io_result(-1, job.error);
+	}
+	
+	return rb_fiber_scheduler_io_result(job.offset, 0);
+}
+
+struct io_write_arguments {
+	VALUE self;
+	VALUE fiber;
+	VALUE io;
+	
+	struct IO_Event_Selector_Nonblock nonblock;
+	
+	int descriptor;
+	
+	VALUE buffer;
+	size_t length;
+	size_t offset;
+	
+	struct timespec *deadline;
+};
+
+static
+VALUE io_write_loop(VALUE _arguments) {
+	struct io_write_arguments *arguments = (struct io_write_arguments *)_arguments;
+	
+	const void *base;
+	size_t size;
+	rb_io_buffer_get_bytes_for_reading(arguments->buffer, &base, &size);
+	
+	size_t length = arguments->length;
+	size_t offset = arguments->offset;
+	
+	if (length > size) {
+		rb_raise(rb_eRuntimeError, "Length exceeds size of buffer!");
+	}
+	
+	while (true) {
+		size_t maximum_size = size - offset;
+		ssize_t result = IO_Event_Selector_Nonblock_write(&arguments->nonblock, (char*)base+offset, maximum_size);
+		
+		if (result > 0) {
+			offset += result;
+			if ((size_t)result >= length) break;
+			length -= result;
+		} else if (result == 0) {
+			break;
+		} else if (length > 0 && IO_Event_try_again(errno)) {
+			VALUE ready = io_wait_operation(arguments->self, arguments->fiber, arguments->io, RB_INT2NUM(IO_EVENT_WRITABLE), arguments->deadline);
+			
+			if (!RTEST(ready)) {
+				// The deadline expired (or the operation was cancelled), so return whatever we managed to write:
+				if (offset > arguments->offset) break;
+				return rb_fiber_scheduler_io_result(-1, NIL_P(ready) ? ECANCELED : ETIMEDOUT);
+			}
+		} else {
+			return rb_fiber_scheduler_io_result(-1, errno);
+		}
+	}
+	
+	return rb_fiber_scheduler_io_result(offset, 0);
+};
+
+static
+VALUE io_write_ensure(VALUE _arguments) {
+	struct io_write_arguments *arguments = (struct io_write_arguments *)_arguments;
+	
+	IO_Event_Selector_Nonblock_restore(&arguments->nonblock);
+	
+	return Qnil;
+};
+
+static
+VALUE io_write(VALUE self, VALUE fiber, VALUE io, VALUE buffer, VALUE _length, VALUE _offset, struct timespec *deadline) {
+	struct IO_Event_Selector_EPoll *data = NULL;
+	TypedData_Get_Struct(self, struct IO_Event_Selector_EPoll, &IO_Event_Selector_EPoll_Type, data);
+	
+	int descriptor = IO_Event_Selector_io_descriptor(io);
+	
+	size_t length = NUM2SIZET(_length);
+	size_t offset = NUM2SIZET(_offset);
+	
+	if (IO_Event_Selector_Descriptors_regular_p(&data->descriptors, descriptor)) {
+		return io_write_file(data, fiber, descriptor, buffer, length, offset, -1);
+	}
+	
+	struct io_write_arguments io_write_arguments = {
+		.self = self,
+		.fiber = fiber,
+		.io = io,
+		
+		.descriptor = descriptor,
+		.buffer = buffer,
+		.length = length,
+		.offset = offset,
+		.deadline = deadline,
+	};
+	
+	IO_Event_Selector_Nonblock_set(&io_write_arguments.nonblock, &data->descriptors, descriptor);
+	
+	return rb_ensure(io_write_loop, (VALUE)&io_write_arguments, io_write_ensure, (VALUE)&io_write_arguments);
+}
+
+VALUE IO_Event_Selector_EPoll_io_write(VALUE self, VALUE fiber, VALUE io, VALUE buffer, VALUE _length, VALUE _offset) {
+	return io_write(self, fiber, io, buffer, _length, _offset, NULL);
+}
+
+// If a timeout (in seconds) is given and nothing could be written before it expires, returns -ETIMEDOUT.
+VALUE IO_Event_Selector_EPoll_io_write_compatible(int argc, VALUE *argv, VALUE self)
+{
+	rb_check_arity(argc, 4, 6);
+	
+	VALUE _offset = SIZET2NUM(0);
+	
+	if (argc >= 5) {
+		_offset = argv[4];
+	}
+	
+	struct timespec storage;
+	struct timespec *deadline = IO_Event_Selector_deadline(argc == 6 ? argv[5] : Qnil, &storage);
+	
+	return io_write(self, argv[0], argv[1], argv[2], argv[3], _offset, deadline);
+}
+
+VALUE IO_Event_Selector_EPoll_io_pwrite(VALUE self, VALUE fiber, VALUE io, VALUE buffer, VALUE _from, VALUE _length, VALUE _offset) {
+	struct IO_Event_Selector_EPoll *data = NULL;
+	TypedData_Get_Struct(self, struct IO_Event_Selector_EPoll, &IO_Event_Selector_EPoll_Type, data);
+	
+	int descriptor = IO_Event_Selector_io_descriptor(io);
+	
+	off_t from = NUM2OFFT(_from);
+	size_t length = NUM2SIZET(_length);
+	size_t offset = NUM2SIZET(_offset);
+	
+	return io_write_file(data, fiber, descriptor, buffer, length, offset, from);
+}
+
+// Vectored operations on regular files are executed on the worker pool, like `io_read_job`/`io_write_job`.
+struct io_vector_job {
+	struct IO_Event_Worker_Job job;
+	
+	int descriptor;
+	int writing;
+	
+	struct iovec *iovecs;
+	int count;
+	
+	size_t length;
+	size_t total;
+	int error;
+};
+
+static
+void io_vector_job_function(struct IO_Event_Worker_Job *_job) {
+	struct io_vector_job *job = (struct io_vector_job *)_job;
+	
+	while (job->count > 0) {
+		int count = IO_Event_Selector_iovecs_limit(job->count);
+		ssize_t result = job->writing ? writev(job->descriptor, job->iovecs, count) : readv(job->descriptor, job->iovecs, count);
+		
+		if (result > 0) {
+			job->total += result;
+			job->iovecs = IO_Event_Selector_iovecs_advance(job->iovecs, &job->count, result);
+			if ((size_t)result >= job->length) break;
+			job->length -= result;
+		} else if (result == 0) {
+			break;
+		} else if (errno != EINTR || job->job.cancelled) {
+			job->error = errno;
+			break;
+		}
+	}
+}
+
+static
+VALUE io_vector_file(struct IO_Event_Selector_EPoll *data, VALUE fiber, int descriptor, int writing, struct iovec *iovecs, int count, size_t length) {
+	struct io_vector_job job = {
+		.job = {.function = io_vector_job_function},
+		.descriptor = descriptor,
+		.writing = writing,
+		.iovecs = iovecs,
+		.count = count,
+		.length = length,
+	};
+	
+	if (!worker_execute(data, fiber, &job.job)) {
+		job.error = EINTR;
+	}
+	
+	if (job.error) {
+		return rb_fiber_scheduler_io_result(-1, job.error);
+	}
+	
+	return rb_fiber_scheduler_io_result(job.total, 0);
+}
+
+struct io_vector_arguments {
+	VALUE self;
+	VALUE fiber;
+	VALUE io;
+	
+	struct IO_Event_Selector_Nonblock nonblock;
+	
+	struct iovec *iovecs;
+	int count;
+	size_t length;
+};
+
+static
+VALUE io_readv_loop(VALUE _arguments) {
+	struct io_vector_arguments *arguments = (struct io_vector_arguments *)_arguments;
+	
+	struct iovec *iovecs = arguments->iovecs;
+	int count = arguments->count;
+	size_t length = arguments->length;
+	size_t total = 0;
+	
+	while (count > 0) {
+		ssize_t result = IO_Event_Selector_Nonblock_readv(&arguments->nonblock, iovecs, IO_Event_Selector_iovecs_limit(count));
+		
+		if (result > 0) {
+			total += result;
+			iovecs = IO_Event_Selector_iovecs_advance(iovecs, &count, result);
+			if ((size_t)result >= length) break;
+			length -= result;
+		} else if (result == 0) {
+			break;
+		} else if (length > 0 && IO_Event_try_again(errno)) {
+			if (NIL_P(io_wait_operation(arguments->self, arguments->fiber, arguments->io, RB_INT2NUM(IO_EVENT_READABLE), NULL))) {
+				if (total) break;
+				return rb_fiber_scheduler_io_result(-1, ECANCELED);
+			}
+		} else {
+			return rb_fiber_scheduler_io_result(-1, errno);
+		}
+	}
+	
+	return rb_fiber_scheduler_io_result(total, 0);
+}
+
+static
+VALUE io_writev_loop(VALUE _arguments) {
+	struct io_vector_arguments *arguments = (struct io_vector_arguments *)_arguments;
+	
+	struct iovec *iovecs = arguments->iovecs;
+	int count = arguments->count;
+	size_t length = arguments->length;
+	size_t total = 0;
+	
+	while (count > 0) {
+		ssize_t result = IO_Event_Selector_Nonblock_writev(&arguments->nonblock, iovecs, IO_Event_Selector_iovecs_limit(count));
+		
+		if (result > 0) {
+			total += result;
+			iovecs = IO_Event_Selector_iovecs_advance(iovecs, &count, result);
+			if ((size_t)result >= length) break;
+			length -= result;
+		} else if (result == 0) {
+			break;
+		} else if (length > 0 && IO_Event_try_again(errno)) {
+			if (NIL_P(io_wait_operation(arguments->self, arguments->fiber, arguments->io, RB_INT2NUM(IO_EVENT_WRITABLE), NULL))) {
+				if (total) break;
+				return rb_fiber_scheduler_io_result(-1, ECANCELED);
+			}
+		} else {
+			return rb_fiber_scheduler_io_result(-1, errno);
+		}
+	}
+	
+	return rb_fiber_scheduler_io_result(total, 0);
+}
+
+static
+VALUE io_vector_ensure(VALUE _arguments) {
+	struct io_vector_arguments *arguments = (struct io_vector_arguments *)_arguments;
+	
+	IO_Event_Selector_Nonblock_restore(&arguments->nonblock);
+	
+	return Qnil;
+}
+
+static
+VALUE io_vector(VALUE self, VALUE fiber, VALUE io, int writing, struct iovec *iovecs, int count, size_t length) {
+	struct IO_Event_Selector_EPoll *data = NULL;
+	TypedData_Get_Struct(self, struct IO_Event_Selector_EPoll, &IO_Event_Selector_EPoll_Type, data);
+	
+	int descriptor = IO_Event_Selector_io_descriptor(io);
+	
+	if (IO_Event_Selector_Descriptors_regular_p(&data->descriptors, descriptor)) {
+		return io_vector_file(data, fiber, descriptor, writing, iovecs, count, length);
+	}
+	
+	struct io_vector_arguments io_vector_arguments = {
+		.self = self,
+		.fiber = fiber,
+		.io = io,
+		
+		.iovecs = iovecs,
+		.count = count,
+		.length = length,
+	};
+	
+	IO_Event_Selector_Nonblock_set(&io_vector_arguments.nonblock, &data->descriptors, descriptor);
+	
+	return rb_ensure(writing ? io_writev_loop : io_readv_loop, (VALUE)&io_vector_arguments, io_vector_ensure, (VALUE)&io_vector_arguments);
+}
+
+// Read into several buffers with a single system call, until at least `length` bytes have been read.
+VALUE IO_Event_Selector_EPoll_io_readv(VALUE self, VALUE fiber, VALUE io, VALUE buffers, VALUE _length) {
+	Check_Type(buffers, T_ARRAY);
+	
+	size_t length = NUM2SIZET(_length);
+	int count = RARRAY_LENINT(buffers);
+	
+	VALUE storage;
+	struct iovec *iovecs = ALLOCV_N(struct iovec, storage, count);
+	IO_Event_Selector_iovecs_for_writing(buffers, iovecs, count);
+	
+	VALUE result = io_vector(self, fiber, io, 0, iovecs, count, length);
+	
+	ALLOCV_END(storage);
+	
+	return result;
+}
+
+// Write several buffers with a single system call, until at least `length` bytes have been written.
+VALUE IO_Event_Selector_EPoll_io_writev(VALUE self, VALUE fiber, VALUE io, VALUE buffers, VALUE _length) {
+	Check_Type(buffers, T_ARRAY);
+	
+	size_t length = NUM2SIZET(_length);
+	int count = RARRAY_LENINT(buffers);
+	
+	VALUE storage;
+	struct iovec *iovecs = ALLOCV_N(struct iovec, storage, count);
+	size_t size = IO_Event_Selector_iovecs_for_reading(buffers, iovecs, count);
+	
+	if (length > size) {
+		ALLOCV_END(storage);
+		rb_raise(rb_eRuntimeError, "Length exceeds size of buffers!");
+	}
+	
+	VALUE result = io_vector(self, fiber, io, 1, iovecs, count, length);
+	
+	ALLOCV_END(storage);
+	
+	return result;
+}
+
+struct io_sendfile_arguments {
+	VALUE self;
+	VALUE fiber;
+	VALUE out_io;
+	
+	int out;
+	int in;
+	off_t offset;
+	size_t length;
+	
+	// `sendfile` has no per-call equivalent of `MSG_DONTWAIT`, so the output must be made non-blocking:
+	int flags;
+};
+
+static
+VALUE io_sendfile_loop(VALUE _arguments) {
+	struct io_sendfile_arguments *arguments = (struct io_sendfile_arguments *)_arguments;
+	
+	off_t offset = arguments->offset;
+	size_t total = 0;
+	
+	while (total < arguments->length) {
+		ssize_t result = sendfile(arguments->out, arguments->in, &offset, arguments->length - total);
+		
+		if (result > 0) {
+			total += result;
+		} else if (result == 0) {
+			break;
+		} else if (IO_Event_try_again(errno)) {
+			IO_Event_Selector_EPoll_io_wait(arguments->self, arguments->fiber, arguments->out_io, RB_INT2NUM(IO_EVENT_WRITABLE));
+		} else {
+			return rb_fiber_scheduler_io_result(-1, errno);
+		}
+	}
+	
+	return rb_fiber_scheduler_io_result(total, 0);
+}
+
+static
+VALUE io_sendfile_ensure(VALUE _arguments) {
+	struct io_sendfile_arguments *arguments = (struct io_sendfile_arguments *)_arguments;
+	
+	IO_Event_Selector_nonblock_restore(arguments->out, arguments->flags);
+	
+	return Qnil;
+}
+
+// Send `length` bytes of the file `in`, starting at `offset`, to `out`, without copying the data through user space. Does not change the file position of `in`.
+VALUE IO_Event_Selector_EPoll_io_sendfile(VALUE self, VALUE fiber, VALUE out, VALUE in, VALUE _offset, VALUE _length) {
+	struct io_sendfile_arguments io_sendfile_arguments = {
+		.self = self,
+		.fiber = fiber,
+		.out_io = out,
+		
+		.out = IO_Event_Selector_io_descriptor(out),
+		.in = IO_Event_Selector_io_descriptor(in),
+		.offset = NUM2OFFT(_offset),
+		.length = NUM2SIZET(_length),
+	};
+	
+	io_sendfile_arguments.flags = IO_Event_Selector_nonblock_set(io_sendfile_arguments.out);
+	
+	return rb_ensure(io_sendfile_loop, (VALUE)&io_sendfile_arguments, io_sendfile_ensure, (VALUE)&io_sendfile_arguments);
+}
+
+struct io_copy_arguments {
+	VALUE self;
+	VALUE fiber;
+	VALUE source;
+	VALUE destination;
+	
+	int in, in_flags;
+	int out, out_flags;
+	size_t length;
+	
+	// The data is moved from the source to the destination through this pipe, without copying it into user space:
+	int pipe[2];
+};
+
+static
+VALUE io_copy_loop(VALUE _arguments) {
+	struct io_copy_arguments *arguments = (struct io_copy_arguments *)_arguments;
+	
+	size_t total = 0;
+	
+	while (total < arguments->length) {
+		// The kernel rejects lengths which would overflow `ssize_t`, and can't move more than the pipe holds anyway:
+		size_t length = arguments->length - total;
+		if (length > INT_MAX) length = INT_MAX;
+		
+		ssize_t result = splice(arguments->in, NULL, arguments->pipe[1], NULL, length, SPLICE_F_MOVE|SPLICE_F_NONBLOCK);
+		
+		if (result == 0) {
+			break;
+		} else if (result == -1) {
+			if (IO_Event_try_again(errno)) {
+				IO_Event_Selector_EPoll_io_wait(arguments->self, arguments->fiber, arguments->source, RB_INT2NUM(IO_EVENT_READABLE));
+				continue;
+			}
+			
+			return rb_fiber_scheduler_io_result(-1, errno);
+		}
+		
+		// Drain the pipe into the destination:
+		while (result > 0) {
+			ssize_t written = splice(arguments->pipe[0], NULL, arguments->out, NULL, result, SPLICE_F_MOVE|SPLICE_F_NONBLOCK);
+			
+			if (written > 0) {
+				result -= written;
+				total += written;
+			} else if (written == -1 && IO_Event_try_again(errno)) {
+				IO_Event_Selector_EPoll_io_wait(arguments->self, arguments->fiber, arguments->destination, RB_INT2NUM(IO_EVENT_WRITABLE));
+			} else {
+				return rb_fiber_scheduler_io_result(-1, written == 0 ? EPIPE : errno);
+			}
+		}
+	}
+	
+	return rb_fiber_scheduler_io_result(total, 0);
+}
+
+static
+VALUE io_copy_ensure(VALUE _arguments) {
+	struct io_copy_arguments *arguments = (struct io_copy_arguments *)_arguments;
+	
+	close(arguments->pipe[0]);
+	close(arguments->pipe[1]);
+	
+	IO_Event_Selector_nonblock_restore(arguments->in, arguments->in_flags);
+	IO_Event_Selector_nonblock_restore(arguments->out, arguments->out_flags);
+	
+	return Qnil;
+}
+
+// Copy up to `length` bytes (or until the end of the source if `length` is nil) from `source` to `destination`, without copying the data through user space.
+VALUE IO_Event_Selector_EPoll_io_copy(VALUE self, VALUE fiber, VALUE source, VALUE destination, VALUE _length) {
+	struct io_copy_arguments io_copy_arguments = {
+		.self = self,
+		.fiber = fiber,
+		.source = source,
+		.destination = destination,
+		
+		.in = IO_Event_Selector_io_descriptor(source),
+		.out = IO_Event_Selector_io_descriptor(destination),
+		.length = NIL_P(_length) ? SIZE_MAX : NUM2SIZET(_length),
+	};
+	
+	if (pipe2(io_copy_arguments.pipe, O_CLOEXEC) == -1) {
+		rb_sys_fail("IO_Event_Selector_EPoll_io_copy:pipe2");
+	}
+	
+	rb_update_max_fd(io_copy_arguments.pipe[0]);
+	rb_update_max_fd(io_copy_arguments.pipe[1]);
+	
+	io_copy_arguments.in_flags = IO_Event_Selector_nonblock_set(io_copy_arguments.in);
+	io_copy_arguments.out_flags = IO_Event_Selector_nonblock_set(io_copy_arguments.out);
+	
+	return rb_ensure(io_copy_loop, (VALUE)&io_copy_arguments, io_copy_ensure, (VALUE)&io_copy_arguments);
+}
+
+#ifdef MSG_ZEROCOPY
+
+struct io_write_zerocopy_arguments {
+	VALUE self;
+	VALUE fiber;
+	VALUE io;
+	
+	int descriptor;
+	
+	VALUE buffer;
+	size_t length;
+	size_t offset;
+	
+	// The number of zero-copy sends, and how many of them the kernel has finished with:
+	uint32_t sent, released;
+};
+
+// Read completion notifications from the error queue until the kernel has released the pages of every send.
+static
+int io_write_zerocopy_release(struct io_write_zerocopy_arguments *arguments) {
+	while (arguments->released < arguments->sent) {
+		char control[CMSG_SPACE(sizeof(struct sock_extended_err)) * 4];
+		struct msghdr message = {.msg_control = control, .msg_controllen = sizeof(control)};
+		
+		ssize_t result = recvmsg(arguments->descriptor, &message, MSG_ERRQUEUE|MSG_DONTWAIT);
+		
+		if (result == -1) {
+			if (errno == EINTR) continue;
+			
+			if (IO_Event_try_again(errno)) {
+				// The error queue is signalled with EPOLLERR. Waiting for readability would resume us whenever the peer sends data, without a notification to collect:
+				io_wait(arguments->self, arguments->fiber, arguments->io, RB_INT2NUM(IO_EVENT_ERROR), NULL);
+				continue;
+			}
+			
+			return errno;
+		}
+		
+		for (struct cmsghdr *header = CMSG_FIRSTHDR(&message); header; header = CMSG_NXTHDR(&message, header)) {
+			if ((header->cmsg_level == SOL_IP && header->cmsg_type == IP_RECVERR) || (header->cmsg_level == SOL_IPV6 && header->cmsg_type == IPV6_RECVERR)) {
+				struct sock_extended_err *error = (struct sock_extended_err *)CMSG_DATA(header);
+				
+				// Each notification covers an inclusive range of sends:
+				if (error->ee_origin == SO_EE_ORIGIN_ZEROCOPY) {
+					arguments->released += error->ee_data - error->ee_info + 1;
+				}
+			}
+		}
+	}
+	
+	return 0;
+}
+
+static
+VALUE io_write_zerocopy_loop(VALUE _arguments) {
+	struct io_write_zerocopy_arguments *arguments = (struct io_write_zerocopy_arguments *)_arguments;
+	
+	const void *base;
+	size_t size;
+	rb_io_buffer_get_bytes_for_reading(arguments->buffer, &base, &size);
+	
+	size_t length = arguments->length;
+	size_t offset = arguments->offset;
+	int error = 0;
+	
+	if (length > size) {
+		rb_raise(rb_eRuntimeError, "Length exceeds size of buffer!");
+	}
+	
+	while (true) {
+		size_t maximum_size = size - offset;
+		ssize_t result = send(arguments->descriptor, (char*)base+offset, maximum_size, MSG_ZEROCOPY|MSG_DONTWAIT);
+		
+		if (result > 0) {
+			arguments->sent += 1;
+			offset += result;
+			if ((size_t)result >= length) break;
+			length -= result;
+		} else if (result == 0) {
+			break;
+		} else if (errno == EINTR) {
+			continue;
+		} else if (errno == ENOBUFS && arguments->released < arguments->sent) {
+			// Too many pages are pinned by this socket, so wait for the kernel to release some of them:
+			if ((error = io_write_zerocopy_release(arguments))) break;
+		} else if (length > 0 && IO_Event_try_again(errno)) {
+			if (NIL_P(io_wait_operation(arguments->self, arguments->fiber, arguments->io, RB_INT2NUM(IO_EVENT_WRITABLE), NULL))) {
+				// Return whatever we managed to write, once the kernel has released it:
+				if (offset == arguments->offset) error = ECANCELED;
+				break;
+			}
+		} else {
+			error = errno;
+			break;
+		}
+	}
+	
+	// The buffer can't be released until the kernel has finished with it, even if the send failed:
+	int release_error = io_write_zerocopy_release(arguments);
+	if (!error) error = release_error;
+	
+	if (error) {
+		return rb_fiber_scheduler_io_result(-1, error);
+	}
+	
+	return rb_fiber_scheduler_io_result(offset, 0);
+}
+
+static
+VALUE io_write_zerocopy_ensure(VALUE _arguments) {
+	struct io_write_zerocopy_arguments *arguments = (struct io_write_zerocopy_arguments *)_arguments;
+	
+	rb_io_buffer_unlock(arguments->buffer);
+	
+	return Qnil;
+}
+
+// Enable `SO_ZEROCOPY` on the socket, remembering the result so that subsequent writes don't need the system call.
+static
+int io_write_zerocopy_enable(struct IO_Event_Selector_EPoll *data, int descriptor) {
+	struct IO_Event_Selector_Descriptor *state = IO_Event_Selector_Descriptors_lookup(&data->descriptors, descriptor);
+	
+	// Probe first, so that the type of the descriptor is known and probing later won't discard what we record here:
+	if (!IO_Event_Selector_Descriptor_socket_p(state, descriptor)) return 0;
+	
+	if (state->flags & IO_EVENT_SELECTOR_DESCRIPTOR_ZEROCOPY) return 1;
+	if (state->flags & IO_EVENT_SELECTOR_DESCRIPTOR_ZEROCOPY_UNSUPPORTED) return 0;
+	
+	int enable = 1;
+	
+	if (setsockopt(descriptor, SOL_SOCKET, SO_ZEROCOPY, &enable, sizeof(enable)) == -1) {
+		state->flags |= IO_EVENT_SELECTOR_DESCRIPTOR_ZEROCOPY_UNSUPPORTED;
+		return 0;
+	}
+	
+	state->flags |= IO_EVENT_SELECTOR_DESCRIPTOR_ZEROCOPY;
+	return 1;
+}
+
+// Write to a socket like `io_write`, but transmit the data directly from the pages of the buffer, which stays locked until the kernel has released them. Small writes, and sockets which don't support `SO_ZEROCOPY`, fall back to `io_write`.
+VALUE IO_Event_Selector_EPoll_io_write_zerocopy(VALUE self, VALUE fiber, VALUE io, VALUE buffer, VALUE _length, VALUE _offset) {
+	struct IO_Event_Selector_EPoll *data = NULL;
+	TypedData_Get_Struct(self, struct IO_Event_Selector_EPoll, &IO_Event_Selector_EPoll_Type, data);
+	
+	int descriptor = IO_Event_Selector_io_descriptor(io);
+	size_t length = NUM2SIZET(_length);
+	
+	if (length < IO_EVENT_SELECTOR_ZEROCOPY_MINIMUM || !io_write_zerocopy_enable(data, descriptor)) {
+		return io_write(self, fiber, io, buffer, _length, _offset, NULL);
+	}
+	
+	struct io_write_zerocopy_arguments io_write_zerocopy_arguments = {
+		.self = self,
+		.fiber = fiber,
+		.io = io,
+		
+		.descriptor = descriptor,
+		.buffer = buffer,
+		.length = length,
+		.offset = NUM2SIZET(_offset),
+	};
+	
+	rb_io_buffer_lock(buffer);
+	
+	return rb_ensure(io_write_zerocopy_loop, (VALUE)&io_write_zerocopy_arguments, io_write_zerocopy_ensure, (VALUE)&io_write_zerocopy_arguments);
+}
+
+#endif
+
+// Receive one or more datagrams, one into each of the given buffers, returning an array of `[length, address, segment_size]` for each datagram received.
+VALUE IO_Event_Selector_EPoll_io_recvmsg(VALUE self, VALUE fiber, VALUE io, VALUE buffers) {
+	Check_Type(buffers, T_ARRAY);
+	
+	int descriptor = IO_Event_Selector_io_descriptor(io);
+	
+	struct mmsghdr messages[IO_EVENT_SELECTOR_MESSAGES_MAXIMUM];
+	struct IO_Event_Selector_Message storage[IO_EVENT_SELECTOR_MESSAGES_MAXIMUM];
+	
+	while (true) {
+		// The buffers (and the array itself) may have changed while we were waiting:
+		size_t count = RARRAY_LEN(buffers);
+		if (count > IO_EVENT_SELECTOR_MESSAGES_MAXIMUM) count = IO_EVENT_SELECTOR_MESSAGES_MAXIMUM;
+		
+		for (size_t i = 0; i < count; i += 1) {
+			IO_Event_Selector_message_for_writing(RARRAY_AREF(buffers, i), &messages[i].msg_hdr, &storage[i]);
+		}
+		
+		int result = recvmmsg(descriptor, messages, count, MSG_DONTWAIT, NULL);
+		
+		if (result >= 0) {
+			VALUE received = rb_ary_new_capa(result);
+			
+			for (int i = 0; i < result; i += 1) {
+				rb_ary_push(received, IO_Event_Selector_message_received(&messages[i].msg_hdr, messages[i].msg_len));
+			}
+			
+			return received;
+		} else if (errno == EINTR) {
+			continue;
+		} else if (IO_Event_try_again(errno)) {
+			io_wait(self, fiber, io, RB_INT2NUM(IO_EVENT_READABLE), NULL);
+		} else {
+			rb_sys_fail("IO_Event_Selector_EPoll_io_recvmsg:recvmmsg");
+		}
+	}
+}
+
+// Send one or more datagrams, each given as `[buffer, length, address, segment_size]`, returning the number which were sent. This may be fewer than the number given.
+VALUE IO_Event_Selector_EPoll_io_sendmsg(VALUE self, VALUE fiber, VALUE io, VALUE messages) {
+	Check_Type(messages, T_ARRAY);
+	
+	int descriptor = IO_Event_Selector_io_descriptor(io);
+	
+	struct mmsghdr headers[IO_EVENT_SELECTOR_MESSAGES_MAXIMUM];
+	struct IO_Event_Selector_Message storage[IO_EVENT_SELECTOR_MESSAGES_MAXIMUM];
+	
+	while (true) {
+		// The messages (and the array itself) may have changed while we were waiting:
+		size_t count = RARRAY_LEN(messages);
+		if (count > IO_EVENT_SELECTOR_MESSAGES_MAXIMUM) count = IO_EVENT_SELECTOR_MESSAGES_MAXIMUM;
+		
+		for (size_t i = 0; i < count; i += 1) {
+			IO_Event_Selector_message_for_reading(RARRAY_AREF(messages, i), &headers[i].msg_hdr, &storage[i]);
+		}
+		
+		int result = sendmmsg(descriptor, headers, count, MSG_DONTWAIT);
+		
+		if (result >= 0) {
+			return RB_INT2NUM(result);
+		} else if (errno == EINTR) {
+			continue;
+		} else if (IO_Event_try_again(errno)) {
+			io_wait(self, fiber, io, RB_INT2NUM(IO_EVENT_WRITABLE), NULL);
+		} else {
+			rb_sys_fail("IO_Event_Selector_EPoll_io_sendmsg:sendmmsg");
+		}
+	}
+}
+
+#endif
+
+static
+struct timespec * make_timeout(VALUE duration, struct timespec * storage) {
+	if (duration == Qnil) {
+		return NULL;
+	}
+	
+	if (FIXNUM_P(duration)) {
 		storage->tv_sec = NUM2TIMET(duration);
 		storage->tv_nsec = 0;
 		
@@ -605,7 +2566,7 @@ struct select_arguments {
 	
 	int count;
 	struct epoll_event events[EPOLL_MAX_EVENTS];
-
+	
 	struct timespec * timeout;
 	struct timespec storage;
 };
@@ -634,7 +2595,7 @@ int enosys_error(int result) {
 static
 void * select_internal(void *_arguments) {
 	struct select_arguments * arguments = (struct select_arguments *)_arguments;
-	
+
 #if defined(HAVE_EPOLL_PWAIT2)
 	arguments->count = epoll_pwait2(arguments->data->descriptor, arguments->events, EPOLL_MAX_EVENTS, arguments->timeout, NULL);
 	
@@ -649,7 +2610,7 @@ void * select_internal(void *_arguments) {
 		// Fall through and execute epoll_wait fallback.
 	}
 #endif
-	
+
 	arguments->count = epoll_wait(arguments->data->descriptor, arguments->events, EPOLL_MAX_EVENTS, make_timeout_ms(arguments->timeout));
 	
 	return NULL;
@@ -696,9 +2657,9 @@ VALUE IO_Event_Selector_EPoll_select(VALUE self, VALUE duration) {
 			.tv_nsec = 0
 		},
 	};
-
+	
 	arguments.timeout = &arguments.storage;
-
+	
 	// Process any currently pending events:
 	select_internal_with_gvl(&arguments);
 	
@@ -710,6 +2671,9 @@ VALUE IO_Event_Selector_EPoll_select(VALUE self, VALUE duration) {
 	if (!ready && !arguments.count && !data->backend.ready) {
 		arguments.timeout = make_timeout(duration, &arguments.storage);
 		
+		// Don't wait beyond the earliest deadline:
+		arguments.timeout = IO_Event_Selector_Timers_timeout(&data->timers, arguments.timeout, &arguments.storage);
+		
 		if (!timeout_nonblocking(arguments.timeout)) {
 			// Wait for events to occur
 			select_internal_without_gvl(&arguments);
@@ -720,16 +2684,38 @@ VALUE IO_Event_Selector_EPoll_select(VALUE self, VALUE duration) {
 		const struct epoll_event *event = &arguments.events[i];
 		if (DEBUG) fprintf(stderr, "-> ptr=%p events=%d\n", event->data.ptr, event->events);
 		
-		if (event->data.ptr) {
+		if ((uintptr_t)event->data.ptr & IO_EVENT_EPOLL_WAIT_MANY_TAG) {
+			io_wait_many_ready((struct io_wait_many_entry *)((uintptr_t)event->data.ptr & ~IO_EVENT_EPOLL_WAIT_MANY_TAG), event->events);
+		} else if (event->data.ptr) {
 			VALUE fiber = (VALUE)event->data.ptr;
 			VALUE result = INT2NUM(event->events);
 			
 			IO_Event_Selector_fiber_transfer(fiber, 1, &result);
 		} else {
 			IO_Event_Interrupt_clear(&data->interrupt);
+			
+			// Resume any fibers whose jobs were completed by the worker pool:
+			struct IO_Event_Worker_Job *job;
+			while ((job = IO_Event_Worker_Pool_pop(&data->pool))) {
+				IO_Event_Selector_fiber_transfer(job->fiber, 0, NULL);
+			}
+		}
+	}
+	
+	if (data->timers.count) {
+		struct timespec now;
+		IO_Event_Selector_current_time(&now);
+		
+		// Resume any fibers whose deadlines have expired:
+		struct IO_Event_Selector_Timer *timer;
+		while ((timer = IO_Event_Selector_Timers_expire(&data->timers, &now))) {
+			VALUE result = Qfalse;
+			IO_Event_Selector_fiber_transfer(timer->fiber, 1, &result);
 		}
 	}
 	
+	io_wait_many_free(&data->released);
+	
 	return INT2NUM(arguments.count);
 }
 
@@ -768,16 +2754,54 @@ void Init_IO_Event_Selector_EPoll(VALUE IO_Event_Selector) {
 	rb_define_method(IO_Event_Selector_EPoll, "wakeup", IO_Event_Selector_EPoll_wakeup, 0);
 	rb_define_method(IO_Event_Selector_EPoll, "close", IO_Event_Selector_EPoll_close, 0);
 	
-	rb_define_method(IO_Event_Selector_EPoll, "io_wait", IO_Event_Selector_EPoll_io_wait, 3);
+	rb_define_method(IO_Event_Selector_EPoll, "io_wait", IO_Event_Selector_EPoll_io_wait_compatible, -1);
+	rb_define_method(IO_Event_Selector_EPoll, "io_cancel", IO_Event_Selector_EPoll_io_cancel, 1);
+	rb_define_method(IO_Event_Selector_EPoll, "io_close", IO_Event_Selector_EPoll_io_close, 1);
+	rb_define_method(IO_Event_Selector_EPoll, "io_wait_many", IO_Event_Selector_EPoll_io_wait_many, -1);
+	rb_define_method(IO_Event_Selector_EPoll, "io_select", IO_Event_Selector_EPoll_io_select, 4);
 	
+	id_accepted = rb_intern("__io_event_accepted");
+	rb_define_method(IO_Event_Selector_EPoll, "io_accept", IO_Event_Selector_EPoll_io_accept, 2);
+
 #ifdef HAVE_RUBY_IO_BUFFER_H
 	rb_define_method(IO_Event_Selector_EPoll, "io_read", IO_Event_Selector_EPoll_io_read_compatible, -1);
 	rb_define_method(IO_Event_Selector_EPoll, "io_write", IO_Event_Selector_EPoll_io_write_compatible, -1);
-#endif
+	rb_define_method(IO_Event_Selector_EPoll, "io_read_until", IO_Event_Selector_EPoll_io_read_until, -1);
+	rb_define_method(IO_Event_Selector_EPoll, "io_read_adaptive", IO_Event_Selector_EPoll_io_read_adaptive, -1);
+	
+	rb_define_method(IO_Event_Selector_EPoll, "io_pread", IO_Event_Selector_EPoll_io_pread, 6);
+	rb_define_method(IO_Event_Selector_EPoll, "io_pwrite", IO_Event_Selector_EPoll_io_pwrite, 6);
 	
+	rb_define_method(IO_Event_Selector_EPoll, "io_readv", IO_Event_Selector_EPoll_io_readv, 4);
+	rb_define_method(IO_Event_Selector_EPoll, "io_writev", IO_Event_Selector_EPoll_io_writev, 4);
+	
+	rb_define_method(IO_Event_Selector_EPoll, "io_sendfile", IO_Event_Selector_EPoll_io_sendfile, 5);
+	rb_define_method(IO_Event_Selector_EPoll, "io_copy", IO_Event_Selector_EPoll_io_copy, 4);
+
+#ifdef MSG_ZEROCOPY
+	rb_define_method(IO_Event_Selector_EPoll, "io_write_zerocopy", IO_Event_Selector_EPoll_io_write_zerocopy, 5);
+#endif
+
+	rb_define_method(IO_Event_Selector_EPoll, "io_recvmsg", IO_Event_Selector_EPoll_io_recvmsg, 3);
+	rb_define_method(IO_Event_Selector_EPoll, "io_sendmsg", IO_Event_Selector_EPoll_io_sendmsg, 3);
+#endif
+
 	// Once compatibility isn't a concern, we can do this:
 	// rb_define_method(IO_Event_Selector_EPoll, "io_read", IO_Event_Selector_EPoll_io_read, 5);
 	// rb_define_method(IO_Event_Selector_EPoll, "io_write", IO_Event_Selector_EPoll_io_write, 5);
 	
-	rb_define_method(IO_Event_Selector_EPoll, "process_wait", IO_Event_Selector_EPoll_process_wait, 3);
+	rb_define_method(IO_Event_Selector_EPoll, "file_open", IO_Event_Selector_EPoll_file_open, 4);
+	rb_define_method(IO_Event_Selector_EPoll, "file_stat", IO_Event_Selector_EPoll_file_stat, 2);
+	rb_define_method(IO_Event_Selector_EPoll, "file_unlink", IO_Event_Selector_EPoll_file_unlink, 2);
+	rb_define_method(IO_Event_Selector_EPoll, "file_rename", IO_Event_Selector_EPoll_file_rename, 3);
+	
+	rb_define_method(IO_Event_Selector_EPoll, "io_fsync", IO_Event_Selector_EPoll_io_fsync, 2);
+	rb_define_method(IO_Event_Selector_EPoll, "io_fdatasync", IO_Event_Selector_EPoll_io_fdatasync, 2);
+	
+	rb_define_method(IO_Event_Selector_EPoll, "process_wait", IO_Event_Selector_EPoll_process_wait, -1);
+	rb_define_method(IO_Event_Selector_EPoll, "process_spawn", IO_Event_Selector_EPoll_process_spawn, -1);
+
+#ifdef HAVE_RB_FIBER_SCHEDULER_BLOCKING_OPERATION_EXTRACT
+	rb_define_method(IO_Event_Selector_EPoll, "blocking_operation_wait", IO_Event_Selector_EPoll_blocking_operation_wait, 2);
+#endif
 }
@@ -42,6 +42,8 @@ struct IO_Event_Selector_KQueue {
 	int descriptor;
 	
 	int blocked;
+	
+	struct IO_Event_Selector_Descriptors descriptors;
 };
 
 void IO_Event_Selector_KQueue_Type_mark(void *_data)
@@ -64,6 +66,8 @@ void IO_Event_Selector_KQueue_Type_free(void *_data)
 	
 	close_internal(data);
 	
+	IO_Event_Selector_Descriptors_free(&data->descriptors);
+	
 	free(data);
 }
 
@@ -91,6 +95,8 @@ VALUE IO_Event_Selector_KQueue_allocate(VALUE self) {
 	data->descriptor = -1;
 	data->blocked = 0;
 	
+	IO_Event_Selector_Descriptors_initialize(&data->descriptors);
+	
 	return instance;
 }
 
@@ -227,7 +233,7 @@ VALUE process_wait_transfer(VALUE _arguments) {
 	
 	IO_Event_Selector_fiber_transfer(arguments->data->backend.loop, 0, NULL);
 	
-	return IO_Event_Selector_process_status_wait(arguments->pid);
+	return IO_Event_Selector_process_status_wait(arguments->pid, arguments->flags);
 }
 
 static
@@ -258,7 +264,7 @@ VALUE IO_Event_Selector_KQueue_process_wait(VALUE self, VALUE fiber, VALUE pid,
 		if (waiting) {
 			result = rb_rescue(process_wait_transfer, (VALUE)&process_wait_arguments, process_wait_rescue, (VALUE)&process_wait_arguments);
 		} else {
-			result = IO_Event_Selector_process_status_wait(process_wait_arguments.pid);
+			result = IO_Event_Selector_process_status_wait(process_wait_arguments.pid, process_wait_arguments.flags);
 		}
 	}
 	
@@ -387,7 +393,7 @@ struct io_read_arguments {
 	VALUE fiber;
 	VALUE io;
 	
-	int flags;
+	struct IO_Event_Selector_Nonblock nonblock;
 	
 	int descriptor;
 	
@@ -412,7 +418,7 @@ VALUE io_read_loop(VALUE _arguments) {
 	while (true) {
 		size_t maximum_size = size - offset;
 		if (DEBUG_IO_READ) fprintf(stderr, "read(%d, +%ld, %ld)\n", arguments->descriptor, offset, maximum_size);
-		ssize_t result = read(arguments->descriptor, (char*)base+offset, maximum_size);
+		ssize_t result = IO_Event_Selector_Nonblock_read(&arguments->nonblock, (char*)base+offset, maximum_size);
 		if (DEBUG_IO_READ) fprintf(stderr, "read(%d, +%ld, %ld) -> %zd\n", arguments->descriptor, offset, maximum_size, result);
 		
 		if (result > 0) {
@@ -438,7 +444,7 @@ static
 VALUE io_read_ensure(VALUE _arguments) {
 	struct io_read_arguments *arguments = (struct io_read_arguments *)_arguments;
 	
-	IO_Event_Selector_nonblock_restore(arguments->descriptor, arguments->flags);
+	IO_Event_Selector_Nonblock_restore(&arguments->nonblock);
 	
 	return Qnil;
 }
@@ -457,13 +463,14 @@ VALUE IO_Event_Selector_KQueue_io_read(VALUE self, VALUE fiber, VALUE io, VALUE
 		.fiber = fiber,
 		.io = io,
 		
-		.flags = IO_Event_Selector_nonblock_set(descriptor),
 		.descriptor = descriptor,
 		.buffer = buffer,
 		.length = length,
 		.offset = offset,
 	};
 	
+	IO_Event_Selector_Nonblock_set(&io_read_arguments.nonblock, &data->descriptors, descriptor);
+	
 	return rb_ensure(io_read_loop, (VALUE)&io_read_arguments, io_read_ensure, (VALUE)&io_read_arguments);
 }
 
@@ -485,7 +492,7 @@ struct io_write_arguments {
 	VALUE fiber;
 	VALUE io;
 	
-	int flags;
+	struct IO_Event_Selector_Nonblock nonblock;
 	
 	int descriptor;
 	
@@ -514,7 +521,7 @@ VALUE io_write_loop(VALUE _arguments) {
 	while (true) {
 		size_t maximum_size = size - offset;
 		if (DEBUG_IO_WRITE) fprintf(stderr, "write(%d, +%ld, %ld, length=%zu)\n", arguments->descriptor, offset, maximum_size, length);
-		ssize_t result = write(arguments->descriptor, (char*)base+offset, maximum_size);
+		ssize_t result = IO_Event_Selector_Nonblock_write(&arguments->nonblock, (char*)base+offset, maximum_size);
 		if (DEBUG_IO_WRITE) fprintf(stderr, "write(%d, +%ld, %ld) -> %zd\n", arguments->descriptor, offset, maximum_size, result);
 		
 		if (result > 0) {
@@ -540,7 +547,7 @@ static
 VALUE io_write_ensure(VALUE _arguments) {
 	struct io_write_arguments *arguments = (struct io_write_arguments *)_arguments;
 	
-	IO_Event_Selector_nonblock_restore(arguments->descriptor, arguments->flags);
+	IO_Event_Selector_Nonblock_restore(&arguments->nonblock);
 	
 	return Qnil;
 };
@@ -559,13 +566,14 @@ VALUE IO_Event_Selector_KQueue_io_write(VALUE self, VALUE fiber, VALUE io, VALUE
 		.fiber = fiber,
 		.io = io,
 		
-		.flags = IO_Event_Selector_nonblock_set(descriptor),
 		.descriptor = descriptor,
 		.buffer = buffer,
 		.length = length,
 		.offset = offset,
 	};
 	
+	IO_Event_Selector_Nonblock_set(&io_write_arguments.nonblock, &data->descriptors, descriptor);
+	
 	return rb_ensure(io_write_loop, (VALUE)&io_write_arguments, io_write_ensure, (VALUE)&io_write_arguments);
 }
 
@@ -20,6 +20,8 @@
 
 #include <sys/types.h>
 #include <sys/syscall.h>
+#include <sys/wait.h>
+#include <errno.h>
 #include <unistd.h>
 #include <poll.h>
 #include <stdlib.h>
@@ -34,3 +36,103 @@ pidfd_open(pid_t pid, unsigned int flags)
 {
 	return syscall(__NR_pidfd_open, pid, flags);
 }
+
+// The `waitid` id type for pidfds, which is not defined by older C libraries:
+static const int IO_EVENT_P_PIDFD = 3;
+
+// Whether the pidfd still refers to a child which has not been reaped. If it was reaped elsewhere (e.g. by `Process.wait`), the pid may since have been reused, so the pidfd must not be used to wait for it.
+static
+int IO_Event_Selector_process_pidfd_valid_p(int descriptor)
+{
+	siginfo_t info = {0};
+	
+	// Checking without reaping will only fail with `ECHILD` if the process is gone. Older kernels don't support waiting on a pidfd, in which case we have to trust it:
+	if (waitid((idtype_t)IO_EVENT_P_PIDFD, descriptor, &info, WEXITED|WNOHANG|WNOWAIT) == -1) {
+		return errno != ECHILD;
+	}
+	
+	return 1;
+}
+
+static
+int IO_Event_Selector_process_pidfds_prune(st_data_t key, st_data_t value, st_data_t argument)
+{
+	if (IO_Event_Selector_process_pidfd_valid_p((int)value)) {
+		return ST_CONTINUE;
+	}
+	
+	close((int)value);
+	
+	return ST_DELETE;
+}
+
+// The number of pidfds at which we first check for stale entries:
+#define IO_EVENT_SELECTOR_PIDFDS_PRUNE_MINIMUM 16
+
+// Checking every entry costs a system call each, so only do it each time the table doubles in size, which keeps the average cost per spawn constant:
+static inline
+int IO_Event_Selector_process_pidfds_prune_p(st_table *pidfds)
+{
+	size_t count = pidfds->num_entries;
+	
+	return count >= IO_EVENT_SELECTOR_PIDFDS_PRUNE_MINIMUM && (count & (count - 1)) == 0;
+}
+
+// Spawn a process using `Process.spawn`, and immediately open a pidfd for it. Because the child can't be reaped until we wait for it, the pid can't be reused before the pidfd is opened. The pidfd is kept until the process is waited on.
+static
+VALUE IO_Event_Selector_process_spawn(st_table **pidfds, int argc, VALUE *argv)
+{
+	VALUE pid = rb_funcallv_kw(rb_mProcess, rb_intern("spawn"), argc, argv, RB_PASS_CALLED_KEYWORDS);
+	
+	int descriptor = pidfd_open(NUM2PIDT(pid), 0);
+	
+	if (descriptor >= 0) {
+		rb_update_max_fd(descriptor);
+		
+		if (*pidfds == NULL) {
+			*pidfds = st_init_numtable();
+		} else if (IO_Event_Selector_process_pidfds_prune_p(*pidfds)) {
+			// Processes which were reaped without going through the selector would otherwise keep their pidfds open forever:
+			st_foreach(*pidfds, IO_Event_Selector_process_pidfds_prune, 0);
+		}
+		
+		st_insert(*pidfds, (st_data_t)NUM2PIDT(pid), (st_data_t)descriptor);
+	}
+	
+	return pid;
+}
+
+// Take ownership of the pidfd for the given process, if it was spawned by `IO_Event_Selector_process_spawn` and has not been reaped since, otherwise return -1.
+static
+int IO_Event_Selector_process_pidfd(st_table *pidfds, pid_t pid)
+{
+	st_data_t key = (st_data_t)pid, value = 0;
+	
+	if (pidfds && st_delete(pidfds, &key, &value)) {
+		if (IO_Event_Selector_process_pidfd_valid_p((int)value)) {
+			return (int)value;
+		}
+		
+		close((int)value);
+	}
+	
+	return -1;
+}
+
+static
+int IO_Event_Selector_process_pidfds_close(st_data_t key, st_data_t value, st_data_t argument)
+{
+	close((int)value);
+	
+	return ST_CONTINUE;
+}
+
+static
+void IO_Event_Selector_process_pidfds_free(st_table **pidfds)
+{
+	if (*pidfds) {
+		st_foreach(*pidfds, IO_Event_Selector_process_pidfds_close, 0);
+		st_free_table(*pidfds);
+		*pidfds = NULL;
+	}
+}
@@ -0,0 +1,1033 @@
+// Copyright, 2021, by Samuel G. D. Williams. <http://www.codeotaku.com>
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "poll.h"
+#include "selector.h"
+
+#include <poll.h>
+#include <time.h>
+#include <errno.h>
+
+#ifdef __linux__
+#include "pidfd.c"
+#endif
+
+#include "../interrupt.h"
+
+enum {
+	DEBUG = 0,
+};
+
+static VALUE IO_Event_Selector_Poll = Qnil;
+
+static ID id_Event, id_Reaper, id_attach, id_close, id_wait;
+
+enum {POLL_INITIAL_CAPACITY = 64};
+
+// A fiber waiting on a descriptor. These are allocated on the stack of the waiting fiber, and linked into the list of waiters for the corresponding entry in the poll set.
+struct IO_Event_Selector_Poll_Waiter {
+	struct IO_Event_Selector_Poll_Waiter *previous;
+	struct IO_Event_Selector_Poll_Waiter *next;
+	
+	VALUE fiber;
+	
+	// The descriptor we are waiting on, or -1 if the waiter was already removed from the poll set:
+	int descriptor;
+	short events;
+};
+
+struct IO_Event_Selector_Poll_Ready {
+	VALUE fiber;
+	short revents;
+};
+
+struct IO_Event_Selector_Poll {
+	struct IO_Event_Selector backend;
+	struct IO_Event_Interrupt interrupt;
+	int blocked;
+	
+	// The poll set, which is updated incrementally as waiters come and go. The first entry is always the interrupt:
+	size_t count, capacity;
+	struct pollfd *pollfds;
+	struct IO_Event_Selector_Poll_Waiter **waiting;
+	
+	// Maps descriptors to their index in the poll set, offset by one so that zero means the descriptor is not present:
+	size_t size;
+	size_t *indexes;
+	
+	// Fibers which were made ready by the most recent poll:
+	size_t ready_count, ready_capacity;
+	struct IO_Event_Selector_Poll_Ready *ready;
+	
+	struct IO_Event_Selector_Descriptors descriptors;
+	
+	// An `IO::Event::Reaper` which waits for processes using `SIGCHLD`, when we can't wait on them directly:
+	VALUE reaper;
+	
+#ifdef __linux__
+	// Maps the pids of processes spawned by `process_spawn` to their pidfds:
+	st_table *pidfds;
+#endif
+};
+
+void IO_Event_Selector_Poll_Type_mark(void *_data)
+{
+	struct IO_Event_Selector_Poll *data = _data;
+	IO_Event_Selector_mark(&data->backend);
+	rb_gc_mark(data->reaper);
+}
+
+static
+void close_internal(struct IO_Event_Selector_Poll *data) {
+	if (data->pollfds) {
+		IO_Event_Interrupt_close(&data->interrupt);
+		
+		xfree(data->pollfds);
+		data->pollfds = NULL;
+		
+		xfree(data->waiting);
+		data->waiting = NULL;
+		
+		data->count = data->capacity = 0;
+	}
+	
+#ifdef __linux__
+	IO_Event_Selector_process_pidfds_free(&data->pidfds);
+#endif
+}
+
+void IO_Event_Selector_Poll_Type_free(void *_data)
+{
+	struct IO_Event_Selector_Poll *data = _data;
+	
+	close_internal(data);
+	
+	if (data->indexes) xfree(data->indexes);
+	if (data->ready) xfree(data->ready);
+	
+	IO_Event_Selector_Descriptors_free(&data->descriptors);
+	
+	free(data);
+}
+
+size_t IO_Event_Selector_Poll_Type_size(const void *_data)
+{
+	const struct IO_Event_Selector_Poll *data = _data;
+	
+	return sizeof(struct IO_Event_Selector_Poll)
+		+ data->capacity * (sizeof(struct pollfd) + sizeof(struct IO_Event_Selector_Poll_Waiter *))
+		+ data->size * sizeof(size_t)
+		+ data->ready_capacity * sizeof(struct IO_Event_Selector_Poll_Ready)
+	;
+}
+
+static const rb_data_type_t IO_Event_Selector_Poll_Type = {
+	.wrap_struct_name = "IO_Event::Backend::Poll",
+	.function = {
+		.dmark = IO_Event_Selector_Poll_Type_mark,
+		.dfree = IO_Event_Selector_Poll_Type_free,
+		.dsize = IO_Event_Selector_Poll_Type_size,
+	},
+	.data = NULL,
+	.flags = RUBY_TYPED_FREE_IMMEDIATELY,
+};
+
+VALUE IO_Event_Selector_Poll_allocate(VALUE self) {
+	struct IO_Event_Selector_Poll *data = NULL;
+	VALUE instance = TypedData_Make_Struct(self, struct IO_Event_Selector_Poll, &IO_Event_Selector_Poll_Type, data);
+	
+	IO_Event_Selector_initialize(&data->backend, Qnil);
+	data->blocked = 0;
+	
+	data->count = data->capacity = 0;
+	data->pollfds = NULL;
+	data->waiting = NULL;
+	
+	data->size = 0;
+	data->indexes = NULL;
+	
+	data->ready_count = data->ready_capacity = 0;
+	data->ready = NULL;
+	
+	IO_Event_Selector_Descriptors_initialize(&data->descriptors);
+	
+	data->reaper = Qnil;
+	
+#ifdef __linux__
+	data->pidfds = NULL;
+#endif
+	
+	return instance;
+}
+
+#pragma mark - Poll Set
+
+static
+size_t * poll_set_index(struct IO_Event_Selector_Poll *data, int descriptor) {
+	size_t index = (size_t)descriptor;
+	
+	if (index >= data->size) {
+		size_t size = data->size ? data->size : POLL_INITIAL_CAPACITY;
+		while (size <= index) size *= 2;
+		
+		data->indexes = xrealloc2(data->indexes, size, sizeof(size_t));
+		memset(data->indexes + data->size, 0, (size - data->size) * sizeof(size_t));
+		data->size = size;
+	}
+	
+	return &data->indexes[index];
+}
+
+// Append a new entry to the poll set, returning its index.
+static
+size_t poll_set_append(struct IO_Event_Selector_Poll *data, int descriptor) {
+	if (data->count == data->capacity) {
+		size_t capacity = data->capacity ? data->capacity * 2 : POLL_INITIAL_CAPACITY;
+		
+		data->pollfds = xrealloc2(data->pollfds, capacity, sizeof(struct pollfd));
+		data->waiting = xrealloc2(data->waiting, capacity, sizeof(struct IO_Event_Selector_Poll_Waiter *));
+		data->capacity = capacity;
+	}
+	
+	size_t index = data->count++;
+	
+	data->pollfds[index].fd = descriptor;
+	data->pollfds[index].events = 0;
+	data->pollfds[index].revents = 0;
+	data->waiting[index] = NULL;
+	
+	return index;
+}
+
+// Recompute the events for the given entry, removing it from the poll set if there are no more waiters. The last entry is moved into its place, so the caller must re-examine the same index.
+static
+void poll_set_update(struct IO_Event_Selector_Poll *data, size_t index) {
+	short events = 0;
+	
+	for (struct IO_Event_Selector_Poll_Waiter *waiter = data->waiting[index]; waiter; waiter = waiter->next) {
+		events |= waiter->events;
+	}
+	
+	if (events) {
+		data->pollfds[index].events = events;
+		return;
+	}
+	
+	int descriptor = data->pollfds[index].fd;
+	size_t last = data->count - 1;
+	
+	if (index != last) {
+		data->pollfds[index] = data->pollfds[last];
+		data->waiting[index] = data->waiting[last];
+		data->indexes[data->pollfds[index].fd] = index + 1;
+	}
+	
+	data->indexes[descriptor] = 0;
+	data->count -= 1;
+}
+
+static
+void poll_set_add(struct IO_Event_Selector_Poll *data, struct IO_Event_Selector_Poll_Waiter *waiter) {
+	size_t *index = poll_set_index(data, waiter->descriptor);
+	
+	if (*index == 0) {
+		*index = poll_set_append(data, waiter->descriptor) + 1;
+	}
+	
+	size_t i = *index - 1;
+	
+	waiter->previous = NULL;
+	waiter->next = data->waiting[i];
+	if (waiter->next) waiter->next->previous = waiter;
+	data->waiting[i] = waiter;
+	
+	data->pollfds[i].events |= waiter->events;
+}
+
+static
+void poll_set_unlink(struct IO_Event_Selector_Poll *data, size_t index, struct IO_Event_Selector_Poll_Waiter *waiter) {
+	if (waiter->previous) {
+		waiter->previous->next = waiter->next;
+	} else {
+		data->waiting[index] = waiter->next;
+	}
+	
+	if (waiter->next) {
+		waiter->next->previous = waiter->previous;
+	}
+	
+	waiter->previous = waiter->next = NULL;
+	waiter->descriptor = -1;
+}
+
+static
+void poll_set_remove(struct IO_Event_Selector_Poll *data, struct IO_Event_Selector_Poll_Waiter *waiter) {
+	// The waiter was already removed by `select`:
+	if (waiter->descriptor < 0 || data->pollfds == NULL) return;
+	
+	size_t index = data->indexes[waiter->descriptor] - 1;
+	
+	poll_set_unlink(data, index, waiter);
+	poll_set_update(data, index);
+}
+
+#pragma mark - Methods
+
+VALUE IO_Event_Selector_Poll_initialize(VALUE self, VALUE loop) {
+	struct IO_Event_Selector_Poll *data = NULL;
+	TypedData_Get_Struct(self, struct IO_Event_Selector_Poll, &IO_Event_Selector_Poll_Type, data);
+	
+	IO_Event_Selector_initialize(&data->backend, loop);
+	
+	IO_Event_Interrupt_open(&data->interrupt);
+	
+	int descriptor = IO_Event_Interrupt_descriptor(&data->interrupt);
+	*poll_set_index(data, descriptor) = poll_set_append(data, descriptor) + 1;
+	data->pollfds[0].events = POLLIN;
+	
+	return self;
+}
+
+VALUE IO_Event_Selector_Poll_loop(VALUE self) {
+	struct IO_Event_Selector_Poll *data = NULL;
+	TypedData_Get_Struct(self, struct IO_Event_Selector_Poll, &IO_Event_Selector_Poll_Type, data);
+	
+	return data->backend.loop;
+}
+
+VALUE IO_Event_Selector_Poll_close(VALUE self) {
+	struct IO_Event_Selector_Poll *data = NULL;
+	TypedData_Get_Struct(self, struct IO_Event_Selector_Poll, &IO_Event_Selector_Poll_Type, data);
+	
+	// The reaper's pipe is closed by the garbage collector if we are not closed explicitly:
+	if (!NIL_P(data->reaper)) {
+		rb_funcall(data->reaper, id_close, 0);
+		data->reaper = Qnil;
+	}
+	
+	close_internal(data);
+	
+	return Qnil;
+}
+
+VALUE IO_Event_Selector_Poll_transfer(VALUE self)
+{
+	struct IO_Event_Selector_Poll *data = NULL;
+	TypedData_Get_Struct(self, struct IO_Event_Selector_Poll, &IO_Event_Selector_Poll_Type, data);
+	
+	return IO_Event_Selector_fiber_transfer(data->backend.loop, 0, NULL);
+}
+
+VALUE IO_Event_Selector_Poll_resume(int argc, VALUE *argv, VALUE self)
+{
+	struct IO_Event_Selector_Poll *data = NULL;
+	TypedData_Get_Struct(self, struct IO_Event_Selector_Poll, &IO_Event_Selector_Poll_Type, data);
+	
+	return IO_Event_Selector_resume(&data->backend, argc, argv);
+}
+
+VALUE IO_Event_Selector_Poll_yield(VALUE self)
+{
+	struct IO_Event_Selector_Poll *data = NULL;
+	TypedData_Get_Struct(self, struct IO_Event_Selector_Poll, &IO_Event_Selector_Poll_Type, data);
+	
+	return IO_Event_Selector_yield(&data->backend);
+}
+
+VALUE IO_Event_Selector_Poll_push(VALUE self, VALUE fiber)
+{
+	struct IO_Event_Selector_Poll *data = NULL;
+	TypedData_Get_Struct(self, struct IO_Event_Selector_Poll, &IO_Event_Selector_Poll_Type, data);
+	
+	IO_Event_Selector_queue_push(&data->backend, fiber);
+	
+	return Qnil;
+}
+
+VALUE IO_Event_Selector_Poll_raise(int argc, VALUE *argv, VALUE self)
+{
+	struct IO_Event_Selector_Poll *data = NULL;
+	TypedData_Get_Struct(self, struct IO_Event_Selector_Poll, &IO_Event_Selector_Poll_Type, data);
+	
+	return IO_Event_Selector_raise(&data->backend, argc, argv);
+}
+
+VALUE IO_Event_Selector_Poll_ready_p(VALUE self) {
+	struct IO_Event_Selector_Poll *data = NULL;
+	TypedData_Get_Struct(self, struct IO_Event_Selector_Poll, &IO_Event_Selector_Poll_Type, data);
+	
+	return data->backend.ready ? Qtrue : Qfalse;
+}
+
+#pragma mark - IO#wait
+
+static inline
+short poll_flags_from_events(int events) {
+	short flags = 0;
+	
+	if (events & IO_EVENT_READABLE) flags |= POLLIN;
+	if (events & IO_EVENT_PRIORITY) flags |= POLLPRI;
+	if (events & IO_EVENT_WRITABLE) flags |= POLLOUT;
+	
+#ifdef POLLRDHUP
+	// The peer shutting down its side of the connection is only reported if requested:
+	if (events & IO_EVENT_HANGUP) flags |= POLLRDHUP;
+#endif
+	
+	flags |= POLLHUP;
+	flags |= POLLERR;
+	
+	return flags;
+}
+
+// See `epoll.c` for details regarding the reporting of hangups and errors.
+static inline
+int events_from_poll_flags(short flags, int requested) {
+	int events = 0;
+	
+	// See `epoll.c` for details regarding POLLHUP:
+	if (flags & (POLLIN|POLLHUP|POLLERR)) events |= IO_EVENT_READABLE;
+	if (flags & POLLPRI) events |= IO_EVENT_PRIORITY;
+	if (flags & POLLOUT) events |= IO_EVENT_WRITABLE;
+	
+#ifdef POLLRDHUP
+	if (flags & POLLRDHUP) events |= (requested & IO_EVENT_HANGUP);
+#endif
+	
+	if (flags & POLLHUP) events |= (requested & IO_EVENT_HANGUP);
+	if (flags & POLLERR) events |= (requested & IO_EVENT_ERROR);
+	
+	return events;
+}
+
+struct io_wait_arguments {
+	struct IO_Event_Selector_Poll *data;
+	struct IO_Event_Selector_Poll_Waiter *waiter;
+	int events;
+};
+
+static
+VALUE io_wait_ensure(VALUE _arguments) {
+	struct io_wait_arguments *arguments = (struct io_wait_arguments *)_arguments;
+	
+	poll_set_remove(arguments->data, arguments->waiter);
+	
+	return Qnil;
+}
+
+static
+VALUE io_wait_transfer(VALUE _arguments) {
+	struct io_wait_arguments *arguments = (struct io_wait_arguments *)_arguments;
+	
+	VALUE result = IO_Event_Selector_fiber_transfer(arguments->data->backend.loop, 0, NULL);
+	
+	// If the fiber is being cancelled, it might be resumed with nil:
+	if (!RTEST(result)) {
+		return Qfalse;
+	}
+	
+	// POLLNVAL is reported for closed descriptors, in which case we report all the requested events so that the subsequent operation fails:
+	short flags = NUM2INT(result);
+	if (flags & POLLNVAL) flags |= arguments->waiter->events;
+	
+	return INT2NUM(events_from_poll_flags(arguments->waiter->events & flags, arguments->events));
+}
+
+VALUE IO_Event_Selector_Poll_io_wait(VALUE self, VALUE fiber, VALUE io, VALUE events) {
+	struct IO_Event_Selector_Poll *data = NULL;
+	TypedData_Get_Struct(self, struct IO_Event_Selector_Poll, &IO_Event_Selector_Poll_Type, data);
+	
+	struct IO_Event_Selector_Poll_Waiter waiter = {
+		.fiber = fiber,
+		.descriptor = IO_Event_Selector_io_descriptor(io),
+		.events = poll_flags_from_events(NUM2INT(events)),
+	};
+	
+	if (DEBUG) fprintf(stderr, "IO_Event_Selector_Poll_io_wait(fiber=%p, descriptor=%d)\n", (void*)fiber, waiter.descriptor);
+	
+	poll_set_add(data, &waiter);
+	
+	struct io_wait_arguments io_wait_arguments = {
+		.data = data,
+		.waiter = &waiter,
+		.events = NUM2INT(events),
+	};
+	
+	return rb_ensure(io_wait_transfer, (VALUE)&io_wait_arguments, io_wait_ensure, (VALUE)&io_wait_arguments);
+}
+
+#pragma mark - Process.wait
+
+struct process_wait_arguments {
+	struct IO_Event_Selector_Poll *data;
+	struct IO_Event_Selector_Poll_Waiter *waiter;
+	pid_t pid;
+	int flags;
+	int descriptor;
+};
+
+static
+VALUE process_wait_transfer(VALUE _arguments) {
+	struct process_wait_arguments *arguments = (struct process_wait_arguments *)_arguments;
+	
+	IO_Event_Selector_fiber_transfer(arguments->data->backend.loop, 0, NULL);
+	
+	return IO_Event_Selector_process_status_wait(arguments->pid, arguments->flags);
+}
+
+static
+VALUE process_wait_ensure(VALUE _arguments) {
+	struct process_wait_arguments *arguments = (struct process_wait_arguments *)_arguments;
+	
+	poll_set_remove(arguments->data, arguments->waiter);
+	
+	close(arguments->descriptor);
+	
+	return Qnil;
+}
+
+VALUE IO_Event_Selector_Poll_process_wait(VALUE self, VALUE fiber, VALUE _pid, VALUE _flags) {
+	struct IO_Event_Selector_Poll *data = NULL;
+	TypedData_Get_Struct(self, struct IO_Event_Selector_Poll, &IO_Event_Selector_Poll_Type, data);
+	
+	pid_t pid = NUM2PIDT(_pid);
+	int flags = NUM2INT(_flags);
+	
+#ifdef __linux__
+	// If the process was spawned by `process_spawn`, we already have a pidfd for it:
+	int descriptor = IO_Event_Selector_process_pidfd(data->pidfds, pid);
+#endif
+	
+	// If the process has already exited, we can avoid allocating a pidfd:
+	VALUE status = IO_Event_Selector_process_status_wait(pid, flags);
+	if (!NIL_P(status)) {
+#ifdef __linux__
+		if (descriptor >= 0) close(descriptor);
+#endif
+		
+		return status;
+	}
+	
+#ifdef __linux__
+	if (descriptor == -1) {
+		descriptor = pidfd_open(pid, 0);
+		
+		if (descriptor >= 0) rb_update_max_fd(descriptor);
+	}
+	
+	if (descriptor >= 0) {
+		struct IO_Event_Selector_Poll_Waiter waiter = {
+			.fiber = fiber,
+			.descriptor = descriptor,
+			.events = POLLIN|POLLHUP|POLLERR,
+		};
+		
+		poll_set_add(data, &waiter);
+		
+		struct process_wait_arguments process_wait_arguments = {
+			.data = data,
+			.waiter = &waiter,
+			.pid = pid,
+			.flags = flags,
+			.descriptor = descriptor,
+		};
+		
+		return rb_ensure(process_wait_transfer, (VALUE)&process_wait_arguments, process_wait_ensure, (VALUE)&process_wait_arguments);
+	}
+#endif
+
+	// We can't wait on the process directly (e.g. `pidfd_open` is not available or is blocked by a sandbox), so we wait for `SIGCHLD` instead:
+	if (NIL_P(data->reaper)) {
+		VALUE Reaper = rb_const_get(rb_const_get(rb_cIO, id_Event), id_Reaper);
+		data->reaper = rb_funcall(Reaper, id_attach, 1, self);
+	}
+	
+	return rb_funcall(data->reaper, id_wait, 3, fiber, _pid, _flags);
+}
+
+#ifdef __linux__
+VALUE IO_Event_Selector_Poll_process_spawn(int argc, VALUE *argv, VALUE self) {
+	struct IO_Event_Selector_Poll *data = NULL;
+	TypedData_Get_Struct(self, struct IO_Event_Selector_Poll, &IO_Event_Selector_Poll_Type, data);
+	
+	rb_check_arity(argc, 2, UNLIMITED_ARGUMENTS);
+	
+	// The first argument is the fiber, which is not needed since spawning doesn't block:
+	return IO_Event_Selector_process_spawn(&data->pidfds, argc - 1, argv + 1);
+}
+#endif
+
+#ifdef HAVE_RUBY_IO_BUFFER_H
+
+#pragma mark - IO#read
+
+struct io_read_arguments {
+	VALUE self;
+	VALUE fiber;
+	VALUE io;
+	
+	struct IO_Event_Selector_Nonblock nonblock;
+	
+	int descriptor;
+	
+	VALUE buffer;
+	size_t length;
+	size_t offset;
+};
+
+static
+VALUE io_read_loop(VALUE _arguments) {
+	struct io_read_arguments *arguments = (struct io_read_arguments *)_arguments;
+	
+	void *base;
+	size_t size;
+	rb_io_buffer_get_bytes_for_writing(arguments->buffer, &base, &size);
+	
+	size_t length = arguments->length;
+	size_t offset = arguments->offset;
+	
+	while (true) {
+		size_t maximum_size = size - offset;
+		ssize_t result = IO_Event_Selector_Nonblock_read(&arguments->nonblock, (char*)base+offset, maximum_size);
+		
+		if (result > 0) {
+			offset += result;
+			if ((size_t)result >= length) break;
+			length -= result;
+		} else if (result == 0) {
+			break;
+		} else if (length > 0 && IO_Event_try_again(errno)) {
+			IO_Event_Selector_Poll_io_wait(arguments->self, arguments->fiber, arguments->io, RB_INT2NUM(IO_EVENT_READABLE));
+		} else {
+			return rb_fiber_scheduler_io_result(-1, errno);
+		}
+	}
+	
+	return rb_fiber_scheduler_io_result(offset, 0);
+}
+
+static
+VALUE io_read_ensure(VALUE _arguments) {
+	struct io_read_arguments *arguments = (struct io_read_arguments *)_arguments;
+	
+	IO_Event_Selector_Nonblock_restore(&arguments->nonblock);
+	
+	return Qnil;
+}
+
+VALUE IO_Event_Selector_Poll_io_read(VALUE self, VALUE fiber, VALUE io, VALUE buffer, VALUE _length, VALUE _offset) {
+	struct IO_Event_Selector_Poll *data = NULL;
+	TypedData_Get_Struct(self, struct IO_Event_Selector_Poll, &IO_Event_Selector_Poll_Type, data);
+	
+	int descriptor = IO_Event_Selector_io_descriptor(io);
+	
+	size_t offset = NUM2SIZET(_offset);
+	size_t length = NUM2SIZET(_length);
+	
+	struct io_read_arguments io_read_arguments = {
+		.self = self,
+		.fiber = fiber,
+		.io = io,
+		
+		.descriptor = descriptor,
+		.buffer = buffer,
+		.length = length,
+		.offset = offset,
+	};
+	
+	IO_Event_Selector_Nonblock_set(&io_read_arguments.nonblock, &data->descriptors, descriptor);
+	
+	return rb_ensure(io_read_loop, (VALUE)&io_read_arguments, io_read_ensure, (VALUE)&io_read_arguments);
+}
+
+VALUE IO_Event_Selector_Poll_io_read_compatible(int argc, VALUE *argv, VALUE self)
+{
+	rb_check_arity(argc, 4, 5);
+	
+	VALUE _offset = SIZET2NUM(0);
+	
+	if (argc == 5) {
+		_offset = argv[4];
+	}
+	
+	return IO_Event_Selector_Poll_io_read(self, argv[0], argv[1], argv[2], argv[3], _offset);
+}
+
+#pragma mark - IO#write
+
+struct io_write_arguments {
+	VALUE self;
+	VALUE fiber;
+	VALUE io;
+	
+	struct IO_Event_Selector_Nonblock nonblock;
+	
+	int descriptor;
+	
+	VALUE buffer;
+	size_t length;
+	size_t offset;
+};
+
+static
+VALUE io_write_loop(VALUE _arguments) {
+	struct io_write_arguments *arguments = (struct io_write_arguments *)_arguments;
+	
+	const void *base;
+	size_t size;
+	rb_io_buffer_get_bytes_for_reading(arguments->buffer, &base, &size);
+	
+	size_t length = arguments->length;
+	size_t offset = arguments->offset;
+	
+	if (length > size) {
+		rb_raise(rb_eRuntimeError, "Length exceeds size of buffer!");
+	}
+	
+	while (true) {
+		size_t maximum_size = size - offset;
+		ssize_t result = IO_Event_Selector_Nonblock_write(&arguments->nonblock, (char*)base+offset, maximum_size);
+		
+		if (result > 0) {
+			offset += result;
+			if ((size_t)result >= length) break;
+			length -= result;
+		} else if (result == 0) {
+			break;
+		} else if (length > 0 && IO_Event_try_again(errno)) {
+			IO_Event_Selector_Poll_io_wait(arguments->self, arguments->fiber, arguments->io, RB_INT2NUM(IO_EVENT_WRITABLE));
+		} else {
+			return rb_fiber_scheduler_io_result(-1, errno);
+		}
+	}
+	
+	return rb_fiber_scheduler_io_result(offset, 0);
+};
+
+static
+VALUE io_write_ensure(VALUE _arguments) {
+	struct io_write_arguments *arguments = (struct io_write_arguments *)_arguments;
+	
+	IO_Event_Selector_Nonblock_restore(&arguments->nonblock);
+	
+	return Qnil;
+};
+
+VALUE IO_Event_Selector_Poll_io_write(VALUE self, VALUE fiber, VALUE io, VALUE buffer, VALUE _length, VALUE _offset) {
+	struct IO_Event_Selector_Poll *data = NULL;
+	TypedData_Get_Struct(self, struct IO_Event_Selector_Poll, &IO_Event_Selector_Poll_Type, data);
+	
+	int descriptor = IO_Event_Selector_io_descriptor(io);
+	
+	size_t length = NUM2SIZET(_length);
+	size_t offset = NUM2SIZET(_offset);
+	
+	struct io_write_arguments io_write_arguments = {
+		.self = self,
+		.fiber = fiber,
+		.io = io,
+		
+		.descriptor = descriptor,
+		.buffer = buffer,
+		.length = length,
+		.offset = offset,
+	};
+	
+	IO_Event_Selector_Nonblock_set(&io_write_arguments.nonblock, &data->descriptors, descriptor);
+	
+	return rb_ensure(io_write_loop, (VALUE)&io_write_arguments, io_write_ensure, (VALUE)&io_write_arguments);
+}
+
+VALUE IO_Event_Selector_Poll_io_write_compatible(int argc, VALUE *argv, VALUE self)
+{
+	rb_check_arity(argc, 4, 5);
+	
+	VALUE _offset = SIZET2NUM(0);
+	
+	if (argc == 5) {
+		_offset = argv[4];
+	}
+	
+	return IO_Event_Selector_Poll_io_write(self, argv[0], argv[1], argv[2], argv[3], _offset);
+}
+
+#endif
+
+#pragma mark - Event Loop
+
+static
+struct timespec * make_timeout(VALUE duration, struct timespec * storage) {
+	if (duration == Qnil) {
+		return NULL;
+	}
+	
+	if (FIXNUM_P(duration)) {
+		storage->tv_sec = NUM2TIMET(duration);
+		storage->tv_nsec = 0;
+		
+		return storage;
+	}
+	
+	else if (RB_FLOAT_TYPE_P(duration)) {
+		double value = RFLOAT_VALUE(duration);
+		time_t seconds = value;
+		
+		storage->tv_sec = seconds;
+		storage->tv_nsec = (value - seconds) * 1000000000L;
+		
+		return storage;
+	}
+	
+	rb_raise(rb_eRuntimeError, "unable to convert timeout");
+}
+
+static
+int timeout_nonblocking(struct timespec * timespec) {
+	return timespec && timespec->tv_sec == 0 && timespec->tv_nsec == 0;
+}
+
+struct select_arguments {
+	struct IO_Event_Selector_Poll *data;
+	
+	int count;
+	
+	struct timespec * timeout;
+	struct timespec storage;
+};
+
+#ifndef HAVE_PPOLL
+static int make_timeout_ms(struct timespec * timeout) {
+	if (timeout == NULL) {
+		return -1;
+	}
+	
+	if (timeout_nonblocking(timeout)) {
+		return 0;
+	}
+	
+	return (timeout->tv_sec * 1000) + (timeout->tv_nsec / 1000000);
+}
+#endif
+
+static
+void * select_internal(void *_arguments) {
+	struct select_arguments * arguments = (struct select_arguments *)_arguments;
+	struct IO_Event_Selector_Poll *data = arguments->data;
+
+#ifdef HAVE_PPOLL
+	arguments->count = ppoll(data->pollfds, data->count, arguments->timeout, NULL);
+#else
+	arguments->count = poll(data->pollfds, data->count, make_timeout_ms(arguments->timeout));
+#endif
+
+	return NULL;
+}
+
+static
+void select_internal_without_gvl(struct select_arguments *arguments) {
+	arguments->data->blocked = 1;
+	rb_thread_call_without_gvl(select_internal, (void *)arguments, RUBY_UBF_IO, 0);
+	arguments->data->blocked = 0;
+	
+	if (arguments->count == -1) {
+		if (errno != EINTR) {
+			rb_sys_fail("select_internal_without_gvl:poll");
+		} else {
+			arguments->count = 0;
+		}
+	}
+}
+
+static
+void select_internal_with_gvl(struct select_arguments *arguments) {
+	select_internal((void *)arguments);
+	
+	if (arguments->count == -1) {
+		if (errno != EINTR) {
+			rb_sys_fail("select_internal_with_gvl:poll");
+		} else {
+			arguments->count = 0;
+		}
+	}
+}
+
+static
+void select_ready_push(struct IO_Event_Selector_Poll *data, VALUE fiber, short revents) {
+	if (data->ready_count == data->ready_capacity) {
+		size_t capacity = data->ready_capacity ? data->ready_capacity * 2 : POLL_INITIAL_CAPACITY;
+		
+		data->ready = xrealloc2(data->ready, capacity, sizeof(struct IO_Event_Selector_Poll_Ready));
+		data->ready_capacity = capacity;
+	}
+	
+	data->ready[data->ready_count].fiber = fiber;
+	data->ready[data->ready_count].revents = revents;
+	data->ready_count += 1;
+}
+
+// Remove all the waiters which are ready from the poll set. We do this before resuming any fibers, since they can modify the poll set.
+static
+void select_collect(struct IO_Event_Selector_Poll *data, int count) {
+	data->ready_count = 0;
+	
+	size_t index = 0;
+	while (count > 0 && index < data->count) {
+		struct pollfd *pollfd = &data->pollfds[index];
+		short revents = pollfd->revents;
+		
+		if (!revents) {
+			index += 1;
+			continue;
+		}
+		
+		count -= 1;
+		pollfd->revents = 0;
+		
+		if (index == 0) {
+			IO_Event_Interrupt_clear(&data->interrupt);
+			index += 1;
+			continue;
+		}
+		
+		struct IO_Event_Selector_Poll_Waiter *waiter = data->waiting[index];
+		while (waiter) {
+			struct IO_Event_Selector_Poll_Waiter *next = waiter->next;
+			
+			if (revents & (waiter->events | POLLNVAL)) {
+				if (DEBUG) fprintf(stderr, "select_collect(fiber=%p, descriptor=%d, revents=%d)\n", (void*)waiter->fiber, waiter->descriptor, revents);
+				
+				select_ready_push(data, waiter->fiber, revents);
+				poll_set_unlink(data, index, waiter);
+			}
+			
+			waiter = next;
+		}
+		
+		size_t before = data->count;
+		poll_set_update(data, index);
+		
+		// If the entry was removed, the last entry was moved into its place and still needs to be examined:
+		if (data->count == before) {
+			index += 1;
+		}
+	}
+}
+
+VALUE IO_Event_Selector_Poll_select(VALUE self, VALUE duration) {
+	struct IO_Event_Selector_Poll *data = NULL;
+	TypedData_Get_Struct(self, struct IO_Event_Selector_Poll, &IO_Event_Selector_Poll_Type, data);
+	
+	int ready = IO_Event_Selector_queue_flush(&data->backend);
+	
+	struct select_arguments arguments = {
+		.data = data,
+		.storage = {
+			.tv_sec = 0,
+			.tv_nsec = 0
+		},
+	};
+	
+	arguments.timeout = &arguments.storage;
+	
+	// Process any currently pending events:
+	select_internal_with_gvl(&arguments);
+	
+	// If we:
+	// 1. Didn't process any ready fibers, and
+	// 2. Didn't process any events from non-blocking select (above), and
+	// 3. There are no items in the ready list,
+	// then we can perform a blocking select.
+	if (!ready && !arguments.count && !data->backend.ready) {
+		arguments.timeout = make_timeout(duration, &arguments.storage);
+		
+		if (!timeout_nonblocking(arguments.timeout)) {
+			// Wait for events to occur
+			select_internal_without_gvl(&arguments);
+		}
+	}
+	
+	select_collect(data, arguments.count);
+	
+	// Resuming a fiber can't cause another select, so the ready list is stable while we iterate over it:
+	for (size_t i = 0; i < data->ready_count; i += 1) {
+		VALUE fiber = data->ready[i].fiber;
+		VALUE result = INT2NUM(data->ready[i].revents);
+		
+		IO_Event_Selector_fiber_transfer(fiber, 1, &result);
+	}
+	
+	data->ready_count = 0;
+	
+	return INT2NUM(arguments.count);
+}
+
+VALUE IO_Event_Selector_Poll_wakeup(VALUE self) {
+	struct IO_Event_Selector_Poll *data = NULL;
+	TypedData_Get_Struct(self, struct IO_Event_Selector_Poll, &IO_Event_Selector_Poll_Type, data);
+	
+	// If we are blocking, we can schedule a nop event to wake up the selector:
+	if (data->blocked) {
+		IO_Event_Interrupt_signal(&data->interrupt);
+		
+		return Qtrue;
+	}
+	
+	return Qfalse;
+}
+
+void Init_IO_Event_Selector_Poll(VALUE IO_Event_Selector) {
+	IO_Event_Selector_Poll = rb_define_class_under(IO_Event_Selector, "Poll", rb_cObject);
+	rb_gc_register_mark_object(IO_Event_Selector_Poll);
+	
+	id_Event = rb_intern("Event");
+	id_Reaper = rb_intern("Reaper");
+	id_attach = rb_intern("attach");
+	id_close = rb_intern("close");
+	id_wait = rb_intern("wait");
+	
+	rb_define_alloc_func(IO_Event_Selector_Poll, IO_Event_Selector_Poll_allocate);
+	rb_define_method(IO_Event_Selector_Poll, "initialize", IO_Event_Selector_Poll_initialize, 1);
+	
+	rb_define_method(IO_Event_Selector_Poll, "loop", IO_Event_Selector_Poll_loop, 0);
+	
+	rb_define_method(IO_Event_Selector_Poll, "transfer", IO_Event_Selector_Poll_transfer, 0);
+	rb_define_method(IO_Event_Selector_Poll, "resume", IO_Event_Selector_Poll_resume, -1);
+	rb_define_method(IO_Event_Selector_Poll, "yield", IO_Event_Selector_Poll_yield, 0);
+	rb_define_method(IO_Event_Selector_Poll, "push", IO_Event_Selector_Poll_push, 1);
+	rb_define_method(IO_Event_Selector_Poll, "raise", IO_Event_Selector_Poll_raise, -1);
+	
+	rb_define_method(IO_Event_Selector_Poll, "ready?", IO_Event_Selector_Poll_ready_p, 0);
+	
+	rb_define_method(IO_Event_Selector_Poll, "select", IO_Event_Selector_Poll_select, 1);
+	rb_define_method(IO_Event_Selector_Poll, "wakeup", IO_Event_Selector_Poll_wakeup, 0);
+	rb_define_method(IO_Event_Selector_Poll, "close", IO_Event_Selector_Poll_close, 0);
+	
+	rb_define_method(IO_Event_Selector_Poll, "io_wait", IO_Event_Selector_Poll_io_wait, 3);
+
+#ifdef HAVE_RUBY_IO_BUFFER_H
+	rb_define_method(IO_Event_Selector_Poll, "io_read", IO_Event_Selector_Poll_io_read_compatible, -1);
+	rb_define_method(IO_Event_Selector_Poll, "io_write", IO_Event_Selector_Poll_io_write_compatible, -1);
+#endif
+
+	rb_define_method(IO_Event_Selector_Poll, "process_wait", IO_Event_Selector_Poll_process_wait, 3);
+#ifdef __linux__
+	rb_define_method(IO_Event_Selector_Poll, "process_spawn", IO_Event_Selector_Poll_process_spawn, -1);
+#endif
+}
@@ -21,12 +21,25 @@
 #include "selector.h"
 #include <fcntl.h>
 
+#ifndef _WIN32
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/udp.h>
+#include <netinet/tcp.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifdef __linux__
+#include <sys/epoll.h>
+#endif
+
 static const int DEBUG = 0;
 
-static ID id_transfer, id_alive_p;
+static ID id_transfer, id_alive_p, id_for_fd, id_new, id_to_sockaddr;
 
 #ifndef HAVE_RB_PROCESS_STATUS_WAIT
-static VALUE process_wnohang;
+static int process_wnohang;
 #endif
 
 VALUE IO_Event_Selector_fiber_transfer(VALUE fiber, int argc, VALUE *argv) {
@@ -76,9 +89,9 @@ int IO_Event_Selector_io_descriptor(VALUE io) {
 static ID id_wait;
 static VALUE rb_Process_Status = Qnil;
 
-VALUE IO_Event_Selector_process_status_wait(rb_pid_t pid)
+VALUE IO_Event_Selector_process_status_wait(rb_pid_t pid, int flags)
 {
-	return rb_funcall(rb_Process_Status, id_wait, 2, PIDT2NUM(pid), process_wnohang);
+	return rb_funcall(rb_Process_Status, id_wait, 2, PIDT2NUM(pid), INT2NUM(flags | process_wnohang));
 }
 #endif
 
@@ -116,6 +129,357 @@ void IO_Event_Selector_nonblock_restore(int file_descriptor, int flags)
 #endif
 }
 
+void IO_Event_Selector_Descriptors_free(struct IO_Event_Selector_Descriptors *descriptors)
+{
+	if (descriptors->descriptors) {
+		xfree(descriptors->descriptors);
+		descriptors->descriptors = NULL;
+		descriptors->size = 0;
+	}
+}
+
+struct IO_Event_Selector_Descriptor * IO_Event_Selector_Descriptors_lookup(struct IO_Event_Selector_Descriptors *descriptors, int descriptor)
+{
+	size_t index = (size_t)descriptor;
+	
+	if (index >= descriptors->size) {
+		size_t size = descriptors->size ? descriptors->size : 64;
+		while (size <= index) size *= 2;
+		
+		descriptors->descriptors = xrealloc2(descriptors->descriptors, size, sizeof(struct IO_Event_Selector_Descriptor));
+		memset(descriptors->descriptors + descriptors->size, 0, (size - descriptors->size) * sizeof(struct IO_Event_Selector_Descriptor));
+		descriptors->size = size;
+	}
+	
+	return &descriptors->descriptors[index];
+}
+
+#ifndef _WIN32
+static
+void IO_Event_Selector_Descriptor_probe(struct IO_Event_Selector_Descriptor *state, int descriptor)
+{
+	struct stat status;
+	
+	state->flags = IO_EVENT_SELECTOR_DESCRIPTOR_KNOWN;
+	
+	if (fstat(descriptor, &status) == 0) {
+		if (S_ISSOCK(status.st_mode)) state->flags |= IO_EVENT_SELECTOR_DESCRIPTOR_SOCKET;
+		if (S_ISREG(status.st_mode)) state->flags |= IO_EVENT_SELECTOR_DESCRIPTOR_REGULAR;
+	}
+}
+
+int IO_Event_Selector_Descriptor_socket_p(struct IO_Event_Selector_Descriptor *state, int descriptor)
+{
+	if (!(state->flags & IO_EVENT_SELECTOR_DESCRIPTOR_KNOWN)) {
+		IO_Event_Selector_Descriptor_probe(state, descriptor);
+	}
+	
+	return state->flags & IO_EVENT_SELECTOR_DESCRIPTOR_SOCKET;
+}
+
+int IO_Event_Selector_Descriptors_regular_p(struct IO_Event_Selector_Descriptors *descriptors, int descriptor)
+{
+	struct IO_Event_Selector_Descriptor *state = IO_Event_Selector_Descriptors_lookup(descriptors, descriptor);
+	
+	// Regular files are executed on the worker pool, where a blocking socket or pipe could stall a thread indefinitely, so we check again in case the descriptor was closed and reused:
+	if (!(state->flags & IO_EVENT_SELECTOR_DESCRIPTOR_KNOWN) || (state->flags & IO_EVENT_SELECTOR_DESCRIPTOR_REGULAR)) {
+		IO_Event_Selector_Descriptor_probe(state, descriptor);
+	}
+	
+	return state->flags & IO_EVENT_SELECTOR_DESCRIPTOR_REGULAR;
+}
+
+void IO_Event_Selector_Descriptors_forget(struct IO_Event_Selector_Descriptors *descriptors, int descriptor)
+{
+	if (descriptor >= 0 && (size_t)descriptor < descriptors->size) {
+		memset(&descriptors->descriptors[descriptor], 0, sizeof(struct IO_Event_Selector_Descriptor));
+	}
+}
+
+void IO_Event_Selector_Nonblock_set(struct IO_Event_Selector_Nonblock *nonblock, struct IO_Event_Selector_Descriptors *descriptors, int descriptor)
+{
+	nonblock->descriptors = descriptors;
+	nonblock->descriptor = descriptor;
+	
+	// Sockets support per-call non-blocking operations, so we don't need to modify (and later restore) the file status flags:
+	if (IO_Event_Selector_Descriptor_socket_p(IO_Event_Selector_Descriptors_lookup(descriptors, descriptor), descriptor)) {
+		nonblock->flags = -1;
+	} else {
+		nonblock->flags = IO_Event_Selector_nonblock_set(descriptor);
+	}
+}
+
+void IO_Event_Selector_Nonblock_restore(struct IO_Event_Selector_Nonblock *nonblock)
+{
+	if (nonblock->flags != -1) {
+		IO_Event_Selector_nonblock_restore(nonblock->descriptor, nonblock->flags);
+	}
+}
+
+// The cached state was stale, e.g. the descriptor was closed and reused for something other than a socket, so we fall back to toggling `O_NONBLOCK`.
+static
+void IO_Event_Selector_Nonblock_fallback(struct IO_Event_Selector_Nonblock *nonblock)
+{
+	// The descriptor may now be a regular file, so inspect it again next time:
+	IO_Event_Selector_Descriptors_forget(nonblock->descriptors, nonblock->descriptor);
+	
+	nonblock->flags = IO_Event_Selector_nonblock_set(nonblock->descriptor);
+}
+
+ssize_t IO_Event_Selector_Nonblock_read(struct IO_Event_Selector_Nonblock *nonblock, void *base, size_t size)
+{
+	if (nonblock->flags == -1) {
+		ssize_t result = recv(nonblock->descriptor, base, size, MSG_DONTWAIT);
+		
+		if (result != -1 || errno != ENOTSOCK) return result;
+		
+		IO_Event_Selector_Nonblock_fallback(nonblock);
+	}
+	
+	return read(nonblock->descriptor, base, size);
+}
+
+ssize_t IO_Event_Selector_Nonblock_write(struct IO_Event_Selector_Nonblock *nonblock, const void *base, size_t size)
+{
+	if (nonblock->flags == -1) {
+		ssize_t result = send(nonblock->descriptor, base, size, MSG_DONTWAIT);
+		
+		if (result != -1 || errno != ENOTSOCK) return result;
+		
+		IO_Event_Selector_Nonblock_fallback(nonblock);
+	}
+	
+	return write(nonblock->descriptor, base, size);
+}
+
+ssize_t IO_Event_Selector_Nonblock_readv(struct IO_Event_Selector_Nonblock *nonblock, const struct iovec *iovecs, int count)
+{
+	if (nonblock->flags == -1) {
+		struct msghdr message = {
+			.msg_iov = (struct iovec *)iovecs,
+			.msg_iovlen = count,
+		};
+		
+		ssize_t result = recvmsg(nonblock->descriptor, &message, MSG_DONTWAIT);
+		
+		if (result != -1 || errno != ENOTSOCK) return result;
+		
+		IO_Event_Selector_Nonblock_fallback(nonblock);
+	}
+	
+	return readv(nonblock->descriptor, iovecs, count);
+}
+
+ssize_t IO_Event_Selector_Nonblock_writev(struct IO_Event_Selector_Nonblock *nonblock, const struct iovec *iovecs, int count)
+{
+	if (nonblock->flags == -1) {
+		struct msghdr message = {
+			.msg_iov = (struct iovec *)iovecs,
+			.msg_iovlen = count,
+		};
+		
+		ssize_t result = sendmsg(nonblock->descriptor, &message, MSG_DONTWAIT);
+		
+		if (result != -1 || errno != ENOTSOCK) return result;
+		
+		IO_Event_Selector_Nonblock_fallback(nonblock);
+	}
+	
+	return writev(nonblock->descriptor, iovecs, count);
+}
+
+#ifdef HAVE_RUBY_IO_BUFFER_H
+size_t IO_Event_Selector_iovecs_for_writing(VALUE buffers, struct iovec *iovecs, int count)
+{
+	size_t total = 0;
+	
+	for (int i = 0; i < count; i += 1) {
+		void *base;
+		size_t size;
+		rb_io_buffer_get_bytes_for_writing(RARRAY_AREF(buffers, i), &base, &size);
+		
+		iovecs[i].iov_base = base;
+		iovecs[i].iov_len = size;
+		
+		total += size;
+	}
+	
+	return total;
+}
+
+size_t IO_Event_Selector_iovecs_for_reading(VALUE buffers, struct iovec *iovecs, int count)
+{
+	size_t total = 0;
+	
+	for (int i = 0; i < count; i += 1) {
+		const void *base;
+		size_t size;
+		rb_io_buffer_get_bytes_for_reading(RARRAY_AREF(buffers, i), &base, &size);
+		
+		iovecs[i].iov_base = (void *)base;
+		iovecs[i].iov_len = size;
+		
+		total += size;
+	}
+	
+	return total;
+}
+
+void IO_Event_Selector_message_for_writing(VALUE buffer, struct msghdr *header, struct IO_Event_Selector_Message *message)
+{
+	void *base;
+	size_t size;
+	rb_io_buffer_get_bytes_for_writing(buffer, &base, &size);
+	
+	message->iovec.iov_base = base;
+	message->iovec.iov_len = size;
+	
+	*header = (struct msghdr){
+		.msg_name = &message->address,
+		.msg_namelen = sizeof(message->address),
+		.msg_iov = &message->iovec,
+		.msg_iovlen = 1,
+		.msg_control = message->control.buffer,
+		.msg_controllen = sizeof(message->control.buffer),
+	};
+}
+
+void IO_Event_Selector_message_for_reading(VALUE message, struct msghdr *header, struct IO_Event_Selector_Message *storage)
+{
+	Check_Type(message, T_ARRAY);
+	
+	const void *base;
+	size_t size;
+	rb_io_buffer_get_bytes_for_reading(RARRAY_AREF(message, 0), &base, &size);
+	
+	size_t length = NUM2SIZET(RARRAY_AREF(message, 1));
+	
+	if (length > size) {
+		rb_raise(rb_eRuntimeError, "Length exceeds size of buffer!");
+	}
+	
+	storage->iovec.iov_base = (void *)base;
+	storage->iovec.iov_len = length;
+	
+	*header = (struct msghdr){
+		.msg_iov = &storage->iovec,
+		.msg_iovlen = 1,
+	};
+	
+	VALUE name = RARRAY_LEN(message) > 2 ? RARRAY_AREF(message, 2) : Qnil;
+	
+	// Connected sockets don't need an address:
+	if (!NIL_P(name)) {
+		if (!RB_TYPE_P(name, T_STRING)) {
+			name = rb_funcall(name, id_to_sockaddr, 0);
+		}
+		
+		StringValue(name);
+		
+		if ((size_t)RSTRING_LEN(name) > sizeof(storage->address)) {
+			rb_raise(rb_eArgError, "Address is too long!");
+		}
+		
+		// The string may not outlive the system call, so we copy it:
+		memcpy(&storage->address, RSTRING_PTR(name), RSTRING_LEN(name));
+		
+		header->msg_name = &storage->address;
+		header->msg_namelen = (socklen_t)RSTRING_LEN(name);
+	}
+	
+	VALUE segment_size = RARRAY_LEN(message) > 3 ? RARRAY_AREF(message, 3) : Qnil;
+	
+	if (!NIL_P(segment_size)) {
+#ifdef UDP_SEGMENT
+		header->msg_control = storage->control.buffer;
+		header->msg_controllen = CMSG_SPACE(sizeof(uint16_t));
+		
+		struct cmsghdr *control = CMSG_FIRSTHDR(header);
+		control->cmsg_level = IPPROTO_UDP;
+		control->cmsg_type = UDP_SEGMENT;
+		control->cmsg_len = CMSG_LEN(sizeof(uint16_t));
+		
+		uint16_t value = NUM2USHORT(segment_size);
+		memcpy(CMSG_DATA(control), &value, sizeof(value));
+#else
+		rb_raise(rb_eNotImpError, "UDP segmentation offload is not supported!");
+#endif
+	}
+}
+
+VALUE IO_Event_Selector_message_received(struct msghdr *header, size_t length)
+{
+	VALUE address = Qnil;
+	
+	if (header->msg_namelen > 0) {
+		// The `socket` extension must already be loaded if we received a datagram from a socket:
+		VALUE sockaddr = rb_str_new(header->msg_name, header->msg_namelen);
+		address = rb_funcall(rb_path2class("Addrinfo"), id_new, 1, sockaddr);
+	}
+	
+	VALUE segment_size = Qnil;
+
+#ifdef UDP_GRO
+	for (struct cmsghdr *control = CMSG_FIRSTHDR(header); control; control = CMSG_NXTHDR(header, control)) {
+		if (control->cmsg_level == IPPROTO_UDP && control->cmsg_type == UDP_GRO) {
+			int value;
+			memcpy(&value, CMSG_DATA(control), sizeof(value));
+			segment_size = INT2NUM(value);
+		}
+	}
+#endif
+
+	return rb_ary_new_from_args(3, SIZET2NUM(length), address, segment_size);
+}
+#endif
+
+struct iovec * IO_Event_Selector_iovecs_advance(struct iovec *iovecs, int *count, size_t size)
+{
+	while (*count > 0 && size >= iovecs->iov_len) {
+		size -= iovecs->iov_len;
+		iovecs += 1;
+		*count -= 1;
+	}
+	
+	if (*count > 0) {
+		iovecs->iov_base = (char *)iovecs->iov_base + size;
+		iovecs->iov_len -= size;
+	}
+	
+	return iovecs;
+}
+#endif
+
+ssize_t IO_Event_Selector_search(const char *base, size_t size, size_t *from, const char *delimiter, size_t length)
+{
+	const char *start = base + *from;
+	const char *end = base + size;
+	const char *match = NULL;
+	
+	if (length == 1) {
+		match = memchr(start, delimiter[0], end - start);
+	} else if ((size_t)(end - start) >= length) {
+#ifdef HAVE_MEMMEM
+		match = memmem(start, end - start, delimiter, length);
+#else
+		const char *last = end - length;
+		
+		while (start <= last && (match = memchr(start, delimiter[0], last - start + 1))) {
+			if (memcmp(match, delimiter, length) == 0) break;
+			start = match + 1;
+			match = NULL;
+		}
+#endif
+	}
+	
+	if (match) return match - base;
+	
+	// The last few bytes may be the start of a delimiter which is completed by the next read:
+	if (size >= length) *from = size - length + 1;
+	
+	return -1;
+}
+
 struct IO_Event_Selector_nonblock_arguments {
 	int file_descriptor;
 	int flags;
@@ -139,9 +503,195 @@ static VALUE IO_Event_Selector_nonblock(VALUE class, VALUE io)
 	return rb_ensure(rb_yield, io, IO_Event_Selector_nonblock_ensure, (VALUE)&arguments);
 }
 
+// Limit the data which a TCP socket queues but has not yet sent to the given number of bytes. Beyond that, writes fail with `EAGAIN`, and the socket is not reported as writable until the unsent data drains below the limit. A fiber writing to a slow client then waits in `io_write`, rather than filling a large send buffer. Returns false if the IO is not a TCP socket, or the option is not supported.
+static VALUE IO_Event_Selector_notsent_lowat(VALUE class, VALUE io, VALUE size)
+{
+#ifdef TCP_NOTSENT_LOWAT
+	int descriptor = IO_Event_Selector_io_descriptor(io);
+	int value = NUM2INT(size);
+	
+	if (setsockopt(descriptor, IPPROTO_TCP, TCP_NOTSENT_LOWAT, &value, sizeof(value)) == 0) {
+		return Qtrue;
+	}
+	
+	if (errno != ENOTSOCK && errno != EOPNOTSUPP && errno != ENOPROTOOPT) {
+		rb_sys_fail("IO_Event_Selector_notsent_lowat:setsockopt");
+	}
+#endif
+
+	return Qfalse;
+}
+
+static VALUE IO_Event_Selector_socket_for_fd_protected(VALUE descriptor)
+{
+	// The `socket` extension must already be loaded if we accepted a connection from a server socket:
+	return rb_funcall(rb_path2class("Socket"), id_for_fd, 1, descriptor);
+}
+
+VALUE IO_Event_Selector_socket_for_fd(int descriptor)
+{
+	int state = 0;
+	VALUE socket = rb_protect(IO_Event_Selector_socket_for_fd_protected, INT2NUM(descriptor), &state);
+	
+	if (state) {
+		close(descriptor);
+		rb_jump_tag(state);
+	}
+	
+	return socket;
+}
+
+VALUE IO_Event_Selector_fiber_current(void)
+{
+	return rb_fiber_current();
+}
+
+static
+size_t IO_Event_Selector_IO_Select_add(struct IO_Event_Selector_IO_Select *select, size_t index, VALUE ios, short events)
+{
+	if (NIL_P(ios)) return index;
+	
+	for (long i = 0; i < RARRAY_LEN(ios); i += 1) {
+		VALUE io = rb_io_get_io(RARRAY_AREF(ios, i));
+		
+		select->pollfds[index].fd = IO_Event_Selector_io_descriptor(io);
+		select->pollfds[index].events = events;
+		select->pollfds[index].revents = 0;
+		
+		index += 1;
+	}
+	
+	return index;
+}
+
+void IO_Event_Selector_IO_Select_initialize(struct IO_Event_Selector_IO_Select *select, VALUE readable, VALUE writable, VALUE priority)
+{
+	if (!NIL_P(readable)) Check_Type(readable, T_ARRAY);
+	if (!NIL_P(writable)) Check_Type(writable, T_ARRAY);
+	if (!NIL_P(priority)) Check_Type(priority, T_ARRAY);
+	
+	select->readable = readable;
+	select->writable = writable;
+	select->priority = priority;
+	
+	select->count = 0;
+	if (!NIL_P(readable)) select->count += RARRAY_LEN(readable);
+	if (!NIL_P(writable)) select->count += RARRAY_LEN(writable);
+	if (!NIL_P(priority)) select->count += RARRAY_LEN(priority);
+	
+	// The temporary buffer is released by the garbage collector if the conversion fails:
+	select->storage = 0;
+	select->pollfds = rb_alloc_tmp_buffer(&select->storage, select->count * sizeof(struct pollfd));
+	
+	size_t index = 0;
+	index = IO_Event_Selector_IO_Select_add(select, index, readable, POLLIN);
+	index = IO_Event_Selector_IO_Select_add(select, index, writable, POLLOUT);
+	index = IO_Event_Selector_IO_Select_add(select, index, priority, POLLPRI);
+}
+
+void IO_Event_Selector_IO_Select_free(struct IO_Event_Selector_IO_Select *select)
+{
+	if (select->storage) {
+		rb_free_tmp_buffer(&select->storage);
+		select->pollfds = NULL;
+	}
+}
+
+static
+VALUE IO_Event_Selector_IO_Select_filter(struct IO_Event_Selector_IO_Select *select, size_t *index, VALUE ios, short events, int readable, size_t *count)
+{
+	VALUE ready = rb_ary_new();
+	
+	if (NIL_P(ios)) return ready;
+	
+	for (long i = 0; i < RARRAY_LEN(ios); i += 1) {
+		VALUE io = RARRAY_AREF(ios, i);
+		struct pollfd *pollfd = &select->pollfds[*index];
+		*index += 1;
+		
+		int pending = 0;
+		
+		// Data which is already buffered can be read without waiting, even if the descriptor is not ready:
+		if (readable) {
+			rb_io_t *fptr = RFILE(rb_io_get_io(io))->fptr;
+			pending = fptr && rb_io_read_pending(fptr);
+		}
+		
+		if (pending || (pollfd->revents & events)) {
+			rb_ary_push(ready, io);
+			*count += 1;
+		}
+	}
+	
+	return ready;
+}
+
+VALUE IO_Event_Selector_IO_Select_ready(struct IO_Event_Selector_IO_Select *select)
+{
+	int result;
+	
+	do {
+		result = poll(select->pollfds, select->count, 0);
+	} while (result == -1 && errno == EINTR);
+	
+	if (result == -1) {
+		rb_sys_fail("IO_Event_Selector_IO_Select_ready:poll");
+	}
+	
+	size_t index = 0, count = 0;
+	
+	// Errors and hangups are reported as readable and writable, as `IO.select` does:
+	VALUE readable = IO_Event_Selector_IO_Select_filter(select, &index, select->readable, POLLIN|POLLHUP|POLLERR|POLLNVAL, 1, &count);
+	VALUE writable = IO_Event_Selector_IO_Select_filter(select, &index, select->writable, POLLOUT|POLLHUP|POLLERR|POLLNVAL, 0, &count);
+	VALUE priority = IO_Event_Selector_IO_Select_filter(select, &index, select->priority, POLLPRI, 0, &count);
+	
+	if (count == 0) return Qnil;
+	
+	return rb_ary_new_from_args(3, readable, writable, priority);
+}
+
+#ifdef __linux__
+int IO_Event_Selector_IO_Select_epoll(struct IO_Event_Selector_IO_Select *select)
+{
+	int descriptor = epoll_create1(EPOLL_CLOEXEC);
+	
+	if (descriptor == -1) {
+		rb_sys_fail("IO_Event_Selector_IO_Select_epoll:epoll_create1");
+	}
+	
+	rb_update_max_fd(descriptor);
+	
+	for (size_t i = 0; i < select->count; i += 1) {
+		struct epoll_event event = {.events = select->pollfds[i].events, .data.fd = select->pollfds[i].fd};
+		
+		int result = epoll_ctl(descriptor, EPOLL_CTL_ADD, event.data.fd, &event);
+		
+		// The same descriptor can be given in several sets, in which case we wait for all of the events:
+		if (result == -1 && errno == EEXIST) {
+			for (size_t j = 0; j < i; j += 1) {
+				if (select->pollfds[j].fd == event.data.fd) event.events |= select->pollfds[j].events;
+			}
+			
+			result = epoll_ctl(descriptor, EPOLL_CTL_MOD, event.data.fd, &event);
+		}
+		
+		if (result == -1) {
+			int error = errno;
+			close(descriptor);
+			rb_syserr_fail(error, "IO_Event_Selector_IO_Select_epoll:epoll_ctl");
+		}
+	}
+	
+	return descriptor;
+}
+#endif
+
 void Init_IO_Event_Selector(VALUE IO_Event_Selector) {
 	id_transfer = rb_intern("transfer");
 	id_alive_p = rb_intern("alive?");
+	id_for_fd = rb_intern("for_fd");
+	id_new = rb_intern("new");
+	id_to_sockaddr = rb_intern("to_sockaddr");
 	
 #ifndef HAVE__RB_FIBER_RAISE
 	id_raise = rb_intern("raise");
@@ -157,12 +707,13 @@ void Init_IO_Event_Selector(VALUE IO_Event_Selector) {
 	
 #ifndef HAVE_RB_PROCESS_STATUS_WAIT
 	id_wait = rb_intern("wait");
-	process_wnohang = rb_const_get(rb_mProcess, rb_intern("WNOHANG"));
+	process_wnohang = NUM2INT(rb_const_get(rb_mProcess, rb_intern("WNOHANG")));
 	rb_Process_Status = rb_const_get_at(rb_mProcess, rb_intern("Status"));
 	rb_gc_register_mark_object(rb_Process_Status);
 #endif
 
 	rb_define_singleton_method(IO_Event_Selector, "nonblock", IO_Event_Selector_nonblock, 1);
+	rb_define_singleton_method(IO_Event_Selector, "notsent_lowat", IO_Event_Selector_notsent_lowat, 2);
 }
 
 struct wait_and_transfer_arguments {
@@ -324,6 +875,337 @@ int IO_Event_Selector_queue_flush(struct IO_Event_Selector *backend)
 	return count;
 }
 
+void IO_Event_Selector_Waiter_add(st_table **waiters, struct IO_Event_Selector_Waiter *waiter, VALUE fiber, int descriptor)
+{
+	if (*waiters == NULL) {
+		*waiters = st_init_numtable();
+	}
+	
+	waiter->descriptor = descriptor;
+	waiter->previous = NULL;
+	waiter->next = NULL;
+	waiter->queue.fiber = fiber;
+	
+	// Insert at the head of the list for this descriptor:
+	struct IO_Event_Selector_Waiter *head = NULL;
+	if (st_lookup(*waiters, (st_data_t)descriptor, (st_data_t*)&head)) {
+		waiter->next = head;
+		head->previous = waiter;
+	}
+	
+	st_insert(*waiters, (st_data_t)descriptor, (st_data_t)waiter);
+	waiter->linked = 1;
+}
+
+void IO_Event_Selector_Waiter_remove(struct IO_Event_Selector *backend, st_table **waiters, struct IO_Event_Selector_Waiter *waiter)
+{
+	if (waiter->linked) {
+		if (waiter->next) {
+			waiter->next->previous = waiter->previous;
+		}
+		
+		if (waiter->previous) {
+			waiter->previous->next = waiter->next;
+		} else if (waiter->next) {
+			st_insert(*waiters, (st_data_t)waiter->descriptor, (st_data_t)waiter->next);
+		} else {
+			st_data_t key = (st_data_t)waiter->descriptor;
+			st_delete(*waiters, &key, NULL);
+		}
+		
+		waiter->linked = 0;
+	}
+	
+	// The fiber may have been resumed by the operation completing, before the ready queue was flushed:
+	if (waiter->queued) {
+		queue_pop(backend, &waiter->queue);
+		waiter->queued = 0;
+	}
+}
+
+struct IO_Event_Selector_Waiter * IO_Event_Selector_Waiters_detach(st_table **waiters, int descriptor)
+{
+	struct IO_Event_Selector_Waiter *head = NULL;
+	
+	if (*waiters == NULL) return NULL;
+	
+	st_data_t key = (st_data_t)descriptor;
+	if (!st_delete(*waiters, &key, (st_data_t*)&head)) return NULL;
+	
+	for (struct IO_Event_Selector_Waiter *waiter = head; waiter; waiter = waiter->next) {
+		waiter->linked = 0;
+		waiter->cancelled = 1;
+	}
+	
+	return head;
+}
+
+struct IO_Event_Selector_Waiter * IO_Event_Selector_Waiters_cancel(struct IO_Event_Selector *backend, st_table **waiters, int descriptor)
+{
+	struct IO_Event_Selector_Waiter *head = IO_Event_Selector_Waiters_detach(waiters, descriptor);
+	
+	for (struct IO_Event_Selector_Waiter *waiter = head; waiter; waiter = waiter->next) {
+		// Queue entries embedded in the waiter are removed by the waiter itself, in `IO_Event_Selector_Waiter_remove`:
+		waiter->queue.behind = NULL;
+		waiter->queue.infront = NULL;
+		waiter->queue.flags = IO_EVENT_SELECTOR_QUEUE_FIBER;
+		queue_push(backend, &waiter->queue);
+		waiter->queued = 1;
+	}
+	
+	return head;
+}
+
+void IO_Event_Selector_Waiters_free(st_table **waiters)
+{
+	// The waiters themselves are owned by the fibers which are waiting:
+	if (*waiters) {
+		st_free_table(*waiters);
+		*waiters = NULL;
+	}
+}
+
+enum IO_Event_Selector_Sync_State {
+	IO_EVENT_SELECTOR_SYNC_WAITING = 0,
+	// The flush covering this request has finished:
+	IO_EVENT_SELECTOR_SYNC_COMPLETED = 1,
+	// This request must perform the next flush on behalf of the group:
+	IO_EVENT_SELECTOR_SYNC_LEADING = 2,
+};
+
+struct IO_Event_Selector_Sync_Waiter {
+	struct IO_Event_Selector_Sync_Waiter *next;
+	
+	VALUE fiber;
+	int datasync;
+	
+	enum IO_Event_Selector_Sync_State state;
+	int result;
+};
+
+struct IO_Event_Selector_Sync {
+	// Whether a fiber is currently leading (performing a flush for) this descriptor:
+	int active;
+	
+	// Requests which arrived after the current flush started, and must wait for the next one:
+	struct IO_Event_Selector_Sync_Waiter *waiting;
+	
+	// Requests covered by the current flush:
+	struct IO_Event_Selector_Sync_Waiter *flushing;
+};
+
+struct IO_Event_Selector_sync_arguments {
+	struct IO_Event_Selector *backend;
+	st_table **syncs;
+	struct IO_Event_Selector_Sync *sync;
+	
+	VALUE self;
+	int descriptor;
+	IO_Event_Selector_Sync_Function function;
+	
+	struct IO_Event_Selector_Sync_Waiter *waiter;
+	int finished;
+};
+
+static
+void IO_Event_Selector_sync_append(struct IO_Event_Selector_Sync_Waiter **list, struct IO_Event_Selector_Sync_Waiter *waiter)
+{
+	while (*list) list = &(*list)->next;
+	
+	*list = waiter;
+}
+
+static
+void IO_Event_Selector_sync_remove(struct IO_Event_Selector_Sync_Waiter **list, struct IO_Event_Selector_Sync_Waiter *waiter)
+{
+	while (*list) {
+		if (*list == waiter) {
+			*list = waiter->next;
+			return;
+		}
+		
+		list = &(*list)->next;
+	}
+}
+
+// Pass leadership to the next waiting request, or release the descriptor if there are none.
+static
+void IO_Event_Selector_sync_handoff(struct IO_Event_Selector_sync_arguments *arguments)
+{
+	struct IO_Event_Selector_Sync *sync = arguments->sync;
+	struct IO_Event_Selector_Sync_Waiter *next = sync->waiting;
+	
+	if (next) {
+		sync->waiting = next->next;
+		next->next = NULL;
+		next->state = IO_EVENT_SELECTOR_SYNC_LEADING;
+		
+		IO_Event_Selector_queue_push(arguments->backend, next->fiber);
+	} else {
+		st_data_t key = (st_data_t)arguments->descriptor;
+		st_delete(*arguments->syncs, &key, NULL);
+		
+		free(sync);
+	}
+}
+
+static
+VALUE IO_Event_Selector_sync_wait(VALUE _arguments)
+{
+	struct IO_Event_Selector_sync_arguments *arguments = (struct IO_Event_Selector_sync_arguments *)_arguments;
+	
+	while (arguments->waiter->state == IO_EVENT_SELECTOR_SYNC_WAITING) {
+		IO_Event_Selector_fiber_transfer(arguments->backend->loop, 0, NULL);
+	}
+	
+	arguments->finished = 1;
+	
+	return Qnil;
+}
+
+static
+VALUE IO_Event_Selector_sync_wait_ensure(VALUE _arguments)
+{
+	struct IO_Event_Selector_sync_arguments *arguments = (struct IO_Event_Selector_sync_arguments *)_arguments;
+	struct IO_Event_Selector_Sync_Waiter *waiter = arguments->waiter;
+	
+	if (!arguments->finished) {
+		if (waiter->state == IO_EVENT_SELECTOR_SYNC_WAITING) {
+			IO_Event_Selector_sync_remove(&arguments->sync->waiting, waiter);
+			IO_Event_Selector_sync_remove(&arguments->sync->flushing, waiter);
+		} else if (waiter->state == IO_EVENT_SELECTOR_SYNC_LEADING) {
+			// We were chosen to lead the next flush, but won't be able to:
+			IO_Event_Selector_sync_handoff(arguments);
+		}
+	}
+	
+	return Qnil;
+}
+
+static
+VALUE IO_Event_Selector_sync_lead(VALUE _arguments)
+{
+	struct IO_Event_Selector_sync_arguments *arguments = (struct IO_Event_Selector_sync_arguments *)_arguments;
+	struct IO_Event_Selector_Sync *sync = arguments->sync;
+	struct IO_Event_Selector_Sync_Waiter *waiter = arguments->waiter;
+	
+	// Give other fibers which are ready to run in this iteration of the event loop a chance to join the group:
+	IO_Event_Selector_yield(arguments->backend);
+	
+	sync->flushing = sync->waiting;
+	sync->waiting = NULL;
+	
+	int datasync = waiter->datasync;
+	for (struct IO_Event_Selector_Sync_Waiter *member = sync->flushing; member; member = member->next) {
+		datasync = datasync && member->datasync;
+	}
+	
+	waiter->result = arguments->function(arguments->self, waiter->fiber, arguments->descriptor, datasync);
+	
+	arguments->finished = 1;
+	
+	return Qnil;
+}
+
+static
+VALUE IO_Event_Selector_sync_lead_ensure(VALUE _arguments)
+{
+	struct IO_Event_Selector_sync_arguments *arguments = (struct IO_Event_Selector_sync_arguments *)_arguments;
+	struct IO_Event_Selector_Sync *sync = arguments->sync;
+	
+	struct IO_Event_Selector_Sync_Waiter *member = sync->flushing;
+	sync->flushing = NULL;
+	
+	if (arguments->finished) {
+		while (member) {
+			struct IO_Event_Selector_Sync_Waiter *next = member->next;
+			
+			member->next = NULL;
+			member->state = IO_EVENT_SELECTOR_SYNC_COMPLETED;
+			member->result = arguments->waiter->result;
+			
+			IO_Event_Selector_queue_push(arguments->backend, member->fiber);
+			
+			member = next;
+		}
+	} else if (member) {
+		// The flush did not complete, so the requests it was covering must wait for the next one:
+		struct IO_Event_Selector_Sync_Waiter **tail = &member;
+		while (*tail) tail = &(*tail)->next;
+		
+		*tail = sync->waiting;
+		sync->waiting = member;
+	}
+	
+	IO_Event_Selector_sync_handoff(arguments);
+	
+	return Qnil;
+}
+
+int IO_Event_Selector_sync(struct IO_Event_Selector *backend, st_table **syncs, VALUE self, VALUE fiber, int descriptor, int datasync, IO_Event_Selector_Sync_Function function)
+{
+	if (*syncs == NULL) {
+		*syncs = st_init_numtable();
+	}
+	
+	struct IO_Event_Selector_Sync *sync = NULL;
+	
+	if (!st_lookup(*syncs, (st_data_t)descriptor, (st_data_t*)&sync)) {
+		sync = calloc(1, sizeof(struct IO_Event_Selector_Sync));
+		if (sync == NULL) rb_sys_fail("IO_Event_Selector_sync:calloc");
+		
+		st_insert(*syncs, (st_data_t)descriptor, (st_data_t)sync);
+	}
+	
+	struct IO_Event_Selector_Sync_Waiter waiter = {
+		.fiber = fiber,
+		.datasync = datasync,
+	};
+	
+	struct IO_Event_Selector_sync_arguments arguments = {
+		.backend = backend,
+		.syncs = syncs,
+		.sync = sync,
+		.self = self,
+		.descriptor = descriptor,
+		.function = function,
+		.waiter = &waiter,
+	};
+	
+	if (sync->active) {
+		IO_Event_Selector_sync_append(&sync->waiting, &waiter);
+		rb_ensure(IO_Event_Selector_sync_wait, (VALUE)&arguments, IO_Event_Selector_sync_wait_ensure, (VALUE)&arguments);
+		
+		if (waiter.state == IO_EVENT_SELECTOR_SYNC_COMPLETED) {
+			return waiter.result;
+		}
+		
+		arguments.finished = 0;
+	}
+	
+	sync->active = 1;
+	rb_ensure(IO_Event_Selector_sync_lead, (VALUE)&arguments, IO_Event_Selector_sync_lead_ensure, (VALUE)&arguments);
+	
+	return waiter.result;
+}
+
+static
+int IO_Event_Selector_syncs_free_entry(st_data_t key, st_data_t value, st_data_t argument)
+{
+	free((struct IO_Event_Selector_Sync *)value);
+	
+	return ST_DELETE;
+}
+
+void IO_Event_Selector_syncs_free(st_table **syncs)
+{
+	if (*syncs) {
+		st_foreach(*syncs, IO_Event_Selector_syncs_free_entry, 0);
+		st_free_table(*syncs);
+		*syncs = NULL;
+	}
+}
+
 void IO_Event_Selector_elapsed_time(struct timespec* start, struct timespec* stop, struct timespec *duration)
 {
 	if ((stop->tv_nsec - start->tv_nsec) < 0) {
@@ -338,3 +1220,157 @@ void IO_Event_Selector_elapsed_time(struct timespec* start, struct timespec* sto
 void IO_Event_Selector_current_time(struct timespec *time) {
 	clock_gettime(CLOCK_MONOTONIC, time);
 }
+
+struct timespec * IO_Event_Selector_deadline(VALUE timeout, struct timespec *storage)
+{
+	if (NIL_P(timeout)) {
+		return NULL;
+	}
+	
+	double value = NUM2DBL(timeout);
+	if (value < 0) value = 0;
+	
+	time_t seconds = value;
+	
+	IO_Event_Selector_current_time(storage);
+	storage->tv_sec += seconds;
+	storage->tv_nsec += (value - seconds) * 1000000000L;
+	
+	if (storage->tv_nsec >= 1000000000L) {
+		storage->tv_sec += 1;
+		storage->tv_nsec -= 1000000000L;
+	}
+	
+	return storage;
+}
+
+static inline
+int IO_Event_Selector_Timer_before(struct IO_Event_Selector_Timer *a, struct IO_Event_Selector_Timer *b)
+{
+	if (a->deadline.tv_sec != b->deadline.tv_sec) {
+		return a->deadline.tv_sec < b->deadline.tv_sec;
+	}
+	
+	return a->deadline.tv_nsec < b->deadline.tv_nsec;
+}
+
+static inline
+void IO_Event_Selector_Timers_place(struct IO_Event_Selector_Timers *timers, size_t index, struct IO_Event_Selector_Timer *timer)
+{
+	timers->heap[index] = timer;
+	timer->index = index;
+}
+
+static
+void IO_Event_Selector_Timers_sift_up(struct IO_Event_Selector_Timers *timers, size_t index)
+{
+	struct IO_Event_Selector_Timer *timer = timers->heap[index];
+	
+	while (index > 0) {
+		size_t parent = (index - 1) / 2;
+		if (!IO_Event_Selector_Timer_before(timer, timers->heap[parent])) break;
+		
+		IO_Event_Selector_Timers_place(timers, index, timers->heap[parent]);
+		index = parent;
+	}
+	
+	IO_Event_Selector_Timers_place(timers, index, timer);
+}
+
+static
+void IO_Event_Selector_Timers_sift_down(struct IO_Event_Selector_Timers *timers, size_t index)
+{
+	struct IO_Event_Selector_Timer *timer = timers->heap[index];
+	
+	while (true) {
+		size_t child = index * 2 + 1;
+		if (child >= timers->count) break;
+		
+		if (child + 1 < timers->count && IO_Event_Selector_Timer_before(timers->heap[child + 1], timers->heap[child])) {
+			child += 1;
+		}
+		
+		if (!IO_Event_Selector_Timer_before(timers->heap[child], timer)) break;
+		
+		IO_Event_Selector_Timers_place(timers, index, timers->heap[child]);
+		index = child;
+	}
+	
+	IO_Event_Selector_Timers_place(timers, index, timer);
+}
+
+void IO_Event_Selector_Timers_free(struct IO_Event_Selector_Timers *timers)
+{
+	if (timers->heap) {
+		xfree(timers->heap);
+		timers->heap = NULL;
+		timers->count = 0;
+		timers->capacity = 0;
+	}
+}
+
+void IO_Event_Selector_Timers_add(struct IO_Event_Selector_Timers *timers, struct IO_Event_Selector_Timer *timer)
+{
+	if (timers->count == timers->capacity) {
+		timers->capacity = timers->capacity ? timers->capacity * 2 : 16;
+		timers->heap = xrealloc2(timers->heap, timers->capacity, sizeof(struct IO_Event_Selector_Timer *));
+	}
+	
+	timers->heap[timers->count] = timer;
+	timers->count += 1;
+	
+	IO_Event_Selector_Timers_sift_up(timers, timers->count - 1);
+}
+
+void IO_Event_Selector_Timers_remove(struct IO_Event_Selector_Timers *timers, struct IO_Event_Selector_Timer *timer)
+{
+	size_t index = timer->index;
+	if (index == SIZE_MAX) return;
+	
+	timer->index = SIZE_MAX;
+	timers->count -= 1;
+	
+	if (index == timers->count) return;
+	
+	// Move the last timer into the vacated slot, and restore the heap property in whichever direction is required:
+	struct IO_Event_Selector_Timer *moved = timers->heap[timers->count];
+	IO_Event_Selector_Timers_place(timers, index, moved);
+	IO_Event_Selector_Timers_sift_up(timers, index);
+	IO_Event_Selector_Timers_sift_down(timers, moved->index);
+}
+
+struct IO_Event_Selector_Timer * IO_Event_Selector_Timers_expire(struct IO_Event_Selector_Timers *timers, struct timespec *now)
+{
+	if (timers->count == 0) return NULL;
+	
+	struct IO_Event_Selector_Timer *timer = timers->heap[0];
+	struct IO_Event_Selector_Timer current = {.deadline = *now};
+	
+	if (IO_Event_Selector_Timer_before(&current, timer)) return NULL;
+	
+	IO_Event_Selector_Timers_remove(timers, timer);
+	
+	return timer;
+}
+
+struct timespec * IO_Event_Selector_Timers_timeout(struct IO_Event_Selector_Timers *timers, struct timespec *timeout, struct timespec *storage)
+{
+	if (timers->count == 0) return timeout;
+	
+	struct timespec now, remaining = {0, 0};
+	IO_Event_Selector_current_time(&now);
+	
+	struct IO_Event_Selector_Timer *timer = timers->heap[0];
+	struct IO_Event_Selector_Timer current = {.deadline = now};
+	
+	if (IO_Event_Selector_Timer_before(&current, timer)) {
+		IO_Event_Selector_elapsed_time(&now, &timer->deadline, &remaining);
+	}
+	
+	if (timeout == NULL || remaining.tv_sec < timeout->tv_sec || (remaining.tv_sec == timeout->tv_sec && remaining.tv_nsec < timeout->tv_nsec)) {
+		*storage = remaining;
+		return storage;
+	}
+	
+	return timeout;
+}
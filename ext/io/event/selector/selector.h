@@ -63,15 +63,172 @@ VALUE IO_Event_Selector_fiber_raise(VALUE fiber, int argc, VALUE *argv);
 int IO_Event_Selector_io_descriptor(VALUE io);
 #endif
 
+// Check (without blocking) whether the process has changed state, using the given `waitpid` flags. Returns nil if it hasn't.
 #ifdef HAVE_RB_PROCESS_STATUS_WAIT
-#define IO_Event_Selector_process_status_wait(pid) rb_process_status_wait(pid)
+#include <sys/wait.h>
+#define IO_Event_Selector_process_status_wait(pid, flags) rb_process_status_wait(pid, (flags) | WNOHANG)
 #else
-VALUE IO_Event_Selector_process_status_wait(rb_pid_t pid);
+VALUE IO_Event_Selector_process_status_wait(rb_pid_t pid, int flags);
 #endif
 
 int IO_Event_Selector_nonblock_set(int file_descriptor);
 void IO_Event_Selector_nonblock_restore(int file_descriptor, int flags);
 
+// Wrap an accepted (connected) descriptor in a `Socket` instance, taking ownership of it. The descriptor is closed if this fails.
+VALUE IO_Event_Selector_socket_for_fd(int descriptor);
+
+// The currently executing fiber.
+VALUE IO_Event_Selector_fiber_current(void);
+
+#include <poll.h>
+
+// The state of a call to `io_select`, which checks the readiness of several IOs at once.
+struct IO_Event_Selector_IO_Select {
+	// The arrays of IOs to check, any of which may be nil:
+	VALUE readable, writable, priority;
+	
+	// A `pollfd` for each IO, in the same order:
+	struct pollfd *pollfds;
+	size_t count;
+	VALUE storage;
+};
+
+// Convert the given arrays of IOs into `pollfd`s. Call `IO_Event_Selector_IO_Select_free` when finished.
+void IO_Event_Selector_IO_Select_initialize(struct IO_Event_Selector_IO_Select *select, VALUE readable, VALUE writable, VALUE priority);
+void IO_Event_Selector_IO_Select_free(struct IO_Event_Selector_IO_Select *select);
+
+// Check without blocking which IOs are ready, returning `[readable, writable, priority]` like `IO.select`, or nil if none are ready.
+VALUE IO_Event_Selector_IO_Select_ready(struct IO_Event_Selector_IO_Select *select);
+
+#ifdef __linux__
+// Create an epoll instance which becomes readable when any of the IOs are ready, so that a single wait can cover all of them. The caller must close it.
+int IO_Event_Selector_IO_Select_epoll(struct IO_Event_Selector_IO_Select *select);
+#endif
+
+enum IO_Event_Selector_Descriptor_Flags {
+	// The descriptor has been inspected:
+	IO_EVENT_SELECTOR_DESCRIPTOR_KNOWN = 1,
+	// The descriptor is a socket, so we can use `MSG_DONTWAIT` rather than toggling `O_NONBLOCK`:
+	IO_EVENT_SELECTOR_DESCRIPTOR_SOCKET = 2,
+	// The descriptor is a regular file, so blocking operations should be executed by the worker pool:
+	IO_EVENT_SELECTOR_DESCRIPTOR_REGULAR = 4,
+	// `SO_ZEROCOPY` has been enabled on the socket:
+	IO_EVENT_SELECTOR_DESCRIPTOR_ZEROCOPY = 8,
+	// The socket does not support `SO_ZEROCOPY`:
+	IO_EVENT_SELECTOR_DESCRIPTOR_ZEROCOPY_UNSUPPORTED = 16,
+};
+
+struct IO_Event_Selector_Descriptor {
+	enum IO_Event_Selector_Descriptor_Flags flags;
+	
+	// A moving average of the size of adaptive reads, used to size the buffer for the next one, or zero if unknown:
+	size_t read_size;
+};
+
+// The smallest buffer (in bytes) which an adaptive read will use:
+#define IO_EVENT_SELECTOR_READ_SIZE_MINIMUM 512
+
+// Include the size of a completed read in the moving average, giving it a weight of 1/8:
+static inline
+void IO_Event_Selector_Descriptor_read(struct IO_Event_Selector_Descriptor *state, size_t size) {
+	if (state->read_size) {
+		state->read_size = state->read_size - state->read_size / 8 + size / 8;
+	} else {
+		state->read_size = size;
+	}
+}
+
+// A cache of per-descriptor state, indexed by file descriptor. Entries may be stale if a descriptor is closed and reused, so they must only be used as hints which can be validated cheaply.
+struct IO_Event_Selector_Descriptors {
+	size_t size;
+	struct IO_Event_Selector_Descriptor *descriptors;
+};
+
+static inline
+void IO_Event_Selector_Descriptors_initialize(struct IO_Event_Selector_Descriptors *descriptors) {
+	descriptors->size = 0;
+	descriptors->descriptors = NULL;
+}
+
+void IO_Event_Selector_Descriptors_free(struct IO_Event_Selector_Descriptors *descriptors);
+
+// Lookup the state for the given descriptor, growing the table if required. The returned pointer is only valid until the next lookup.
+struct IO_Event_Selector_Descriptor * IO_Event_Selector_Descriptors_lookup(struct IO_Event_Selector_Descriptors *descriptors, int descriptor);
+
+#ifndef _WIN32
+// Tracks how a descriptor was made non-blocking for the duration of an operation.
+struct IO_Event_Selector_Nonblock {
+	struct IO_Event_Selector_Descriptors *descriptors;
+	int descriptor;
+	
+	// The original file status flags if `O_NONBLOCK` was set, or -1 if we are using `MSG_DONTWAIT`:
+	int flags;
+};
+
+// Whether the descriptor is a socket, probing and caching the result if it is not already known.
+int IO_Event_Selector_Descriptor_socket_p(struct IO_Event_Selector_Descriptor *state, int descriptor);
+
+// Whether the descriptor is a regular file. A negative result is cached until the descriptor is forgotten, but a positive one is always checked again.
+int IO_Event_Selector_Descriptors_regular_p(struct IO_Event_Selector_Descriptors *descriptors, int descriptor);
+
+// Discard the cached state for the given descriptor, e.g. because it was closed and may be reused for something else.
+void IO_Event_Selector_Descriptors_forget(struct IO_Event_Selector_Descriptors *descriptors, int descriptor);
+
+void IO_Event_Selector_Nonblock_set(struct IO_Event_Selector_Nonblock *nonblock, struct IO_Event_Selector_Descriptors *descriptors, int descriptor);
+void IO_Event_Selector_Nonblock_restore(struct IO_Event_Selector_Nonblock *nonblock);
+
+ssize_t IO_Event_Selector_Nonblock_read(struct IO_Event_Selector_Nonblock *nonblock, void *base, size_t size);
+ssize_t IO_Event_Selector_Nonblock_write(struct IO_Event_Selector_Nonblock *nonblock, const void *base, size_t size);
+
+#include <sys/uio.h>
+#include <limits.h>
+
+ssize_t IO_Event_Selector_Nonblock_readv(struct IO_Event_Selector_Nonblock *nonblock, const struct iovec *iovecs, int count);
+ssize_t IO_Event_Selector_Nonblock_writev(struct IO_Event_Selector_Nonblock *nonblock, const struct iovec *iovecs, int count);
+
+#ifdef HAVE_RUBY_IO_BUFFER_H
+// Fill in the iovecs from an array of `IO::Buffer` instances (or slices), which will be written to (i.e. by a vectored read), returning the total size.
+size_t IO_Event_Selector_iovecs_for_writing(VALUE buffers, struct iovec *iovecs, int count);
+// Fill in the iovecs from an array of `IO::Buffer` instances (or slices), which will be read from (i.e. by a vectored write), returning the total size.
+size_t IO_Event_Selector_iovecs_for_reading(VALUE buffers, struct iovec *iovecs, int count);
+
+#include <sys/socket.h>
+
+// The number of datagrams which are sent or received by a single batch:
+#define IO_EVENT_SELECTOR_MESSAGES_MAXIMUM 64
+
+// The storage referred to by a message header, which must outlive the system call:
+struct IO_Event_Selector_Message {
+	struct iovec iovec;
+	struct sockaddr_storage address;
+	
+	// Space for a single integer control message, i.e. the segment size for `UDP_SEGMENT` or `UDP_GRO`:
+	union {
+		char buffer[CMSG_SPACE(sizeof(int))];
+		struct cmsghdr header;
+	} control;
+};
+
+// Prepare a message header for receiving a datagram into the given `IO::Buffer`, along with the address of the sender and the segment size of coalesced datagrams.
+void IO_Event_Selector_message_for_writing(VALUE buffer, struct msghdr *header, struct IO_Event_Selector_Message *message);
+// Prepare a message header for sending a datagram, given as `[buffer, length, address, segment_size]`. The address (an `Addrinfo` or a packed `sockaddr` string) may be omitted or nil for connected sockets. If a segment size is given, the kernel splits the data into datagrams of that size (`UDP_SEGMENT`).
+void IO_Event_Selector_message_for_reading(VALUE message, struct msghdr *header, struct IO_Event_Selector_Message *storage);
+// Returns `[length, address, segment_size]` for a datagram which was received using the given header. The address is an `Addrinfo` or nil, and the segment size is nil unless the socket has `UDP_GRO` enabled and the kernel coalesced several datagrams.
+VALUE IO_Event_Selector_message_received(struct msghdr *header, size_t length);
+#endif
+
+// Consume the given number of bytes from the start of the iovecs, returning the first iovec which still has data and updating the count.
+struct iovec * IO_Event_Selector_iovecs_advance(struct iovec *iovecs, int *count, size_t size);
+
+// The number of iovecs which can be passed to a single system call:
+static inline int IO_Event_Selector_iovecs_limit(int count) {
+	return count > IOV_MAX ? IOV_MAX : count;
+}
+#endif
+
+// Search `base[*from...size]` for the delimiter, returning its offset, or -1 if it was not found. In that case, `*from` is advanced so that searching again after more data arrives only covers the new bytes (and any delimiter which straddles them).
+ssize_t IO_Event_Selector_search(const char *base, size_t size, size_t *from, const char *delimiter, size_t length);
+
 enum IO_Event_Selector_Queue_Flags {
 	IO_EVENT_SELECTOR_QUEUE_FIBER = 1,
 	IO_EVENT_SELECTOR_QUEUE_INTERNAL = 2,
@@ -127,8 +284,83 @@ VALUE IO_Event_Selector_yield(struct IO_Event_Selector *backend)
 void IO_Event_Selector_queue_push(struct IO_Event_Selector *backend, VALUE fiber);
 int IO_Event_Selector_queue_flush(struct IO_Event_Selector *backend);
 
+// A fiber blocked on an operation on a descriptor, which can be woken early by `io_cancel`. Usually embedded in the arguments of the operation, and zero initialized.
+struct IO_Event_Selector_Waiter {
+	struct IO_Event_Selector_Waiter *previous;
+	struct IO_Event_Selector_Waiter *next;
+	
+	int descriptor;
+	
+	// Whether the waiter is in the table, and whether it is in the ready queue:
+	int linked, queued;
+	
+	// Whether the waiter was cancelled. If it was cancelled by `IO_Event_Selector_Waiters_cancel`, it is resumed (with nil) from the ready queue, unless the operation completes first:
+	int cancelled;
+	
+	struct IO_Event_Selector_Queue queue;
+};
+
+// Add the waiter to the table of waiters, which is indexed by descriptor.
+void IO_Event_Selector_Waiter_add(st_table **waiters, struct IO_Event_Selector_Waiter *waiter, VALUE fiber, int descriptor);
+// Remove the waiter from the table and the ready queue. This must be called once the fiber is resumed (or fails), and may be called more than once.
+void IO_Event_Selector_Waiter_remove(struct IO_Event_Selector *backend, st_table **waiters, struct IO_Event_Selector_Waiter *waiter);
+
+// Remove every waiter on the given descriptor from the table, marking them as cancelled. The caller is responsible for resuming their fibers. Returns the cancelled waiters (linked by `next`).
+struct IO_Event_Selector_Waiter * IO_Event_Selector_Waiters_detach(st_table **waiters, int descriptor);
+
+// Cancel every waiter on the given descriptor, scheduling their fibers to be resumed. Returns the cancelled waiters (linked by `next`), which remain valid until the fibers are resumed.
+struct IO_Event_Selector_Waiter * IO_Event_Selector_Waiters_cancel(struct IO_Event_Selector *backend, st_table **waiters, int descriptor);
+void IO_Event_Selector_Waiters_free(st_table **waiters);
+
+// Flush the given descriptor on behalf of the given fiber, returning 0 on success or -errno on failure.
+typedef int (*IO_Event_Selector_Sync_Function)(VALUE self, VALUE fiber, int descriptor, int datasync);
+
+// Coalesce concurrent `fsync`/`fdatasync` requests for the same descriptor (group commit). Requests which arrive while a flush is in progress are queued, and a single flush is then performed on behalf of all of them. A full `fsync` is used if any of them asked for it.
+int IO_Event_Selector_sync(struct IO_Event_Selector *backend, st_table **syncs, VALUE self, VALUE fiber, int descriptor, int datasync, IO_Event_Selector_Sync_Function function);
+void IO_Event_Selector_syncs_free(st_table **syncs);
+
 void IO_Event_Selector_elapsed_time(struct timespec* start, struct timespec* stop, struct timespec *duration);
 void IO_Event_Selector_current_time(struct timespec *time);
 
+// Convert a relative timeout in seconds (or nil) into an absolute deadline on the monotonic clock. Returns NULL if there is no timeout.
+struct timespec * IO_Event_Selector_deadline(VALUE timeout, struct timespec *storage);
+
+// A fiber waiting until a deadline, for selectors which can't attach timeouts to individual operations.
+struct IO_Event_Selector_Timer {
+	struct timespec deadline;
+	VALUE fiber;
+	
+	// The position of this timer in the heap, or SIZE_MAX if it is not scheduled:
+	size_t index;
+};
+
+// A binary heap of timers, ordered by deadline.
+struct IO_Event_Selector_Timers {
+	size_t count;
+	size_t capacity;
+	struct IO_Event_Selector_Timer **heap;
+};
+
+static inline
+void IO_Event_Selector_Timers_initialize(struct IO_Event_Selector_Timers *timers) {
+	timers->count = 0;
+	timers->capacity = 0;
+	timers->heap = NULL;
+}
+
+void IO_Event_Selector_Timers_free(struct IO_Event_Selector_Timers *timers);
+
+void IO_Event_Selector_Timers_add(struct IO_Event_Selector_Timers *timers, struct IO_Event_Selector_Timer *timer);
+void IO_Event_Selector_Timers_remove(struct IO_Event_Selector_Timers *timers, struct IO_Event_Selector_Timer *timer);
+
+// Remove and return the earliest timer if its deadline has passed, otherwise return NULL.
+struct IO_Event_Selector_Timer * IO_Event_Selector_Timers_expire(struct IO_Event_Selector_Timers *timers, struct timespec *now);
+
+// Reduce the given timeout (which may be NULL, i.e. infinite) so that we don't wait beyond the earliest deadline.
+struct timespec * IO_Event_Selector_Timers_timeout(struct IO_Event_Selector_Timers *timers, struct timespec *timeout, struct timespec *storage);
+
+// Zero-copy writes smaller than this are not worthwhile, as pinning the pages and waiting for the kernel to release them costs more than copying the data:
+#define IO_EVENT_SELECTOR_ZEROCOPY_MINIMUM (16*1024)
+
 #define PRINTF_TIMESPEC "%lld.%.9ld"
 #define PRINTF_TIMESPEC_ARGS(ts) (long long)((ts).tv_sec), (ts).tv_nsec
@@ -23,8 +23,14 @@
 
 #include <liburing.h>
 #include <poll.h>
+#include <stddef.h>
 #include <stdint.h>
 #include <time.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <sys/stat.h>
+#include <sys/sysmacros.h>
+#include <sys/epoll.h>
 
 #include "pidfd.c"
 
@@ -46,8 +52,22 @@ struct IO_Event_Selector_URing {
 	struct io_uring ring;
 	size_t pending;
 	int blocked;
+	
+	// Maps the pids of processes spawned by `process_spawn` to their pidfds:
+	st_table *pidfds;
+	
+	// Maps descriptors to the state of their in-progress (coalesced) `fsync` requests:
+	st_table *syncs;
+	
+	// Maps listening descriptors to the state of their multishot accept:
+	st_table *accepts;
+	
+	// Maps descriptors to the fibers waiting on them, so that `io_cancel` can wake them:
+	st_table *waiters;
 };
 
+static void io_accept_free_all(st_table **accepts);
+
 void IO_Event_Selector_URing_Type_mark(void *_data)
 {
 	struct IO_Event_Selector_URing *data = _data;
@@ -60,6 +80,8 @@ void close_internal(struct IO_Event_Selector_URing *data) {
 		io_uring_queue_exit(&data->ring);
 		data->ring.ring_fd = -1;
 	}
+	
+	IO_Event_Selector_process_pidfds_free(&data->pidfds);
 }
 
 void IO_Event_Selector_URing_Type_free(void *_data)
@@ -68,6 +90,10 @@ void IO_Event_Selector_URing_Type_free(void *_data)
 	
 	close_internal(data);
 	
+	IO_Event_Selector_syncs_free(&data->syncs);
+	io_accept_free_all(&data->accepts);
+	IO_Event_Selector_Waiters_free(&data->waiters);
+	
 	free(data);
 }
 
@@ -97,6 +123,11 @@ VALUE IO_Event_Selector_URing_allocate(VALUE self) {
 	data->pending = 0;
 	data->blocked = 0;
 	
+	data->pidfds = NULL;
+	data->syncs = NULL;
+	data->accepts = NULL;
+	data->waiters = NULL;
+	
 	return instance;
 }
 
@@ -175,7 +206,7 @@ VALUE IO_Event_Selector_URing_raise(int argc, VALUE *argv, VALUE self)
 	
 	return IO_Event_Selector_raise(&data->backend, argc, argv);
 }
-	
+
 VALUE IO_Event_Selector_URing_ready_p(VALUE self) {
 	struct IO_Event_Selector_URing *data = NULL;
 	TypedData_Get_Struct(self, struct IO_Event_Selector_URing, &IO_Event_Selector_URing_Type, data);
@@ -211,7 +242,7 @@ int io_uring_submit_flush(struct IO_Event_Selector_URing *data) {
 static
 int io_uring_submit_now(struct IO_Event_Selector_URing *data) {
 	if (DEBUG && data->pending) fprintf(stderr, "io_uring_submit_now(pending=%ld)\n", data->pending);
-
+	
 	while (true) {
 		int result = io_uring_submit(&data->ring);
 		
@@ -249,6 +280,181 @@ struct io_uring_sqe * io_get_sqe(struct IO_Event_Selector_URing *data) {
 	return sqe;
 }
 
+#pragma mark - Operations
+
+// Operations which can be cancelled by `io_cancel`, or which have a deadline, complete with their own state rather than the fiber, so that completions which arrive after the fiber has stopped waiting (e.g. a timeout which expired just as the operation completed) can be ignored:
+#define IO_EVENT_URING_OPERATION_TAG ((uintptr_t)6)
+
+struct io_operation {
+	VALUE fiber;
+	
+	// The number of submitted entries (the operation, and its linked timeout if any) which have not completed yet:
+	int pending;
+	
+	// Whether the fiber was resumed by a completion, and whether it stopped waiting, in which case the final completion frees the operation:
+	int completed;
+	int abandoned;
+	
+	// Registered while the fiber is waiting, so that `io_cancel` can find the operation:
+	struct IO_Event_Selector_Waiter waiter;
+};
+
+static
+struct io_operation * io_operation_new(VALUE fiber) {
+	struct io_operation *operation = calloc(1, sizeof(struct io_operation));
+	if (operation == NULL) rb_sys_fail("io_operation_new:calloc");
+	
+	operation->fiber = fiber;
+	
+	return operation;
+}
+
+// Complete the prepared submission with the given operation.
+static
+void io_operation_prepare(struct io_operation *operation, struct io_uring_sqe *sqe) {
+	io_uring_sqe_set_data(sqe, (void*)((uintptr_t)operation | IO_EVENT_URING_OPERATION_TAG));
+	operation->pending += 1;
+}
+
+// Transfer to the event loop until the operation on the given descriptor completes, returning the result. If it's cancelled by `io_cancel` first, the result is -ECANCELED. The caller must release the operation afterwards, even if the transfer fails.
+static
+VALUE io_operation_transfer(struct IO_Event_Selector_URing *data, struct io_operation *operation, int descriptor) {
+	IO_Event_Selector_Waiter_add(&data->waiters, &operation->waiter, operation->fiber, descriptor);
+	
+	VALUE result = IO_Event_Selector_fiber_transfer(data->backend.loop, 0, NULL);
+	
+	IO_Event_Selector_Waiter_remove(&data->backend, &data->waiters, &operation->waiter);
+	
+	return result;
+}
+
+// The fiber has stopped waiting. If the operation is still in flight, it is cancelled, and its final completion frees it.
+static
+void io_operation_release(struct IO_Event_Selector_URing *data, struct io_operation *operation) {
+	IO_Event_Selector_Waiter_remove(&data->backend, &data->waiters, &operation->waiter);
+	
+	if (operation->pending == 0) {
+		free(operation);
+		return;
+	}
+	
+	operation->abandoned = 1;
+	
+	if (!operation->completed) {
+		struct io_uring_sqe *sqe = io_get_sqe(data);
+		
+		if (DEBUG) fprintf(stderr, "io_operation_release:io_uring_prep_cancel(fiber=%p)\n", (void*)operation->fiber);
+		
+		io_uring_prep_cancel(sqe, (void*)((uintptr_t)operation | IO_EVENT_URING_OPERATION_TAG), 0);
+		io_uring_sqe_set_data(sqe, NULL);
+		io_uring_submit_now(data);
+	}
+}
+
+// Handle the completion of the operation, or of its linked timeout. Whichever completes first with a result resumes the fiber, and the other is ignored.
+static
+void io_operation_complete(struct io_operation *operation, int result, int timeout) {
+	operation->pending -= 1;
+	
+	if (operation->abandoned) {
+		if (operation->pending == 0) free(operation);
+		return;
+	}
+	
+	if (timeout) {
+		// The timeout only resumes the fiber if it expired and cancelled the operation, or the operation was cancelled some other way (and its completion was ignored below):
+		if (result != -ETIME) {
+			if (operation->pending) return;
+			result = -ECANCELED;
+		}
+	} else if (result == -ECANCELED && operation->pending && !operation->waiter.cancelled) {
+		// The operation was (most likely) cancelled by its linked timeout, which resumes the fiber:
+		return;
+	}
+	
+	operation->completed = 1;
+	
+	// The operation may be freed by the fiber, so it must not be used after this:
+	VALUE value = RB_INT2NUM(result);
+	IO_Event_Selector_fiber_transfer(operation->fiber, 1, &value);
+}
+
+#pragma mark - Deadlines
+
+// Linked timeouts complete with the same state as the operation they are attached to, tagged so that they can be distinguished:
+#define IO_EVENT_URING_TIMEOUT_TAG ((uintptr_t)1)
+
+// Fibers (and other completion states) are aligned, so the low bits of the user data identify the kind of completion:
+#define IO_EVENT_URING_TAG_MASK ((uintptr_t)7)
+
+// Convert a relative timeout in seconds (or nil) into an absolute deadline suitable for `io_link_timeout`.
+static
+struct __kernel_timespec * io_deadline(VALUE timeout, struct __kernel_timespec *storage) {
+	struct timespec deadline;
+	
+	if (!IO_Event_Selector_deadline(timeout, &deadline)) {
+		return NULL;
+	}
+	
+	storage->tv_sec = deadline.tv_sec;
+	storage->tv_nsec = deadline.tv_nsec;
+	
+	return storage;
+}
+
+// Get a submission queue entry, ensuring there is space for a linked timeout if required, as the two must be submitted together.
+static
+struct io_uring_sqe * io_get_sqe_with_deadline(struct IO_Event_Selector_URing *data, struct __kernel_timespec *deadline) {
+	if (deadline && io_uring_sq_space_left(&data->ring) < 2) {
+		io_uring_submit_now(data);
+	}
+	
+	return io_get_sqe(data);
+}
+
+// Link a timeout to the operation which was just prepared. If the deadline expires, the operation is cancelled (its completion with -ECANCELED is ignored), and the fiber is instead resumed by the timeout with -ETIME. The deadline must remain valid until it is submitted.
+static
+void io_link_timeout(struct IO_Event_Selector_URing *data, struct io_operation *operation, struct io_uring_sqe *sqe, struct __kernel_timespec *deadline) {
+	if (!deadline) return;
+	
+	io_uring_sqe_set_flags(sqe, IOSQE_IO_LINK);
+	
+	struct io_uring_sqe *timeout = io_uring_get_sqe(&data->ring);
+	io_uring_prep_link_timeout(timeout, deadline, IORING_TIMEOUT_ABS);
+	io_uring_sqe_set_data(timeout, (void*)((uintptr_t)operation | IO_EVENT_URING_TIMEOUT_TAG));
+	operation->pending += 1;
+}
+
+#pragma mark - IO#cancel
+
+// Wake every fiber waiting on the given IO, which fail with `Errno::ECANCELED` unless their operation has already completed. The operations are cancelled by a single submission, and each fiber is resumed by the completion of its own operation. Returns the number of fibers which were woken.
+VALUE IO_Event_Selector_URing_io_cancel(VALUE self, VALUE io) {
+	struct IO_Event_Selector_URing *data = NULL;
+	TypedData_Get_Struct(self, struct IO_Event_Selector_URing, &IO_Event_Selector_URing_Type, data);
+	
+	int descriptor = IO_Event_Selector_io_descriptor(io);
+	size_t count = 0;
+	
+	struct IO_Event_Selector_Waiter *waiter = IO_Event_Selector_Waiters_detach(&data->waiters, descriptor);
+	
+	// We cancel each operation by user data rather than by descriptor, which would also cancel operations (e.g. multishot accept) that nobody is waiting on:
+	for (; waiter; waiter = waiter->next) {
+		struct io_operation *operation = (struct io_operation *)((char*)waiter - offsetof(struct io_operation, waiter));
+		
+		struct io_uring_sqe *sqe = io_get_sqe(data);
+		io_uring_prep_cancel(sqe, (void*)((uintptr_t)operation | IO_EVENT_URING_OPERATION_TAG), 0);
+		io_uring_sqe_set_data(sqe, NULL);
+		
+		count += 1;
+	}
+	
+	if (count) {
+		io_uring_submit_now(data);
+	}
+	
+	return SIZET2NUM(count);
+}
+
 #pragma mark - Process.wait
 
 struct process_wait_arguments {
@@ -256,49 +462,95 @@ struct process_wait_arguments {
 	pid_t pid;
 	int flags;
 	int descriptor;
+	
+	struct __kernel_timespec *deadline;
+	
+	struct io_operation *operation;
 };
 
 static
 VALUE process_wait_transfer(VALUE _arguments) {
 	struct process_wait_arguments *arguments = (struct process_wait_arguments *)_arguments;
+	struct IO_Event_Selector_URing *data = arguments->data;
+	
+	struct io_uring_sqe *sqe = io_get_sqe_with_deadline(data, arguments->deadline);
+	
+	if (DEBUG) fprintf(stderr, "IO_Event_Selector_URing_process_wait:io_uring_prep_poll_add(%p)\n", (void*)arguments->operation->fiber);
+	io_uring_prep_poll_add(sqe, arguments->descriptor, POLLIN|POLLHUP|POLLERR);
+	io_operation_prepare(arguments->operation, sqe);
+	io_link_timeout(data, arguments->operation, sqe, arguments->deadline);
+	io_uring_submit_pending(data);
 	
-	IO_Event_Selector_fiber_transfer(arguments->data->backend.loop, 0, NULL);
+	IO_Event_Selector_fiber_transfer(data->backend.loop, 0, NULL);
 	
-	return IO_Event_Selector_process_status_wait(arguments->pid);
+	return IO_Event_Selector_process_status_wait(arguments->pid, arguments->flags);
 }
 
 static
 VALUE process_wait_ensure(VALUE _arguments) {
 	struct process_wait_arguments *arguments = (struct process_wait_arguments *)_arguments;
 	
+	io_operation_release(arguments->data, arguments->operation);
 	close(arguments->descriptor);
 	
 	return Qnil;
 }
 
-VALUE IO_Event_Selector_URing_process_wait(VALUE self, VALUE fiber, VALUE pid, VALUE flags) {
+// Wait for the given process to exit. If a timeout (in seconds) is given and the process is still running when it expires, returns nil.
+VALUE IO_Event_Selector_URing_process_wait(int argc, VALUE *argv, VALUE self) {
 	struct IO_Event_Selector_URing *data = NULL;
 	TypedData_Get_Struct(self, struct IO_Event_Selector_URing, &IO_Event_Selector_URing_Type, data);
 	
+	rb_check_arity(argc, 3, 4);
+	
+	VALUE fiber = argv[0], pid = argv[1], flags = argv[2];
+	
+	struct __kernel_timespec storage;
+	struct __kernel_timespec *deadline = io_deadline(argc == 4 ? argv[3] : Qnil, &storage);
+	
 	struct process_wait_arguments process_wait_arguments = {
 		.data = data,
 		.pid = NUM2PIDT(pid),
 		.flags = NUM2INT(flags),
+		.deadline = deadline,
 	};
 	
-	process_wait_arguments.descriptor = pidfd_open(process_wait_arguments.pid, 0);
-	rb_update_max_fd(process_wait_arguments.descriptor);
+	// If the process was spawned by `process_spawn`, we already have a pidfd for it:
+	process_wait_arguments.descriptor = IO_Event_Selector_process_pidfd(data->pidfds, process_wait_arguments.pid);
+	
+	// If the process has already exited, we can avoid allocating a pidfd and submitting a poll:
+	VALUE status = IO_Event_Selector_process_status_wait(process_wait_arguments.pid, process_wait_arguments.flags);
+	if (!NIL_P(status)) {
+		if (process_wait_arguments.descriptor >= 0) close(process_wait_arguments.descriptor);
+		
+		return status;
+	}
+	
+	if (process_wait_arguments.descriptor == -1) {
+		process_wait_arguments.descriptor = pidfd_open(process_wait_arguments.pid, 0);
+		
+		if (process_wait_arguments.descriptor == -1) {
+			rb_sys_fail("IO_Event_Selector_URing_process_wait:pidfd_open");
+		}
+		
+		rb_update_max_fd(process_wait_arguments.descriptor);
+	}
+	
+	process_wait_arguments.operation = io_operation_new(fiber);
 	
-	struct io_uring_sqe *sqe = io_get_sqe(data);
-
-	if (DEBUG) fprintf(stderr, "IO_Event_Selector_URing_process_wait:io_uring_prep_poll_add(%p)\n", (void*)fiber);
-	io_uring_prep_poll_add(sqe, process_wait_arguments.descriptor, POLLIN|POLLHUP|POLLERR);
-	io_uring_sqe_set_data(sqe, (void*)fiber);
-	io_uring_submit_pending(data);
-
 	return rb_ensure(process_wait_transfer, (VALUE)&process_wait_arguments, process_wait_ensure, (VALUE)&process_wait_arguments);
 }
 
+VALUE IO_Event_Selector_URing_process_spawn(int argc, VALUE *argv, VALUE self) {
+	struct IO_Event_Selector_URing *data = NULL;
+	TypedData_Get_Struct(self, struct IO_Event_Selector_URing, &IO_Event_Selector_URing_Type, data);
+	
+	rb_check_arity(argc, 2, UNLIMITED_ARGUMENTS);
+	
+	// The first argument is the fiber, which is not needed since spawning doesn't block:
+	return IO_Event_Selector_process_spawn(&data->pidfds, argc - 1, argv + 1);
+}
+
 #pragma mark - IO#wait
 
 static inline
@@ -309,14 +561,18 @@ short poll_flags_from_events(int events) {
 	if (events & IO_EVENT_PRIORITY) flags |= POLLPRI;
 	if (events & IO_EVENT_WRITABLE) flags |= POLLOUT;
 	
+	// The peer shutting down its side of the connection is only reported if requested:
+	if (events & IO_EVENT_HANGUP) flags |= POLLRDHUP;
+	
 	flags |= POLLHUP;
 	flags |= POLLERR;
 	
 	return flags;
 }
 
+// See `epoll.c` for details regarding the reporting of hangups and errors.
 static inline
-int events_from_poll_flags(short flags) {
+int events_from_poll_flags(short flags, int requested) {
 	int events = 0;
 	
 	// See `epoll.c` for details regarding POLLHUP:
@@ -324,243 +580,1975 @@ int events_from_poll_flags(short flags) {
 	if (flags & POLLPRI) events |= IO_EVENT_PRIORITY;
 	if (flags & POLLOUT) events |= IO_EVENT_WRITABLE;
 	
+	if (flags & (POLLHUP|POLLRDHUP)) events |= (requested & IO_EVENT_HANGUP);
+	if (flags & POLLERR) events |= (requested & IO_EVENT_ERROR);
+	
 	return events;
 }
 
 struct io_wait_arguments {
 	struct IO_Event_Selector_URing *data;
 	VALUE fiber;
+	int descriptor;
+	int events;
 	short flags;
+	
+	struct __kernel_timespec *deadline;
+	
+	struct io_operation *operation;
 };
 
 static
-VALUE io_wait_rescue(VALUE _arguments, VALUE exception) {
+VALUE io_wait_ensure(VALUE _arguments) {
 	struct io_wait_arguments *arguments = (struct io_wait_arguments *)_arguments;
-	struct IO_Event_Selector_URing *data = arguments->data;
-	
-	struct io_uring_sqe *sqe = io_get_sqe(data);
 	
-	if (DEBUG) fprintf(stderr, "io_wait_rescue:io_uring_prep_poll_remove(%p)\n", (void*)arguments->fiber);
+	io_operation_release(arguments->data, arguments->operation);
 	
-	io_uring_prep_poll_remove(sqe, (uintptr_t)arguments->fiber);
-	io_uring_sqe_set_data(sqe, NULL);
-	io_uring_submit_now(data);
-
-	rb_exc_raise(exception);
+	return Qnil;
 };
 
 static
 VALUE io_wait_transfer(VALUE _arguments) {
 	struct io_wait_arguments *arguments = (struct io_wait_arguments *)_arguments;
 	struct IO_Event_Selector_URing *data = arguments->data;
-
-	VALUE result = IO_Event_Selector_fiber_transfer(data->backend.loop, 0, NULL);
+	
+	struct io_uring_sqe *sqe = io_get_sqe_with_deadline(data, arguments->deadline);
+	
+	if (DEBUG) fprintf(stderr, "IO_Event_Selector_URing_io_wait:io_uring_prep_poll_add(descriptor=%d, flags=%d, fiber=%p)\n", arguments->descriptor, arguments->flags, (void*)arguments->fiber);
+	
+	io_uring_prep_poll_add(sqe, arguments->descriptor, arguments->flags);
+	io_operation_prepare(arguments->operation, sqe);
+	io_link_timeout(data, arguments->operation, sqe, arguments->deadline);
+	
+	// If we are going to wait, we assume that we are waiting for a while:
+	io_uring_submit_pending(data);
+	
+	VALUE result = io_operation_transfer(data, arguments->operation, arguments->descriptor);
 	if (DEBUG) fprintf(stderr, "io_wait:IO_Event_Selector_fiber_transfer -> %d\n", RB_NUM2INT(result));
-
-	if (!RTEST(result)) {
+	
+	if (result == RB_INT2NUM(-ECANCELED)) {
+		// Many fibers may be cancelled at once, so we avoid formatting a message for each of them:
+		rb_syserr_fail(ECANCELED, NULL);
+	}
+	
+	// The fiber might be resumed with nil if it's being cancelled, or -ETIME if the deadline expired:
+	if (!RTEST(result) || RB_NUM2INT(result) == -ETIME) {
 		return Qfalse;
 	}
-
+	
 	// We explicitly filter the resulting events based on the requested events.
 	// In some cases, poll will report events we didn't ask for.
 	short flags = arguments->flags & NUM2INT(result);
 	
-	return INT2NUM(events_from_poll_flags(flags));
+	return INT2NUM(events_from_poll_flags(flags, arguments->events));
 };
 
-VALUE IO_Event_Selector_URing_io_wait(VALUE self, VALUE fiber, VALUE io, VALUE events) {
-	struct IO_Event_Selector_URing *data = NULL;
-	TypedData_Get_Struct(self, struct IO_Event_Selector_URing, &IO_Event_Selector_URing_Type, data);
-	
-	int descriptor = IO_Event_Selector_io_descriptor(io);
-	struct io_uring_sqe *sqe = io_get_sqe(data);
-	
-	short flags = poll_flags_from_events(NUM2INT(events));
-	
-	if (DEBUG) fprintf(stderr, "IO_Event_Selector_URing_io_wait:io_uring_prep_poll_add(descriptor=%d, flags=%d, fiber=%p)\n", descriptor, flags, (void*)fiber);
-	
-	io_uring_prep_poll_add(sqe, descriptor, flags);
-	io_uring_sqe_set_data(sqe, (void*)fiber);
-	
-	// If we are going to wait, we assume that we are waiting for a while:
-	io_uring_submit_pending(data);
-	
+static
+VALUE io_wait_descriptor(struct IO_Event_Selector_URing *data, VALUE fiber, int descriptor, int events, struct __kernel_timespec *deadline) {
 	struct io_wait_arguments io_wait_arguments = {
 		.data = data,
 		.fiber = fiber,
-		.flags = flags
+		.descriptor = descriptor,
+		.events = events,
+		.flags = poll_flags_from_events(events),
+		.deadline = deadline,
+		.operation = io_operation_new(fiber),
 	};
 	
-	return rb_rescue(io_wait_transfer, (VALUE)&io_wait_arguments, io_wait_rescue, (VALUE)&io_wait_arguments);
+	return rb_ensure(io_wait_transfer, (VALUE)&io_wait_arguments, io_wait_ensure, (VALUE)&io_wait_arguments);
 }
 
-#ifdef HAVE_RUBY_IO_BUFFER_H
-
-#pragma mark - IO#read
+// Wait for the given events, or until the deadline (if not NULL) expires, in which case false is returned.
+static
+VALUE io_wait(VALUE self, VALUE fiber, VALUE io, VALUE events, struct __kernel_timespec *deadline) {
+	struct IO_Event_Selector_URing *data = NULL;
+	TypedData_Get_Struct(self, struct IO_Event_Selector_URing, &IO_Event_Selector_URing_Type, data);
+	
+	int descriptor = IO_Event_Selector_io_descriptor(io);
+	
+	return io_wait_descriptor(data, fiber, descriptor, NUM2INT(events), deadline);
+}
 
-#if LINUX_VERSION_CODE >= KERNEL_VERSION(5,16,0)
-static inline off_t io_seekable(int descriptor) {
-	return -1;
+VALUE IO_Event_Selector_URing_io_wait(VALUE self, VALUE fiber, VALUE io, VALUE events) {
+	return io_wait(self, fiber, io, events, NULL);
 }
-#else
-#warning Upgrade your kernel to 5.16! io_uring bugs prevent efficient io_read/io_write hooks.
-static inline off_t io_seekable(int descriptor)
+
+// Wait for the given events. If a timeout (in seconds) is given and none of the events occur before it expires, returns false.
+static VALUE IO_Event_Selector_URing_io_wait_compatible(int argc, VALUE *argv, VALUE self)
 {
-	if (lseek(descriptor, 0, SEEK_CUR) == -1) {
-		return 0;
-	} else {
-		return -1;
-	}
+	rb_check_arity(argc, 3, 4);
+	
+	struct __kernel_timespec storage;
+	struct __kernel_timespec *deadline = io_deadline(argc == 4 ? argv[3] : Qnil, &storage);
+	
+	return io_wait(self, argv[0], argv[1], argv[2], deadline);
 }
-#endif
 
-#pragma mark - IO#read
+#pragma mark - IO#wait_many
 
-struct io_read_arguments {
-	struct IO_Event_Selector_URing *data;
-	VALUE fiber;
+// Each poll operation submitted by `io_wait_many` completes with its own tagged entry:
+#define IO_EVENT_URING_WAIT_MANY_TAG ((uintptr_t)5)
+
+struct io_wait_many;
+
+struct io_wait_many_entry {
+	struct io_wait_many *waiter;
+	
+	VALUE io;
 	int descriptor;
-	char *buffer;
-	size_t length;
+	int events;
+	short flags;
+	
+	int completed;
 };
 
-static VALUE
-io_read_submit(VALUE _arguments)
-{
-	struct io_read_arguments *arguments = (struct io_read_arguments *)_arguments;
-	struct IO_Event_Selector_URing *data = arguments->data;
-	struct io_uring_sqe *sqe = io_get_sqe(data);
+struct io_wait_many {
+	VALUE fiber;
 	
-	if (DEBUG) fprintf(stderr, "io_read_submit:io_uring_prep_read(fiber=%p, descriptor=%d, buffer=%p, length=%ld)\n", (void*)arguments->fiber, arguments->descriptor, arguments->buffer, arguments->length);
+	// The number of submitted operations which have not completed yet:
+	size_t pending;
 	
-	io_uring_prep_read(sqe, arguments->descriptor, arguments->buffer, arguments->length, io_seekable(arguments->descriptor));
-	io_uring_sqe_set_data(sqe, (void*)arguments->fiber);
-	io_uring_submit_now(data);
+	// Whether the fiber stopped waiting, in which case the final completion frees the waiter:
+	int abandoned;
 	
-	return IO_Event_Selector_fiber_transfer(data->backend.loop, 0, NULL);
-}
-
-static VALUE
-io_read_cancel(VALUE _arguments, VALUE exception)
-{
-	struct io_read_arguments *arguments = (struct io_read_arguments *)_arguments;
-	struct IO_Event_Selector_URing *data = arguments->data;
+	// The entry which completed first (or the timeout entry if the deadline expired), and its result:
+	struct io_wait_many_entry *ready;
+	int result;
 	
-	struct io_uring_sqe *sqe = io_get_sqe(data);
+	// The deadline must remain valid until the timeout is submitted, and completes with its own entry:
+	struct __kernel_timespec deadline;
+	struct io_wait_many_entry timeout;
 	
-	if (DEBUG) fprintf(stderr, "io_read_cancel:io_uring_prep_cancel(fiber=%p)\n", (void*)arguments->fiber);
+	size_t count;
+	struct io_wait_many_entry entries[];
+};
+
+static
+void io_wait_many_complete(struct io_wait_many_entry *entry, int result) {
+	struct io_wait_many *waiter = entry->waiter;
 	
-	io_uring_prep_cancel(sqe, (void*)arguments->fiber, 0);
-	io_uring_sqe_set_data(sqe, NULL);
-	io_uring_submit_now(data);
+	entry->completed = 1;
+	waiter->pending -= 1;
 	
-	rb_exc_raise(exception);
+	// The operations which lose the race are cancelled, and their completions are ignored:
+	if (!waiter->ready && !waiter->abandoned && result != -ECANCELED) {
+		waiter->ready = entry;
+		waiter->result = result;
+		
+		// The waiter may be freed by the fiber, so it must not be used after this:
+		IO_Event_Selector_fiber_transfer(waiter->fiber, 0, NULL);
+	} else if (waiter->pending == 0 && waiter->abandoned) {
+		free(waiter);
+	}
 }
 
-static int
-io_read(struct IO_Event_Selector_URing *data, VALUE fiber, int descriptor, char *buffer, size_t length)
-{
-	struct io_read_arguments io_read_arguments = {
-		.data = data,
-		.fiber = fiber,
-		.descriptor = descriptor,
-		.buffer = buffer,
-		.length = length
-	};
-	
-	int result = RB_NUM2INT(
-		rb_rescue(io_read_submit, (VALUE)&io_read_arguments, io_read_cancel, (VALUE)&io_read_arguments)
-	);
+struct io_wait_many_arguments {
+	struct IO_Event_Selector_URing *data;
 	
-	if (DEBUG) fprintf(stderr, "io_read:IO_Event_Selector_fiber_transfer -> %d\n", result);
+	VALUE pairs;
+	size_t count;
 	
-	return result;
-}
+	struct io_wait_many *waiter;
+};
 
-VALUE IO_Event_Selector_URing_io_read(VALUE self, VALUE fiber, VALUE io, VALUE buffer, VALUE _length, VALUE _offset) {
-	struct IO_Event_Selector_URing *data = NULL;
+static
+VALUE io_wait_many_transfer(VALUE _arguments) {
+	struct io_wait_many_arguments *arguments = (struct io_wait_many_arguments *)_arguments;
+	struct IO_Event_Selector_URing *data = arguments->data;
+	struct io_wait_many *waiter = arguments->waiter;
+	
+	for (size_t i = 0; i < arguments->count; i += 1) {
+		VALUE pair = RARRAY_AREF(arguments->pairs, i);
+		Check_Type(pair, T_ARRAY);
+		
+		struct io_wait_many_entry *entry = &waiter->entries[i];
+		entry->io = rb_ary_entry(pair, 0);
+		entry->descriptor = IO_Event_Selector_io_descriptor(entry->io);
+		entry->events = NUM2INT(rb_ary_entry(pair, 1));
+		entry->flags = poll_flags_from_events(entry->events);
+	}
+	
+	// All the operations are submitted together, once the arguments have been validated:
+	for (size_t i = 0; i < arguments->count; i += 1) {
+		struct io_wait_many_entry *entry = &waiter->entries[i];
+		struct io_uring_sqe *sqe = io_get_sqe(data);
+		
+		io_uring_prep_poll_add(sqe, entry->descriptor, entry->flags);
+		io_uring_sqe_set_data(sqe, (void*)((uintptr_t)entry | IO_EVENT_URING_WAIT_MANY_TAG));
+		
+		entry->completed = 0;
+		waiter->pending += 1;
+	}
+	
+	if (waiter->timeout.waiter) {
+		struct io_uring_sqe *sqe = io_get_sqe(data);
+		
+		io_uring_prep_timeout(sqe, &waiter->deadline, 0, IORING_TIMEOUT_ABS);
+		io_uring_sqe_set_data(sqe, (void*)((uintptr_t)&waiter->timeout | IO_EVENT_URING_WAIT_MANY_TAG));
+		
+		waiter->timeout.completed = 0;
+		waiter->pending += 1;
+	}
+	
+	io_uring_submit_pending(data);
+	
+	IO_Event_Selector_fiber_transfer(data->backend.loop, 0, NULL);
+	
+	// The fiber might be resumed before any operation completes if it's being cancelled:
+	if (!waiter->ready || waiter->ready == &waiter->timeout) {
+		return Qfalse;
+	}
+	
+	struct io_wait_many_entry *entry = waiter->ready;
+	
+	// See `io_wait` regarding the filtering of the resulting events:
+	short flags = entry->flags & waiter->result;
+	
+	return rb_ary_new_from_args(2, entry->io, INT2NUM(events_from_poll_flags(flags, entry->events)));
+}
+
+static
+VALUE io_wait_many_ensure(VALUE _arguments) {
+	struct io_wait_many_arguments *arguments = (struct io_wait_many_arguments *)_arguments;
+	struct io_wait_many *waiter = arguments->waiter;
+	
+	if (waiter->pending == 0) {
+		free(waiter);
+		return Qnil;
+	}
+	
+	// Cancel all the operations which lost (or were interrupted) together, and let the final completion free the waiter:
+	waiter->abandoned = 1;
+	
+	for (size_t i = 0; i < waiter->count; i += 1) {
+		struct io_wait_many_entry *entry = &waiter->entries[i];
+		
+		if (!entry->completed) {
+			struct io_uring_sqe *sqe = io_get_sqe(arguments->data);
+			io_uring_prep_cancel(sqe, (void*)((uintptr_t)entry | IO_EVENT_URING_WAIT_MANY_TAG), 0);
+			io_uring_sqe_set_data(sqe, NULL);
+		}
+	}
+	
+	if (!waiter->timeout.completed) {
+		struct io_uring_sqe *sqe = io_get_sqe(arguments->data);
+		io_uring_prep_timeout_remove(sqe, (uintptr_t)&waiter->timeout | IO_EVENT_URING_WAIT_MANY_TAG, 0);
+		io_uring_sqe_set_data(sqe, NULL);
+	}
+	
+	io_uring_submit_now(arguments->data);
+	
+	return Qnil;
+}
+
+// Wait for the first of several `[io, events]` pairs to become ready, returning `[io, events]` for it, or false if the timeout (in seconds) expires first. A poll operation is submitted for each descriptor, and the ones which don't complete first are cancelled together.
+VALUE IO_Event_Selector_URing_io_wait_many(int argc, VALUE *argv, VALUE self) {
+	struct IO_Event_Selector_URing *data = NULL;
+	TypedData_Get_Struct(self, struct IO_Event_Selector_URing, &IO_Event_Selector_URing_Type, data);
+	
+	rb_check_arity(argc, 2, 3);
+	
+	VALUE fiber = argv[0], pairs = argv[1];
+	Check_Type(pairs, T_ARRAY);
+	
+	// Nothing could ever wake us up:
+	if (RARRAY_LEN(pairs) == 0) {
+		rb_raise(rb_eArgError, "No IOs to wait for!");
+	}
+	
+	struct io_wait_many_arguments io_wait_many_arguments = {
+		.data = data,
+		.pairs = pairs,
+		.count = RARRAY_LEN(pairs),
+	};
+	
+	struct __kernel_timespec storage;
+	struct __kernel_timespec *deadline = io_deadline(argc == 3 ? argv[2] : Qnil, &storage);
+	
+	struct io_wait_many *waiter = calloc(1, sizeof(struct io_wait_many) + io_wait_many_arguments.count * sizeof(struct io_wait_many_entry));
+	if (waiter == NULL) rb_sys_fail("IO_Event_Selector_URing_io_wait_many:calloc");
+	
+	waiter->fiber = fiber;
+	waiter->count = io_wait_many_arguments.count;
+	waiter->timeout.completed = 1;
+	
+	for (size_t i = 0; i < waiter->count; i += 1) {
+		waiter->entries[i].waiter = waiter;
+		waiter->entries[i].completed = 1;
+	}
+	
+	if (deadline) {
+		waiter->deadline = *deadline;
+		waiter->timeout.waiter = waiter;
+	}
+	
+	io_wait_many_arguments.waiter = waiter;
+	
+	return rb_ensure(io_wait_many_transfer, (VALUE)&io_wait_many_arguments, io_wait_many_ensure, (VALUE)&io_wait_many_arguments);
+}
+
+#pragma mark - IO.select
+
+struct io_select_arguments {
+	struct IO_Event_Selector_URing *data;
+	VALUE fiber;
+	
+	struct IO_Event_Selector_IO_Select select;
+	
+	// All the descriptors are registered with an epoll instance, which becomes readable when any of them are ready, so that a single poll operation can wait for all of them:
+	int descriptor;
+	
+	VALUE timeout;
+	struct __kernel_timespec *deadline;
+};
+
+static
+VALUE io_select_loop(VALUE _arguments) {
+	struct io_select_arguments *arguments = (struct io_select_arguments *)_arguments;
+	
+	VALUE ready = IO_Event_Selector_IO_Select_ready(&arguments->select);
+	if (!NIL_P(ready)) return ready;
+	
+	if (!NIL_P(arguments->timeout) && NUM2DBL(arguments->timeout) <= 0) {
+		return Qnil;
+	}
+	
+	arguments->descriptor = IO_Event_Selector_IO_Select_epoll(&arguments->select);
+	
+	while (true) {
+		VALUE events = io_wait_descriptor(arguments->data, arguments->fiber, arguments->descriptor, IO_EVENT_READABLE, arguments->deadline);
+		
+		if (!RTEST(events)) return Qnil;
+		
+		// Another fiber may have consumed the readiness before we were resumed:
+		ready = IO_Event_Selector_IO_Select_ready(&arguments->select);
+		if (!NIL_P(ready)) return ready;
+	}
+}
+
+static
+VALUE io_select_ensure(VALUE _arguments) {
+	struct io_select_arguments *arguments = (struct io_select_arguments *)_arguments;
+	
+	if (arguments->descriptor >= 0) {
+		close(arguments->descriptor);
+	}
+	
+	IO_Event_Selector_IO_Select_free(&arguments->select);
+	
+	return Qnil;
+}
+
+// Wait until any of the given IOs are ready, or the timeout (in seconds, or nil to wait indefinitely) expires, returning `[readable, writable, priority]` like `IO.select`, or nil if the timeout expired.
+VALUE IO_Event_Selector_URing_io_select(VALUE self, VALUE readable, VALUE writable, VALUE priority, VALUE timeout) {
+	struct IO_Event_Selector_URing *data = NULL;
+	TypedData_Get_Struct(self, struct IO_Event_Selector_URing, &IO_Event_Selector_URing_Type, data);
+	
+	struct __kernel_timespec storage;
+	
+	struct io_select_arguments io_select_arguments = {
+		.data = data,
+		.fiber = IO_Event_Selector_fiber_current(),
+		.descriptor = -1,
+		.timeout = timeout,
+		.deadline = io_deadline(timeout, &storage),
+	};
+	
+	IO_Event_Selector_IO_Select_initialize(&io_select_arguments.select, readable, writable, priority);
+	
+	return rb_ensure(io_select_loop, (VALUE)&io_select_arguments, io_select_ensure, (VALUE)&io_select_arguments);
+}
+
+#pragma mark - IO#accept
+
+// Multishot accept completions are tagged, as they refer to the state of the listening descriptor rather than a fiber:
+#define IO_EVENT_URING_ACCEPT_TAG ((uintptr_t)2)
+
+struct io_accept_waiter {
+	struct io_accept_waiter *next;
+	VALUE fiber;
+};
+
+struct io_accept_state {
+	int descriptor;
+	
+	// Whether a multishot accept is currently submitted for this descriptor:
+	int active;
+	
+	// Whether the descriptor was closed, in which case the state is freed once nothing refers to it:
+	int closed;
+	
+	// The first error reported by the multishot accept, if any:
+	int error;
+	
+	// Connections which were accepted but not yet returned:
+	int *queue;
+	size_t head, count, capacity;
+	
+	// Fibers waiting for a connection, in order:
+	struct io_accept_waiter *waiting;
+};
+
+static
+void io_accept_release(struct io_accept_state *state) {
+	if (state->closed && !state->active && state->waiting == NULL) {
+		for (size_t index = state->head; index < state->count; index += 1) {
+			close(state->queue[index]);
+		}
+		
+		free(state->queue);
+		free(state);
+	}
+}
+
+static
+int io_accept_free_entry(st_data_t key, st_data_t value, st_data_t argument) {
+	struct io_accept_state *state = (struct io_accept_state *)value;
+	
+	// The ring has already been closed, so there are no outstanding completions:
+	state->closed = 1;
+	state->active = 0;
+	state->waiting = NULL;
+	
+	io_accept_release(state);
+	
+	return ST_DELETE;
+}
+
+static
+void io_accept_free_all(st_table **accepts) {
+	if (*accepts) {
+		st_foreach(*accepts, io_accept_free_entry, 0);
+		st_free_table(*accepts);
+		*accepts = NULL;
+	}
+}
+
+static
+void io_accept_resume(struct io_accept_state *state) {
+	struct io_accept_waiter *waiter = state->waiting;
+	
+	if (waiter) {
+		state->waiting = waiter->next;
+		waiter->next = NULL;
+		
+		IO_Event_Selector_fiber_transfer(waiter->fiber, 0, NULL);
+	}
+}
+
+// Handle a completion of the multishot accept.
+static
+void io_accept_complete(struct io_accept_state *state, int result, unsigned flags) {
+	if (!(flags & IORING_CQE_F_MORE)) {
+		state->active = 0;
+	}
+	
+	if (result >= 0) {
+		if (state->closed) {
+			close(result);
+		} else {
+			if (state->count == state->capacity) {
+				state->capacity = state->capacity ? state->capacity * 2 : 16;
+				state->queue = realloc(state->queue, state->capacity * sizeof(int));
+			}
+			
+			state->queue[state->count++] = result;
+		}
+	} else if (result != -ECANCELED && !state->error) {
+		state->error = -result;
+	}
+	
+	if (state->closed) {
+		io_accept_release(state);
+	} else if (state->active) {
+		io_accept_resume(state);
+	} else {
+		// The multishot accept has finished, so every waiting fiber must check whether it needs to be submitted again:
+		while (state->waiting) {
+			io_accept_resume(state);
+		}
+	}
+}
+
+struct io_accept_arguments {
+	struct io_accept_state *state;
+	struct io_accept_waiter *waiter;
+	VALUE loop;
+	int finished;
+};
+
+static
+VALUE io_accept_transfer(VALUE _arguments) {
+	struct io_accept_arguments *arguments = (struct io_accept_arguments *)_arguments;
+	
+	IO_Event_Selector_fiber_transfer(arguments->loop, 0, NULL);
+	
+	arguments->finished = 1;
+	
+	return Qnil;
+}
+
+static
+VALUE io_accept_ensure(VALUE _arguments) {
+	struct io_accept_arguments *arguments = (struct io_accept_arguments *)_arguments;
+	struct io_accept_state *state = arguments->state;
+	
+	// If we were resumed normally, we were already removed from the list:
+	struct io_accept_waiter **waiter = &state->waiting;
+	while (*waiter) {
+		if (*waiter == arguments->waiter) {
+			*waiter = arguments->waiter->next;
+			break;
+		}
+		
+		waiter = &(*waiter)->next;
+	}
+	
+	if (!arguments->finished) {
+		io_accept_release(state);
+	}
+	
+	return Qnil;
+}
+
+// Accept a connection from the given server, returning a `Socket`. A single multishot accept is kept submitted for each server, and connections it accepts ahead of time are returned by subsequent calls.
+VALUE IO_Event_Selector_URing_io_accept(VALUE self, VALUE fiber, VALUE server) {
+	struct IO_Event_Selector_URing *data = NULL;
+	TypedData_Get_Struct(self, struct IO_Event_Selector_URing, &IO_Event_Selector_URing_Type, data);
+	
+	int descriptor = IO_Event_Selector_io_descriptor(server);
+	
+	if (data->accepts == NULL) {
+		data->accepts = st_init_numtable();
+	}
+	
+	struct io_accept_state *state = NULL;
+	
+	if (!st_lookup(data->accepts, (st_data_t)descriptor, (st_data_t*)&state)) {
+		state = calloc(1, sizeof(struct io_accept_state));
+		if (state == NULL) rb_sys_fail("IO_Event_Selector_URing_io_accept:calloc");
+		
+		state->descriptor = descriptor;
+		st_insert(data->accepts, (st_data_t)descriptor, (st_data_t)state);
+	}
+	
+	while (true) {
+		if (state->closed) {
+			io_accept_release(state);
+			rb_raise(rb_eIOError, "closed stream");
+		}
+		
+		if (state->head < state->count) {
+			int result = state->queue[state->head++];
+			
+			if (state->head == state->count) {
+				state->head = state->count = 0;
+			}
+			
+			return IO_Event_Selector_socket_for_fd(result);
+		}
+		
+		if (state->error) {
+			int error = state->error;
+			state->error = 0;
+			
+			rb_syserr_fail(error, "IO_Event_Selector_URing_io_accept:io_uring_prep_multishot_accept");
+		}
+		
+		if (!state->active) {
+			struct io_uring_sqe *sqe = io_get_sqe(data);
+			
+			io_uring_prep_multishot_accept(sqe, descriptor, NULL, NULL, SOCK_NONBLOCK|SOCK_CLOEXEC);
+			io_uring_sqe_set_data(sqe, (void*)((uintptr_t)state | IO_EVENT_URING_ACCEPT_TAG));
+			io_uring_submit_pending(data);
+			
+			state->active = 1;
+		}
+		
+		struct io_accept_waiter waiter = {.fiber = fiber};
+		
+		struct io_accept_waiter **tail = &state->waiting;
+		while (*tail) tail = &(*tail)->next;
+		*tail = &waiter;
+		
+		struct io_accept_arguments arguments = {
+			.state = state,
+			.waiter = &waiter,
+			.loop = data->backend.loop,
+		};
+		
+		rb_ensure(io_accept_transfer, (VALUE)&arguments, io_accept_ensure, (VALUE)&arguments);
+	}
+}
+
+// Stop accepting connections for the given descriptor, as it is being closed.
+static
+void io_accept_close(struct IO_Event_Selector_URing *data, int descriptor) {
+	struct io_accept_state *state = NULL;
+	st_data_t key = (st_data_t)descriptor;
+	
+	if (data->accepts == NULL || !st_delete(data->accepts, &key, (st_data_t*)&state)) {
+		return;
+	}
+	
+	state->closed = 1;
+	
+	if (state->active) {
+		struct io_uring_sqe *sqe = io_get_sqe(data);
+		
+		io_uring_prep_cancel(sqe, (void*)((uintptr_t)state | IO_EVENT_URING_ACCEPT_TAG), 0);
+		io_uring_sqe_set_data(sqe, NULL);
+		io_uring_submit_now(data);
+	}
+	
+	// Waiting fibers will notice the descriptor was closed:
+	for (struct io_accept_waiter *waiter = state->waiting; waiter; waiter = waiter->next) {
+		IO_Event_Selector_queue_push(&data->backend, waiter->fiber);
+	}
+	
+	state->waiting = NULL;
+	
+	io_accept_release(state);
+}
+
+#ifdef HAVE_RUBY_IO_BUFFER_H
+
+#pragma mark - IO#read
+
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(5,16,0)
+static inline off_t io_seekable(int descriptor) {
+	return -1;
+}
+#else
+#warning Upgrade your kernel to 5.16! io_uring bugs prevent efficient io_read/io_write hooks.
+static inline off_t io_seekable(int descriptor)
+{
+	if (lseek(descriptor, 0, SEEK_CUR) == -1) {
+		return 0;
+	} else {
+		return -1;
+	}
+}
+#endif
+
+#pragma mark - IO#read
+
+struct io_read_arguments {
+	struct IO_Event_Selector_URing *data;
+	VALUE fiber;
+	int descriptor;
+	char *buffer;
+	size_t length;
+	
+	// The position in the file to read from, or -1 to use the current file position:
+	off_t from;
+	
+	struct __kernel_timespec *deadline;
+	
+	struct io_operation *operation;
+};
+
+static VALUE
+io_read_submit(VALUE _arguments)
+{
+	struct io_read_arguments *arguments = (struct io_read_arguments *)_arguments;
+	struct IO_Event_Selector_URing *data = arguments->data;
+	struct io_uring_sqe *sqe = io_get_sqe_with_deadline(data, arguments->deadline);
+	
+	if (DEBUG) fprintf(stderr, "io_read_submit:io_uring_prep_read(fiber=%p, descriptor=%d, buffer=%p, length=%ld)\n", (void*)arguments->fiber, arguments->descriptor, arguments->buffer, arguments->length);
+	
+	io_uring_prep_read(sqe, arguments->descriptor, arguments->buffer, arguments->length, arguments->from);
+	io_operation_prepare(arguments->operation, sqe);
+	io_link_timeout(data, arguments->operation, sqe, arguments->deadline);
+	io_uring_submit_now(data);
+	
+	return io_operation_transfer(data, arguments->operation, arguments->descriptor);
+}
+
+static VALUE
+io_read_ensure(VALUE _arguments)
+{
+	struct io_read_arguments *arguments = (struct io_read_arguments *)_arguments;
+	
+	io_operation_release(arguments->data, arguments->operation);
+	
+	return Qnil;
+}
+
+static int
+io_read(struct IO_Event_Selector_URing *data, VALUE fiber, int descriptor, char *buffer, size_t length, off_t from, struct __kernel_timespec *deadline)
+{
+	struct io_read_arguments io_read_arguments = {
+		.data = data,
+		.fiber = fiber,
+		.descriptor = descriptor,
+		.buffer = buffer,
+		.length = length,
+		.from = from,
+		.deadline = deadline,
+		.operation = io_operation_new(fiber),
+	};
+	
+	int result = RB_NUM2INT(
+		rb_ensure(io_read_submit, (VALUE)&io_read_arguments, io_read_ensure, (VALUE)&io_read_arguments)
+	);
+	
+	if (DEBUG) fprintf(stderr, "io_read:IO_Event_Selector_fiber_transfer -> %d\n", result);
+	
+	return result;
+}
+
+static
+VALUE io_read_deadline(VALUE self, VALUE fiber, VALUE io, VALUE buffer, VALUE _length, VALUE _offset, struct __kernel_timespec *deadline) {
+	struct IO_Event_Selector_URing *data = NULL;
+	TypedData_Get_Struct(self, struct IO_Event_Selector_URing, &IO_Event_Selector_URing_Type, data);
+	
+	int descriptor = IO_Event_Selector_io_descriptor(io);
+	
+	void *base;
+	size_t size;
+	rb_io_buffer_get_bytes_for_writing(buffer, &base, &size);
+	
+	size_t length = NUM2SIZET(_length);
+	size_t offset = NUM2SIZET(_offset);
+	
+	off_t from = io_seekable(descriptor);
+	size_t start = offset;
+	
+	while (true) {
+		size_t maximum_size = size - offset;
+		if (DEBUG_IO_READ) fprintf(stderr, "io_read(%d, +%ld, %ld)\n", descriptor, offset, maximum_size);
+		int result = io_read(data, fiber, descriptor, (char*)base+offset, maximum_size, from, deadline);
+		if (DEBUG_IO_READ) fprintf(stderr, "io_read(%d, +%ld, %ld) -> %d\n", descriptor, offset, maximum_size, result);
+		
+		if (result > 0) {
+			offset += result;
+			if ((size_t)result >= length) break;
+			length -= result;
+		} else if (result == 0) {
+			break;
+		} else if (length > 0 && IO_Event_try_again(-result)) {
+			if (!RTEST(io_wait(self, fiber, io, RB_INT2NUM(IO_EVENT_READABLE), deadline))) {
+				if (offset > start) break;
+				return rb_fiber_scheduler_io_result(-1, ETIMEDOUT);
+			}
+		} else if (result == -ETIME) {
+			// The deadline expired, so return whatever we managed to read:
+			if (offset > start) break;
+			return rb_fiber_scheduler_io_result(-1, ETIMEDOUT);
+		} else {
+			return rb_fiber_scheduler_io_result(-1, -result);
+		}
+	}
+	
+	return rb_fiber_scheduler_io_result(offset, 0);
+}
+
+VALUE IO_Event_Selector_URing_io_read(VALUE self, VALUE fiber, VALUE io, VALUE buffer, VALUE _length, VALUE _offset) {
+	return io_read_deadline(self, fiber, io, buffer, _length, _offset, NULL);
+}
+
+// If a timeout (in seconds) is given and nothing could be read before it expires, returns -ETIMEDOUT.
+static VALUE IO_Event_Selector_URing_io_read_compatible(int argc, VALUE *argv, VALUE self)
+{
+	rb_check_arity(argc, 4, 6);
+	
+	VALUE _offset = SIZET2NUM(0);
+	
+	if (argc >= 5) {
+		_offset = argv[4];
+	}
+	
+	struct __kernel_timespec storage;
+	struct __kernel_timespec *deadline = io_deadline(argc == 6 ? argv[5] : Qnil, &storage);
+	
+	return io_read_deadline(self, argv[0], argv[1], argv[2], argv[3], _offset, deadline);
+}
+
+// Positioned reads don't depend on (or modify) the file position, so concurrent fibers can read different parts of the same file in parallel.
+VALUE IO_Event_Selector_URing_io_pread(VALUE self, VALUE fiber, VALUE io, VALUE buffer, VALUE _from, VALUE _length, VALUE _offset) {
+	struct IO_Event_Selector_URing *data = NULL;
+	TypedData_Get_Struct(self, struct IO_Event_Selector_URing, &IO_Event_Selector_URing_Type, data);
+	
+	int descriptor = IO_Event_Selector_io_descriptor(io);
+	
+	void *base;
+	size_t size;
+	rb_io_buffer_get_bytes_for_writing(buffer, &base, &size);
+	
+	off_t from = NUM2OFFT(_from);
+	size_t length = NUM2SIZET(_length);
+	size_t offset = NUM2SIZET(_offset);
+	
+	while (true) {
+		size_t maximum_size = size - offset;
+		int result = io_read(data, fiber, descriptor, (char*)base+offset, maximum_size, from, NULL);
+		
+		if (result > 0) {
+			from += result;
+			offset += result;
+			if ((size_t)result >= length) break;
+			length -= result;
+		} else if (result == 0) {
+			break;
+		} else {
+			return rb_fiber_scheduler_io_result(-1, -result);
+		}
+	}
+	
+	return rb_fiber_scheduler_io_result(offset, 0);
+}
+
+// Read into the buffer (after the `offset` bytes it already holds) until it contains the delimiter, returning `[index, length]`. The index is nil if the stream ended, or `maximum` bytes were read, first. Each search only covers the newly read bytes.
+static VALUE IO_Event_Selector_URing_io_read_until(int argc, VALUE *argv, VALUE self) {
+	rb_check_arity(argc, 5, 6);
+	
+	struct IO_Event_Selector_URing *data = NULL;
+	TypedData_Get_Struct(self, struct IO_Event_Selector_URing, &IO_Event_Selector_URing_Type, data);
+	
+	VALUE fiber = argv[0], io = argv[1], buffer = argv[2];
+	
+	VALUE delimiter = rb_str_new_frozen(StringValue(argv[3]));
+	if (RSTRING_LEN(delimiter) == 0) {
+		rb_raise(rb_eArgError, "Delimiter must not be empty!");
+	}
+	
+	size_t maximum = NUM2SIZET(argv[4]);
+	size_t offset = argc == 6 ? NUM2SIZET(argv[5]) : 0;
+	
+	int descriptor = IO_Event_Selector_io_descriptor(io);
+	off_t from = io_seekable(descriptor);
+	size_t searched = 0;
+	
+	while (true) {
+		// The buffer may have been resized while we were waiting:
+		void *base;
+		size_t size;
+		rb_io_buffer_get_bytes_for_writing(buffer, &base, &size);
+		
+		size_t limit = maximum < size ? maximum : size;
+		if (offset > size) offset = size;
+		
+		ssize_t index = IO_Event_Selector_search(base, offset, &searched, RSTRING_PTR(delimiter), RSTRING_LEN(delimiter));
+		
+		if (index >= 0) {
+			RB_GC_GUARD(delimiter);
+			return rb_ary_new_from_args(2, SSIZET2NUM(index), SIZET2NUM(offset));
+		} else if (offset >= limit) {
+			break;
+		}
+		
+		int result = io_read(data, fiber, descriptor, (char*)base+offset, limit - offset, from, NULL);
+		
+		if (result > 0) {
+			offset += result;
+		} else if (result == 0) {
+			break;
+		} else if (IO_Event_try_again(-result)) {
+			io_wait(self, fiber, io, RB_INT2NUM(IO_EVENT_READABLE), NULL);
+		} else {
+			rb_syserr_fail(-result, "IO_Event_Selector_URing_io_read_until:read");
+		}
+	}
+	
+	RB_GC_GUARD(delimiter);
+	
+	// The end of the stream, or the maximum size, was reached without finding the delimiter:
+	return rb_ary_new_from_args(2, Qnil, SIZET2NUM(offset));
+}
+
+#pragma mark - IO#write
+
+struct io_write_arguments {
+	struct IO_Event_Selector_URing *data;
+	VALUE fiber;
+	int descriptor;
+	char *buffer;
+	size_t length;
+	
+	// The position in the file to write to, or -1 to use the current file position:
+	off_t from;
+	
+	struct __kernel_timespec *deadline;
+	
+	struct io_operation *operation;
+};
+
+static VALUE
+io_write_submit(VALUE _argument)
+{
+	struct io_write_arguments *arguments = (struct io_write_arguments*)_argument;
+	struct IO_Event_Selector_URing *data = arguments->data;
+	
+	struct io_uring_sqe *sqe = io_get_sqe_with_deadline(data, arguments->deadline);
+	
+	if (DEBUG) fprintf(stderr, "io_write_submit:io_uring_prep_write(fiber=%p, descriptor=%d, buffer=%p, length=%ld)\n", (void*)arguments->fiber, arguments->descriptor, arguments->buffer, arguments->length);
+	
+	io_uring_prep_write(sqe, arguments->descriptor, arguments->buffer, arguments->length, arguments->from);
+	io_operation_prepare(arguments->operation, sqe);
+	io_link_timeout(data, arguments->operation, sqe, arguments->deadline);
+	io_uring_submit_pending(data);
+	
+	return io_operation_transfer(data, arguments->operation, arguments->descriptor);
+}
+
+static VALUE
+io_write_ensure(VALUE _argument)
+{
+	struct io_write_arguments *arguments = (struct io_write_arguments*)_argument;
+	
+	io_operation_release(arguments->data, arguments->operation);
+	
+	return Qnil;
+}
+
+static int
+io_write(struct IO_Event_Selector_URing *data, VALUE fiber, int descriptor, char *buffer, size_t length, off_t from, struct __kernel_timespec *deadline)
+{
+	struct io_write_arguments arguments = {
+		.data = data,
+		.fiber = fiber,
+		.descriptor = descriptor,
+		.buffer = buffer,
+		.length = length,
+		.from = from,
+		.deadline = deadline,
+		.operation = io_operation_new(fiber),
+	};
+	
+	int result = RB_NUM2INT(
+		rb_ensure(io_write_submit, (VALUE)&arguments, io_write_ensure, (VALUE)&arguments)
+	);
+	
+	if (DEBUG) fprintf(stderr, "io_write:IO_Event_Selector_fiber_transfer -> %d\n", result);
+	
+	return result;
+}
+
+static
+VALUE io_write_deadline(VALUE self, VALUE fiber, VALUE io, VALUE buffer, VALUE _length, VALUE _offset, struct __kernel_timespec *deadline) {
+	struct IO_Event_Selector_URing *data = NULL;
+	TypedData_Get_Struct(self, struct IO_Event_Selector_URing, &IO_Event_Selector_URing_Type, data);
+	
+	int descriptor = IO_Event_Selector_io_descriptor(io);
+	
+	const void *base;
+	size_t size;
+	rb_io_buffer_get_bytes_for_reading(buffer, &base, &size);
+	
+	size_t length = NUM2SIZET(_length);
+	size_t offset = NUM2SIZET(_offset);
+	
+	if (length > size) {
+		rb_raise(rb_eRuntimeError, "Length exceeds size of buffer!");
+	}
+	
+	off_t from = io_seekable(descriptor);
+	size_t start = offset;
+	
+	while (true) {
+		size_t maximum_size = size - offset;
+		int result = io_write(data, fiber, descriptor, (char*)base+offset, maximum_size, from, deadline);
+		
+		if (result > 0) {
+			offset += result;
+			if ((size_t)result >= length) break;
+			length -= result;
+		} else if (result == 0) {
+			break;
+		} else if (length > 0 && IO_Event_try_again(-result)) {
+			if (!RTEST(io_wait(self, fiber, io, RB_INT2NUM(IO_EVENT_WRITABLE), deadline))) {
+				if (offset > start) break;
+				return rb_fiber_scheduler_io_result(-1, ETIMEDOUT);
+			}
+		} else if (result == -ETIME) {
+			// The deadline expired, so return whatever we managed to write:
+			if (offset > start) break;
+			return rb_fiber_scheduler_io_result(-1, ETIMEDOUT);
+		} else {
+			return rb_fiber_scheduler_io_result(-1, -result);
+		}
+	}
+	
+	return rb_fiber_scheduler_io_result(offset, 0);
+}
+
+VALUE IO_Event_Selector_URing_io_write(VALUE self, VALUE fiber, VALUE io, VALUE buffer, VALUE _length, VALUE _offset) {
+	return io_write_deadline(self, fiber, io, buffer, _length, _offset, NULL);
+}
+
+// If a timeout (in seconds) is given and nothing could be written before it expires, returns -ETIMEDOUT.
+static VALUE IO_Event_Selector_URing_io_write_compatible(int argc, VALUE *argv, VALUE self)
+{
+	rb_check_arity(argc, 4, 6);
+	
+	VALUE _offset = SIZET2NUM(0);
+	
+	if (argc >= 5) {
+		_offset = argv[4];
+	}
+	
+	struct __kernel_timespec storage;
+	struct __kernel_timespec *deadline = io_deadline(argc == 6 ? argv[5] : Qnil, &storage);
+	
+	return io_write_deadline(self, argv[0], argv[1], argv[2], argv[3], _offset, deadline);
+}
+
+VALUE IO_Event_Selector_URing_io_pwrite(VALUE self, VALUE fiber, VALUE io, VALUE buffer, VALUE _from, VALUE _length, VALUE _offset) {
+	struct IO_Event_Selector_URing *data = NULL;
+	TypedData_Get_Struct(self, struct IO_Event_Selector_URing, &IO_Event_Selector_URing_Type, data);
+	
+	int descriptor = IO_Event_Selector_io_descriptor(io);
+	
+	const void *base;
+	size_t size;
+	rb_io_buffer_get_bytes_for_reading(buffer, &base, &size);
+	
+	off_t from = NUM2OFFT(_from);
+	size_t length = NUM2SIZET(_length);
+	size_t offset = NUM2SIZET(_offset);
+	
+	if (length > size) {
+		rb_raise(rb_eRuntimeError, "Length exceeds size of buffer!");
+	}
+	
+	while (true) {
+		size_t maximum_size = size - offset;
+		int result = io_write(data, fiber, descriptor, (char*)base+offset, maximum_size, from, NULL);
+		
+		if (result > 0) {
+			from += result;
+			offset += result;
+			if ((size_t)result >= length) break;
+			length -= result;
+		} else if (result == 0) {
+			break;
+		} else {
+			return rb_fiber_scheduler_io_result(-1, -result);
+		}
+	}
+	
+	return rb_fiber_scheduler_io_result(offset, 0);
+}
+
+#pragma mark - IO#readv/IO#writev
+
+struct io_vector_arguments {
+	struct IO_Event_Selector_URing *data;
+	VALUE fiber;
+	int descriptor;
+	int writing;
+	
+	const struct iovec *iovecs;
+	int count;
+	off_t from;
+	
+	struct io_operation *operation;
+};
+
+static VALUE
+io_vector_submit(VALUE _arguments)
+{
+	struct io_vector_arguments *arguments = (struct io_vector_arguments *)_arguments;
+	struct IO_Event_Selector_URing *data = arguments->data;
+	struct io_uring_sqe *sqe = io_get_sqe(data);
+	
+	if (DEBUG) fprintf(stderr, "io_vector_submit:io_uring_prep_%s(fiber=%p, descriptor=%d, count=%d)\n", arguments->writing ? "writev" : "readv", (void*)arguments->fiber, arguments->descriptor, arguments->count);
+	
+	if (arguments->writing) {
+		io_uring_prep_writev(sqe, arguments->descriptor, arguments->iovecs, arguments->count, arguments->from);
+	} else {
+		io_uring_prep_readv(sqe, arguments->descriptor, arguments->iovecs, arguments->count, arguments->from);
+	}
+	
+	io_operation_prepare(arguments->operation, sqe);
+	
+	// The iovecs are only guaranteed to be valid until this function returns, so they must be submitted immediately:
+	io_uring_submit_now(data);
+	
+	return io_operation_transfer(data, arguments->operation, arguments->descriptor);
+}
+
+static VALUE
+io_vector_ensure(VALUE _arguments)
+{
+	struct io_vector_arguments *arguments = (struct io_vector_arguments *)_arguments;
+	
+	io_operation_release(arguments->data, arguments->operation);
+	
+	return Qnil;
+}
+
+static int
+io_vector(struct IO_Event_Selector_URing *data, VALUE fiber, int descriptor, int writing, const struct iovec *iovecs, int count, off_t from)
+{
+	struct io_vector_arguments arguments = {
+		.data = data,
+		.fiber = fiber,
+		.descriptor = descriptor,
+		.writing = writing,
+		.iovecs = iovecs,
+		.count = count,
+		.from = from,
+		.operation = io_operation_new(fiber),
+	};
+	
+	return RB_NUM2INT(
+		rb_ensure(io_vector_submit, (VALUE)&arguments, io_vector_ensure, (VALUE)&arguments)
+	);
+}
+
+static VALUE
+io_vector_loop(VALUE self, VALUE fiber, VALUE io, int writing, struct iovec *iovecs, int count, size_t length)
+{
+	struct IO_Event_Selector_URing *data = NULL;
+	TypedData_Get_Struct(self, struct IO_Event_Selector_URing, &IO_Event_Selector_URing_Type, data);
+	
+	int descriptor = IO_Event_Selector_io_descriptor(io);
+	off_t from = io_seekable(descriptor);
+	size_t total = 0;
+	
+	while (count > 0) {
+		int result = io_vector(data, fiber, descriptor, writing, iovecs, IO_Event_Selector_iovecs_limit(count), from);
+		
+		if (result > 0) {
+			total += result;
+			iovecs = IO_Event_Selector_iovecs_advance(iovecs, &count, result);
+			if ((size_t)result >= length) break;
+			length -= result;
+		} else if (result == 0) {
+			break;
+		} else if (length > 0 && IO_Event_try_again(-result)) {
+			IO_Event_Selector_URing_io_wait(self, fiber, io, RB_INT2NUM(writing ? IO_EVENT_WRITABLE : IO_EVENT_READABLE));
+		} else {
+			return rb_fiber_scheduler_io_result(-1, -result);
+		}
+	}
+	
+	return rb_fiber_scheduler_io_result(total, 0);
+}
+
+// Read into several buffers with a single operation, until at least `length` bytes have been read.
+VALUE IO_Event_Selector_URing_io_readv(VALUE self, VALUE fiber, VALUE io, VALUE buffers, VALUE _length) {
+	Check_Type(buffers, T_ARRAY);
+	
+	size_t length = NUM2SIZET(_length);
+	int count = RARRAY_LENINT(buffers);
+	
+	VALUE storage;
+	struct iovec *iovecs = ALLOCV_N(struct iovec, storage, count);
+	IO_Event_Selector_iovecs_for_writing(buffers, iovecs, count);
+	
+	VALUE result = io_vector_loop(self, fiber, io, 0, iovecs, count, length);
+	
+	ALLOCV_END(storage);
+	
+	return result;
+}
+
+// Write several buffers with a single operation, until at least `length` bytes have been written.
+VALUE IO_Event_Selector_URing_io_writev(VALUE self, VALUE fiber, VALUE io, VALUE buffers, VALUE _length) {
+	Check_Type(buffers, T_ARRAY);
+	
+	size_t length = NUM2SIZET(_length);
+	int count = RARRAY_LENINT(buffers);
+	
+	VALUE storage;
+	struct iovec *iovecs = ALLOCV_N(struct iovec, storage, count);
+	size_t size = IO_Event_Selector_iovecs_for_reading(buffers, iovecs, count);
+	
+	if (length > size) {
+		ALLOCV_END(storage);
+		rb_raise(rb_eRuntimeError, "Length exceeds size of buffers!");
+	}
+	
+	VALUE result = io_vector_loop(self, fiber, io, 1, iovecs, count, length);
+	
+	ALLOCV_END(storage);
+	
+	return result;
+}
+
+#pragma mark - IO#sendfile
+
+struct io_splice_arguments {
+	struct IO_Event_Selector_URing *data;
+	VALUE fiber;
+	
+	int in;
+	int64_t in_offset;
+	int out;
+	int64_t out_offset;
+	
+	unsigned int length;
+};
+
+static VALUE
+io_splice_submit(VALUE _arguments)
+{
+	struct io_splice_arguments *arguments = (struct io_splice_arguments *)_arguments;
+	struct IO_Event_Selector_URing *data = arguments->data;
+	struct io_uring_sqe *sqe = io_get_sqe(data);
+	
+	if (DEBUG) fprintf(stderr, "io_splice_submit:io_uring_prep_splice(fiber=%p, in=%d, out=%d, length=%u)\n", (void*)arguments->fiber, arguments->in, arguments->out, arguments->length);
+	
+	io_uring_prep_splice(sqe, arguments->in, arguments->in_offset, arguments->out, arguments->out_offset, arguments->length, 0);
+	io_uring_sqe_set_data(sqe, (void*)arguments->fiber);
+	io_uring_submit_now(data);
+	
+	return IO_Event_Selector_fiber_transfer(data->backend.loop, 0, NULL);
+}
+
+static VALUE
+io_splice_cancel(VALUE _arguments, VALUE exception)
+{
+	struct io_splice_arguments *arguments = (struct io_splice_arguments *)_arguments;
+	struct IO_Event_Selector_URing *data = arguments->data;
+	
+	struct io_uring_sqe *sqe = io_get_sqe(data);
+	
+	if (DEBUG) fprintf(stderr, "io_splice_cancel:io_uring_prep_cancel(fiber=%p)\n", (void*)arguments->fiber);
+	
+	io_uring_prep_cancel(sqe, (void*)arguments->fiber, 0);
+	io_uring_sqe_set_data(sqe, NULL);
+	io_uring_submit_now(data);
+	
+	rb_exc_raise(exception);
+}
+
+// Move up to `length` bytes from `in` to `out`, one of which must be a pipe. An offset of -1 means the current position (and must be used for pipes).
+static int
+io_splice(struct IO_Event_Selector_URing *data, VALUE fiber, int in, int64_t in_offset, int out, int64_t out_offset, size_t length)
+{
+	struct io_splice_arguments arguments = {
+		.data = data,
+		.fiber = fiber,
+		.in = in,
+		.in_offset = in_offset,
+		.out = out,
+		.out_offset = out_offset,
+		.length = length > INT_MAX ? INT_MAX : length,
+	};
+	
+	return RB_NUM2INT(
+		rb_rescue(io_splice_submit, (VALUE)&arguments, io_splice_cancel, (VALUE)&arguments)
+	);
+}
+
+struct io_sendfile_arguments {
+	struct IO_Event_Selector_URing *data;
+	VALUE fiber;
+	
+	int out;
+	int in;
+	off_t offset;
+	size_t length;
+	
+	// The data is moved from the file to the output through this pipe, without copying it into user space:
+	int pipe[2];
+};
+
+static VALUE
+io_sendfile_loop(VALUE _arguments)
+{
+	struct io_sendfile_arguments *arguments = (struct io_sendfile_arguments *)_arguments;
+	struct IO_Event_Selector_URing *data = arguments->data;
+	
+	off_t offset = arguments->offset;
+	size_t total = 0;
+	
+	while (total < arguments->length) {
+		int result = io_splice(data, arguments->fiber, arguments->in, offset, arguments->pipe[1], -1, arguments->length - total);
+		
+		if (result < 0) return rb_fiber_scheduler_io_result(-1, -result);
+		
+		// We have reached the end of the file:
+		if (result == 0) break;
+		
+		offset += result;
+		
+		// Drain the pipe into the output:
+		while (result > 0) {
+			int written = io_splice(data, arguments->fiber, arguments->pipe[0], -1, arguments->out, -1, result);
+			
+			if (written < 0) return rb_fiber_scheduler_io_result(-1, -written);
+			if (written == 0) return rb_fiber_scheduler_io_result(-1, EPIPE);
+			
+			result -= written;
+			total += written;
+		}
+	}
+	
+	return rb_fiber_scheduler_io_result(total, 0);
+}
+
+static VALUE
+io_sendfile_ensure(VALUE _arguments)
+{
+	struct io_sendfile_arguments *arguments = (struct io_sendfile_arguments *)_arguments;
+	
+	close(arguments->pipe[0]);
+	close(arguments->pipe[1]);
+	
+	return Qnil;
+}
+
+// Send `length` bytes of the file `in`, starting at `offset`, to `out`, without copying the data through user space. Does not change the file position of `in`.
+VALUE IO_Event_Selector_URing_io_sendfile(VALUE self, VALUE fiber, VALUE out, VALUE in, VALUE _offset, VALUE _length) {
+	struct IO_Event_Selector_URing *data = NULL;
+	TypedData_Get_Struct(self, struct IO_Event_Selector_URing, &IO_Event_Selector_URing_Type, data);
+	
+	struct io_sendfile_arguments io_sendfile_arguments = {
+		.data = data,
+		.fiber = fiber,
+		.out = IO_Event_Selector_io_descriptor(out),
+		.in = IO_Event_Selector_io_descriptor(in),
+		.offset = NUM2OFFT(_offset),
+		.length = NUM2SIZET(_length),
+	};
+	
+	if (pipe2(io_sendfile_arguments.pipe, O_CLOEXEC) == -1) {
+		rb_sys_fail("IO_Event_Selector_URing_io_sendfile:pipe2");
+	}
+	
+	rb_update_max_fd(io_sendfile_arguments.pipe[0]);
+	rb_update_max_fd(io_sendfile_arguments.pipe[1]);
+	
+	// A larger pipe reduces the number of round trips, but may not be permitted:
+	fcntl(io_sendfile_arguments.pipe[1], F_SETPIPE_SZ, 1024 * 1024);
+	
+	return rb_ensure(io_sendfile_loop, (VALUE)&io_sendfile_arguments, io_sendfile_ensure, (VALUE)&io_sendfile_arguments);
+}
+
+#pragma mark - IO#copy
+
+struct io_copy_chunk_arguments {
+	struct IO_Event_Selector_URing *data;
+	VALUE fiber;
+	
+	int in;
+	int out;
+	int *pipe;
+	
+	unsigned int length;
+	
+	// The results of the first (source to pipe) and second (pipe to destination) operations:
+	int result;
+	int written;
+};
+
+static VALUE
+io_copy_chunk_submit(VALUE _arguments)
+{
+	struct io_copy_chunk_arguments *arguments = (struct io_copy_chunk_arguments *)_arguments;
+	struct IO_Event_Selector_URing *data = arguments->data;
+	
+	// Both operations must be submitted together, otherwise the link would be broken:
+	if (io_uring_sq_space_left(&data->ring) < 2) {
+		io_uring_submit_now(data);
+	}
+	
+	if (DEBUG) fprintf(stderr, "io_copy_chunk_submit:io_uring_prep_splice(fiber=%p, in=%d, out=%d, length=%u)\n", (void*)arguments->fiber, arguments->in, arguments->out, arguments->length);
+	
+	// Move data from the source into the pipe, and then (if all of it was moved) from the pipe into the destination. A short splice breaks the link, and the second operation completes with -ECANCELED, which is ignored.
+	struct io_uring_sqe *sqe = io_get_sqe(data);
+	io_uring_prep_splice(sqe, arguments->in, -1, arguments->pipe[1], -1, arguments->length, 0);
+	io_uring_sqe_set_data(sqe, (void*)arguments->fiber);
+	io_uring_sqe_set_flags(sqe, IOSQE_IO_LINK);
+	
+	sqe = io_get_sqe(data);
+	io_uring_prep_splice(sqe, arguments->pipe[0], -1, arguments->out, -1, arguments->length, 0);
+	io_uring_sqe_set_data(sqe, (void*)arguments->fiber);
+	
+	io_uring_submit_now(data);
+	
+	arguments->result = RB_NUM2INT(IO_Event_Selector_fiber_transfer(data->backend.loop, 0, NULL));
+	
+	// If the link was broken, there will be no completion for the second operation:
+	if (arguments->result == (int)arguments->length) {
+		arguments->written = RB_NUM2INT(IO_Event_Selector_fiber_transfer(data->backend.loop, 0, NULL));
+	}
+	
+	return Qnil;
+}
+
+static VALUE
+io_copy_chunk_cancel(VALUE _arguments, VALUE exception)
+{
+	struct io_copy_chunk_arguments *arguments = (struct io_copy_chunk_arguments *)_arguments;
+	struct IO_Event_Selector_URing *data = arguments->data;
+	
+	struct io_uring_sqe *sqe = io_get_sqe(data);
+	
+	if (DEBUG) fprintf(stderr, "io_copy_chunk_cancel:io_uring_prep_cancel(fiber=%p)\n", (void*)arguments->fiber);
+	
+	// Cancels the first operation which is still pending, and any operation linked to it:
+	io_uring_prep_cancel(sqe, (void*)arguments->fiber, 0);
+	io_uring_sqe_set_data(sqe, NULL);
+	io_uring_submit_now(data);
+	
+	rb_exc_raise(exception);
+}
+
+struct io_copy_arguments {
+	struct IO_Event_Selector_URing *data;
+	VALUE fiber;
+	
+	int in;
+	int out;
+	size_t length;
+	
+	int pipe[2];
+	size_t capacity;
+};
+
+static VALUE
+io_copy_loop(VALUE _arguments)
+{
+	struct io_copy_arguments *arguments = (struct io_copy_arguments *)_arguments;
+	struct IO_Event_Selector_URing *data = arguments->data;
+	
+	size_t total = 0;
+	
+	while (total < arguments->length) {
+		size_t length = arguments->length - total;
+		if (length > arguments->capacity) length = arguments->capacity;
+		
+		struct io_copy_chunk_arguments io_copy_chunk_arguments = {
+			.data = data,
+			.fiber = arguments->fiber,
+			.in = arguments->in,
+			.out = arguments->out,
+			.pipe = arguments->pipe,
+			.length = length,
+		};
+		
+		rb_rescue(io_copy_chunk_submit, (VALUE)&io_copy_chunk_arguments, io_copy_chunk_cancel, (VALUE)&io_copy_chunk_arguments);
+		
+		int result = io_copy_chunk_arguments.result;
+		int written = io_copy_chunk_arguments.written;
+		
+		if (result < 0) return rb_fiber_scheduler_io_result(-1, -result);
+		
+		// We have reached the end of the source:
+		if (result == 0) break;
+		
+		if (written < 0) return rb_fiber_scheduler_io_result(-1, -written);
+		
+		total += written;
+		result -= written;
+		
+		// Drain whatever is left in the pipe into the destination:
+		while (result > 0) {
+			written = io_splice(data, arguments->fiber, arguments->pipe[0], -1, arguments->out, -1, result);
+			
+			if (written < 0) return rb_fiber_scheduler_io_result(-1, -written);
+			if (written == 0) return rb_fiber_scheduler_io_result(-1, EPIPE);
+			
+			result -= written;
+			total += written;
+		}
+	}
+	
+	return rb_fiber_scheduler_io_result(total, 0);
+}
+
+static VALUE
+io_copy_ensure(VALUE _arguments)
+{
+	struct io_copy_arguments *arguments = (struct io_copy_arguments *)_arguments;
+	
+	close(arguments->pipe[0]);
+	close(arguments->pipe[1]);
+	
+	return Qnil;
+}
+
+// Copy up to `length` bytes (or until the end of the source if `length` is nil) from `source` to `destination`, without copying the data through user space.
+VALUE IO_Event_Selector_URing_io_copy(VALUE self, VALUE fiber, VALUE source, VALUE destination, VALUE _length) {
+	struct IO_Event_Selector_URing *data = NULL;
+	TypedData_Get_Struct(self, struct IO_Event_Selector_URing, &IO_Event_Selector_URing_Type, data);
+	
+	struct io_copy_arguments io_copy_arguments = {
+		.data = data,
+		.fiber = fiber,
+		.in = IO_Event_Selector_io_descriptor(source),
+		.out = IO_Event_Selector_io_descriptor(destination),
+		.length = NIL_P(_length) ? SIZE_MAX : NUM2SIZET(_length),
+	};
+	
+	if (pipe2(io_copy_arguments.pipe, O_CLOEXEC) == -1) {
+		rb_sys_fail("IO_Event_Selector_URing_io_copy:pipe2");
+	}
+	
+	rb_update_max_fd(io_copy_arguments.pipe[0]);
+	rb_update_max_fd(io_copy_arguments.pipe[1]);
+	
+	// A larger pipe reduces the number of round trips, but may not be permitted:
+	fcntl(io_copy_arguments.pipe[1], F_SETPIPE_SZ, 1024 * 1024);
+	
+	// Each chunk must fit in the pipe, otherwise the first splice would always be short:
+	int capacity = fcntl(io_copy_arguments.pipe[1], F_GETPIPE_SZ);
+	io_copy_arguments.capacity = capacity > 0 ? capacity : 1024 * 64;
+	
+	return rb_ensure(io_copy_loop, (VALUE)&io_copy_arguments, io_copy_ensure, (VALUE)&io_copy_arguments);
+}
+
+#pragma mark - IO#write_zerocopy
+
+// Zero-copy sends complete twice, once with the result and again when the kernel releases the buffer, so they are tagged to distinguish them from fibers:
+#define IO_EVENT_URING_ZEROCOPY_TAG ((uintptr_t)4)
+
+struct io_write_zerocopy_state {
+	VALUE fiber;
+	int result;
+	
+	// Whether the send has completed, and whether the kernel has released the buffer:
+	int completed, released;
+	
+	// Whether the fiber stopped waiting (e.g. it was interrupted), in which case the final completion frees the state:
+	int abandoned;
+};
+
+static
+void io_write_zerocopy_complete(struct io_write_zerocopy_state *state, int result, unsigned flags) {
+	if (flags & IORING_CQE_F_NOTIF) {
+		state->released = 1;
+	} else {
+		state->result = result;
+		state->completed = 1;
+		
+		// If no notification will follow, the buffer was never pinned:
+		if (!(flags & IORING_CQE_F_MORE)) state->released = 1;
+	}
+	
+	if (state->completed && state->released) {
+		if (state->abandoned) {
+			free(state);
+		} else {
+			IO_Event_Selector_fiber_transfer(state->fiber, 0, NULL);
+		}
+	}
+}
+
+struct io_write_zerocopy_arguments {
+	struct IO_Event_Selector_URing *data;
+	VALUE self;
+	VALUE fiber;
+	VALUE io;
+	
+	int descriptor;
+	
+	VALUE buffer;
+	size_t length;
+	size_t offset;
+	
+	struct io_write_zerocopy_state *state;
+};
+
+static
+int io_write_zerocopy_send(struct io_write_zerocopy_arguments *arguments, char *base, size_t size) {
+	struct IO_Event_Selector_URing *data = arguments->data;
+	struct io_write_zerocopy_state *state = arguments->state;
+	
+	struct io_uring_sqe *sqe = io_get_sqe(data);
+	
+	io_uring_prep_send_zc(sqe, arguments->descriptor, base, size, 0, 0);
+	io_uring_sqe_set_data(sqe, (void*)((uintptr_t)state | IO_EVENT_URING_ZEROCOPY_TAG));
+	io_uring_submit_pending(data);
+	
+	state->completed = state->released = 0;
+	
+	while (!(state->completed && state->released)) {
+		IO_Event_Selector_fiber_transfer(data->backend.loop, 0, NULL);
+	}
+	
+	return state->result;
+}
+
+static
+VALUE io_write_zerocopy_loop(VALUE _arguments) {
+	struct io_write_zerocopy_arguments *arguments = (struct io_write_zerocopy_arguments *)_arguments;
+	
+	const void *base;
+	size_t size;
+	rb_io_buffer_get_bytes_for_reading(arguments->buffer, &base, &size);
+	
+	size_t length = arguments->length;
+	size_t offset = arguments->offset;
+	
+	if (length > size) {
+		rb_raise(rb_eRuntimeError, "Length exceeds size of buffer!");
+	}
+	
+	while (true) {
+		size_t maximum_size = size - offset;
+		int result = io_write_zerocopy_send(arguments, (char*)base+offset, maximum_size);
+		
+		if (result > 0) {
+			offset += result;
+			if ((size_t)result >= length) break;
+			length -= result;
+		} else if (result == 0) {
+			break;
+		} else if (length > 0 && IO_Event_try_again(-result)) {
+			io_wait(arguments->self, arguments->fiber, arguments->io, RB_INT2NUM(IO_EVENT_WRITABLE), NULL);
+		} else {
+			return rb_fiber_scheduler_io_result(-1, -result);
+		}
+	}
+	
+	return rb_fiber_scheduler_io_result(offset, 0);
+}
+
+static
+VALUE io_write_zerocopy_ensure(VALUE _arguments) {
+	struct io_write_zerocopy_arguments *arguments = (struct io_write_zerocopy_arguments *)_arguments;
+	struct io_write_zerocopy_state *state = arguments->state;
+	
+	if (state->completed && state->released) {
+		free(state);
+	} else {
+		// The kernel still refers to the state, so cancel the send and let the final completion free it:
+		state->abandoned = 1;
+		
+		struct io_uring_sqe *sqe = io_get_sqe(arguments->data);
+		io_uring_prep_cancel(sqe, (void*)((uintptr_t)state | IO_EVENT_URING_ZEROCOPY_TAG), 0);
+		io_uring_sqe_set_data(sqe, NULL);
+		io_uring_submit_now(arguments->data);
+	}
+	
+	rb_io_buffer_unlock(arguments->buffer);
+	
+	return Qnil;
+}
+
+// Write to a socket like `io_write`, but transmit the data directly from the pages of the buffer, which stays locked until the kernel has released them. Small writes fall back to `io_write`.
+VALUE IO_Event_Selector_URing_io_write_zerocopy(VALUE self, VALUE fiber, VALUE io, VALUE buffer, VALUE _length, VALUE _offset) {
+	struct IO_Event_Selector_URing *data = NULL;
 	TypedData_Get_Struct(self, struct IO_Event_Selector_URing, &IO_Event_Selector_URing_Type, data);
 	
-	int descriptor = IO_Event_Selector_io_descriptor(io);
+	size_t length = NUM2SIZET(_length);
+	
+	if (length < IO_EVENT_SELECTOR_ZEROCOPY_MINIMUM) {
+		return io_write_deadline(self, fiber, io, buffer, _length, _offset, NULL);
+	}
+	
+	struct io_write_zerocopy_state *state = calloc(1, sizeof(struct io_write_zerocopy_state));
+	if (state == NULL) rb_sys_fail("IO_Event_Selector_URing_io_write_zerocopy:calloc");
+	
+	state->fiber = fiber;
+	state->completed = state->released = 1;
+	
+	struct io_write_zerocopy_arguments io_write_zerocopy_arguments = {
+		.data = data,
+		.self = self,
+		.fiber = fiber,
+		.io = io,
+		
+		.descriptor = IO_Event_Selector_io_descriptor(io),
+		.buffer = buffer,
+		.length = length,
+		.offset = NUM2SIZET(_offset),
+		
+		.state = state,
+	};
+	
+	rb_io_buffer_lock(buffer);
+	
+	return rb_ensure(io_write_zerocopy_loop, (VALUE)&io_write_zerocopy_arguments, io_write_zerocopy_ensure, (VALUE)&io_write_zerocopy_arguments);
+}
+
+#pragma mark - IO#recvmsg/IO#sendmsg
+
+// Each datagram in a batch is a separate operation, which completes with its own tagged message:
+#define IO_EVENT_URING_MESSAGE_TAG ((uintptr_t)3)
+
+struct io_message_batch;
+
+struct io_message {
+	struct io_message_batch *batch;
+	
+	int completed;
+	int result;
+	
+	struct msghdr header;
+	struct IO_Event_Selector_Message storage;
+};
+
+struct io_message_batch {
+	VALUE fiber;
+	
+	// The number of submitted operations which have not completed yet:
+	size_t pending;
+	
+	// Whether the fiber stopped waiting (e.g. it was interrupted), in which case the final completion frees the batch:
+	int abandoned;
+	
+	size_t count;
+	struct io_message messages[];
+};
+
+static
+void io_message_complete(struct io_message *message, int result) {
+	struct io_message_batch *batch = message->batch;
+	
+	message->completed = 1;
+	message->result = result;
+	batch->pending -= 1;
+	
+	if (batch->pending == 0) {
+		if (batch->abandoned) {
+			free(batch);
+		} else {
+			IO_Event_Selector_fiber_transfer(batch->fiber, 0, NULL);
+		}
+	}
+}
+
+struct io_message_arguments {
+	struct IO_Event_Selector_URing *data;
+	int descriptor;
+	
+	// Either the buffers to receive into, or the messages to send:
+	VALUE messages;
+	
+	struct io_message_batch *batch;
+};
+
+static
+struct io_message_batch * io_message_batch_allocate(VALUE fiber, VALUE messages) {
+	Check_Type(messages, T_ARRAY);
+	
+	size_t count = RARRAY_LEN(messages);
+	if (count > IO_EVENT_SELECTOR_MESSAGES_MAXIMUM) count = IO_EVENT_SELECTOR_MESSAGES_MAXIMUM;
+	
+	struct io_message_batch *batch = calloc(1, sizeof(struct io_message_batch) + count * sizeof(struct io_message));
+	if (batch == NULL) rb_sys_fail("io_message_batch_allocate:calloc");
+	
+	batch->fiber = fiber;
+	batch->count = count;
+	
+	for (size_t i = 0; i < count; i += 1) {
+		batch->messages[i].batch = batch;
+		batch->messages[i].completed = 1;
+	}
+	
+	return batch;
+}
+
+// Submit the given range of messages as a chain, so that they execute in order and the first failure cancels the rest, then wait for all of them to complete.
+static
+void io_message_submit(struct io_message_arguments *arguments, size_t first, size_t last, int receive, int flags) {
+	struct IO_Event_Selector_URing *data = arguments->data;
+	struct io_message_batch *batch = arguments->batch;
+	
+	for (size_t i = first; i < last; i += 1) {
+		struct io_message *message = &batch->messages[i];
+		struct io_uring_sqe *sqe = io_get_sqe(data);
+		
+		if (receive) {
+			io_uring_prep_recvmsg(sqe, arguments->descriptor, &message->header, flags);
+		} else {
+			io_uring_prep_sendmsg(sqe, arguments->descriptor, &message->header, flags);
+		}
+		
+		io_uring_sqe_set_data(sqe, (void*)((uintptr_t)message | IO_EVENT_URING_MESSAGE_TAG));
+		
+		if (i + 1 < last) {
+			io_uring_sqe_set_flags(sqe, IOSQE_IO_LINK);
+		}
+		
+		message->completed = 0;
+		batch->pending += 1;
+	}
+	
+	io_uring_submit_pending(data);
+	
+	while (batch->pending > 0) {
+		IO_Event_Selector_fiber_transfer(data->backend.loop, 0, NULL);
+	}
+}
+
+static
+VALUE io_recvmsg_loop(VALUE _arguments) {
+	struct io_message_arguments *arguments = (struct io_message_arguments *)_arguments;
+	struct io_message_batch *batch = arguments->batch;
+	
+	if (batch->count == 0) return rb_ary_new();
 	
-	void *base;
-	size_t size;
-	rb_io_buffer_get_bytes_for_writing(buffer, &base, &size);
+	for (size_t i = 0; i < batch->count; i += 1) {
+		struct io_message *message = &batch->messages[i];
+		IO_Event_Selector_message_for_writing(RARRAY_AREF(arguments->messages, i), &message->header, &message->storage);
+	}
 	
-	size_t length = NUM2SIZET(_length);
-	size_t offset = NUM2SIZET(_offset);
+	// Wait for the first datagram, and then receive any others which have already arrived:
+	io_message_submit(arguments, 0, 1, 1, 0);
 	
-	while (true) {
-		size_t maximum_size = size - offset;
-		if (DEBUG_IO_READ) fprintf(stderr, "io_read(%d, +%ld, %ld)\n", descriptor, offset, maximum_size);
-		int result = io_read(data, fiber, descriptor, (char*)base+offset, maximum_size);
-		if (DEBUG_IO_READ) fprintf(stderr, "io_read(%d, +%ld, %ld) -> %d\n", descriptor, offset, maximum_size, result);
+	if (batch->messages[0].result < 0) {
+		rb_syserr_fail(-batch->messages[0].result, "IO_Event_Selector_URing_io_recvmsg:io_uring_prep_recvmsg");
+	}
+	
+	if (batch->count > 1) {
+		io_message_submit(arguments, 1, batch->count, 1, MSG_DONTWAIT);
+	}
+	
+	VALUE received = rb_ary_new_capa(batch->count);
+	
+	for (size_t i = 0; i < batch->count; i += 1) {
+		struct io_message *message = &batch->messages[i];
 		
-		if (result > 0) {
-			offset += result;
-			if ((size_t)result >= length) break;
-			length -= result;
-		} else if (result == 0) {
-			break;
-		} else if (length > 0 && IO_Event_try_again(-result)) {
-			IO_Event_Selector_URing_io_wait(self, fiber, io, RB_INT2NUM(IO_EVENT_READABLE));
-		} else {
-			return rb_fiber_scheduler_io_result(-1, -result);
+		// The first failure (usually EAGAIN) ends the batch:
+		if (message->result < 0) break;
+		
+		rb_ary_push(received, IO_Event_Selector_message_received(&message->header, message->result));
+	}
+	
+	return received;
+}
+
+static
+VALUE io_sendmsg_loop(VALUE _arguments) {
+	struct io_message_arguments *arguments = (struct io_message_arguments *)_arguments;
+	struct io_message_batch *batch = arguments->batch;
+	
+	if (batch->count == 0) return RB_INT2NUM(0);
+	
+	for (size_t i = 0; i < batch->count; i += 1) {
+		struct io_message *message = &batch->messages[i];
+		IO_Event_Selector_message_for_reading(RARRAY_AREF(arguments->messages, i), &message->header, &message->storage);
+	}
+	
+	io_message_submit(arguments, 0, batch->count, 0, 0);
+	
+	size_t sent = 0;
+	
+	while (sent < batch->count && batch->messages[sent].result >= 0) {
+		sent += 1;
+	}
+	
+	if (sent == 0) {
+		rb_syserr_fail(-batch->messages[0].result, "IO_Event_Selector_URing_io_sendmsg:io_uring_prep_sendmsg");
+	}
+	
+	return SIZET2NUM(sent);
+}
+
+static
+VALUE io_message_ensure(VALUE _arguments) {
+	struct io_message_arguments *arguments = (struct io_message_arguments *)_arguments;
+	struct io_message_batch *batch = arguments->batch;
+	
+	if (batch->pending == 0) {
+		free(batch);
+		return Qnil;
+	}
+	
+	// The kernel still refers to the batch, so cancel the outstanding operations and let the final completion free it:
+	batch->abandoned = 1;
+	
+	for (size_t i = 0; i < batch->count; i += 1) {
+		struct io_message *message = &batch->messages[i];
+		
+		if (!message->completed) {
+			struct io_uring_sqe *sqe = io_get_sqe(arguments->data);
+			io_uring_prep_cancel(sqe, (void*)((uintptr_t)message | IO_EVENT_URING_MESSAGE_TAG), 0);
+			io_uring_sqe_set_data(sqe, NULL);
 		}
 	}
 	
-	return rb_fiber_scheduler_io_result(offset, 0);
+	io_uring_submit_now(arguments->data);
+	
+	return Qnil;
 }
 
-static VALUE IO_Event_Selector_URing_io_read_compatible(int argc, VALUE *argv, VALUE self)
-{
-	rb_check_arity(argc, 4, 5);
+// Receive one or more datagrams, one into each of the given buffers, returning an array of `[length, address, segment_size]` for each datagram received.
+VALUE IO_Event_Selector_URing_io_recvmsg(VALUE self, VALUE fiber, VALUE io, VALUE buffers) {
+	struct IO_Event_Selector_URing *data = NULL;
+	TypedData_Get_Struct(self, struct IO_Event_Selector_URing, &IO_Event_Selector_URing_Type, data);
 	
-	VALUE _offset = SIZET2NUM(0);
+	struct io_message_arguments io_message_arguments = {
+		.data = data,
+		.descriptor = IO_Event_Selector_io_descriptor(io),
+		.messages = buffers,
+		.batch = io_message_batch_allocate(fiber, buffers),
+	};
 	
-	if (argc == 5) {
-		_offset = argv[4];
+	return rb_ensure(io_recvmsg_loop, (VALUE)&io_message_arguments, io_message_ensure, (VALUE)&io_message_arguments);
+}
+
+// Send one or more datagrams, each given as `[buffer, length, address, segment_size]`, returning the number which were sent. This may be fewer than the number given.
+VALUE IO_Event_Selector_URing_io_sendmsg(VALUE self, VALUE fiber, VALUE io, VALUE messages) {
+	struct IO_Event_Selector_URing *data = NULL;
+	TypedData_Get_Struct(self, struct IO_Event_Selector_URing, &IO_Event_Selector_URing_Type, data);
+	
+	struct io_message_arguments io_message_arguments = {
+		.data = data,
+		.descriptor = IO_Event_Selector_io_descriptor(io),
+		.messages = messages,
+		.batch = io_message_batch_allocate(fiber, messages),
+	};
+	
+	return rb_ensure(io_sendmsg_loop, (VALUE)&io_message_arguments, io_message_ensure, (VALUE)&io_message_arguments);
+}
+
+#endif
+
+#pragma mark - IO#close
+
+static const int ASYNC_CLOSE = 1;
+
+VALUE IO_Event_Selector_URing_io_close(VALUE self, VALUE io) {
+	struct IO_Event_Selector_URing *data = NULL;
+	TypedData_Get_Struct(self, struct IO_Event_Selector_URing, &IO_Event_Selector_URing_Type, data);
+	
+	int descriptor = IO_Event_Selector_io_descriptor(io);
+	
+	io_accept_close(data, descriptor);
+	
+	if (ASYNC_CLOSE) {
+		struct io_uring_sqe *sqe = io_get_sqe(data);
+		
+		io_uring_prep_close(sqe, descriptor);
+		io_uring_sqe_set_data(sqe, NULL);
+		io_uring_submit_now(data);
+	} else {
+		close(descriptor);
 	}
 	
-	return IO_Event_Selector_URing_io_read(self, argv[0], argv[1], argv[2], argv[3], _offset);
+	// We don't wait for the result of close since it has no use in pratice:
+	return Qtrue;
 }
 
-#pragma mark - IO#write
+#pragma mark - File Operations
 
-struct io_write_arguments {
+struct file_operation_arguments {
 	struct IO_Event_Selector_URing *data;
 	VALUE fiber;
-	int descriptor;
-	char *buffer;
-	size_t length;
+	struct io_uring_sqe *sqe;
 };
 
 static VALUE
-io_write_submit(VALUE _argument)
+file_operation_submit(VALUE _arguments)
 {
-	struct io_write_arguments *arguments = (struct io_write_arguments*)_argument;
+	struct file_operation_arguments *arguments = (struct file_operation_arguments *)_arguments;
 	struct IO_Event_Selector_URing *data = arguments->data;
 	
-	struct io_uring_sqe *sqe = io_get_sqe(data);
-	
-	if (DEBUG) fprintf(stderr, "io_write_submit:io_uring_prep_write(fiber=%p, descriptor=%d, buffer=%p, length=%ld)\n", (void*)arguments->fiber, arguments->descriptor, arguments->buffer, arguments->length);
-	
-	io_uring_prep_write(sqe, arguments->descriptor, arguments->buffer, arguments->length, io_seekable(arguments->descriptor));
-	io_uring_sqe_set_data(sqe, (void*)arguments->fiber);
-	io_uring_submit_pending(data);
+	io_uring_sqe_set_data(arguments->sqe, (void*)arguments->fiber);
+	io_uring_submit_now(data);
 	
 	return IO_Event_Selector_fiber_transfer(data->backend.loop, 0, NULL);
 }
 
 static VALUE
-io_write_cancel(VALUE _argument, VALUE exception)
+file_operation_cancel(VALUE _arguments, VALUE exception)
 {
-	struct io_write_arguments *arguments = (struct io_write_arguments*)_argument;
+	struct file_operation_arguments *arguments = (struct file_operation_arguments *)_arguments;
 	struct IO_Event_Selector_URing *data = arguments->data;
 	
 	struct io_uring_sqe *sqe = io_get_sqe(data);
 	
-	if (DEBUG) fprintf(stderr, "io_wait_rescue:io_uring_prep_cancel(%p)\n", (void*)arguments->fiber);
+	if (DEBUG) fprintf(stderr, "file_operation_cancel:io_uring_prep_cancel(fiber=%p)\n", (void*)arguments->fiber);
 	
 	io_uring_prep_cancel(sqe, (void*)arguments->fiber, 0);
 	io_uring_sqe_set_data(sqe, NULL);
@@ -569,100 +2557,164 @@ io_write_cancel(VALUE _argument, VALUE exception)
 	rb_exc_raise(exception);
 }
 
+// Submit the prepared operation and transfer to the event loop until it completes, returning the result. Any paths are copied by the kernel during submission, so they only need to be valid until this function returns.
 static int
-io_write(struct IO_Event_Selector_URing *data, VALUE fiber, int descriptor, char *buffer, size_t length)
+file_operation(struct IO_Event_Selector_URing *data, VALUE fiber, struct io_uring_sqe *sqe)
 {
-	struct io_write_arguments arguments = {
+	struct file_operation_arguments arguments = {
 		.data = data,
 		.fiber = fiber,
-		.descriptor = descriptor,
-		.buffer = buffer,
-		.length = length,
+		.sqe = sqe,
 	};
 	
-	int result = RB_NUM2INT(
-		rb_rescue(io_write_submit, (VALUE)&arguments, io_write_cancel, (VALUE)&arguments)
+	return RB_NUM2INT(
+		rb_rescue(file_operation_submit, (VALUE)&arguments, file_operation_cancel, (VALUE)&arguments)
 	);
+}
+
+// Open the file at the given path, returning a `File` instance. The descriptor is always opened with `O_CLOEXEC`.
+VALUE IO_Event_Selector_URing_file_open(VALUE self, VALUE fiber, VALUE path, VALUE _flags, VALUE _mode) {
+	struct IO_Event_Selector_URing *data = NULL;
+	TypedData_Get_Struct(self, struct IO_Event_Selector_URing, &IO_Event_Selector_URing_Type, data);
 	
-	if (DEBUG) fprintf(stderr, "io_write:IO_Event_Selector_fiber_transfer -> %d\n", result);
+	FilePathValue(path);
+	int flags = NUM2INT(_flags) | O_CLOEXEC;
+	mode_t mode = NUM2MODET(_mode);
 	
-	return result;
+	struct io_uring_sqe *sqe = io_get_sqe(data);
+	io_uring_prep_openat(sqe, AT_FDCWD, RSTRING_PTR(path), flags, mode);
+	
+	int result = file_operation(data, fiber, sqe);
+	RB_GC_GUARD(path);
+	
+	if (result < 0) {
+		rb_syserr_fail_str(-result, path);
+	}
+	
+	rb_update_max_fd(result);
+	
+	return rb_io_fdopen(result, flags, RSTRING_PTR(path));
 }
 
-VALUE IO_Event_Selector_URing_io_write(VALUE self, VALUE fiber, VALUE io, VALUE buffer, VALUE _length, VALUE _offset) {
+// Get the status of the file at the given path, following symbolic links, returning a `File::Stat` instance.
+VALUE IO_Event_Selector_URing_file_stat(VALUE self, VALUE fiber, VALUE path) {
 	struct IO_Event_Selector_URing *data = NULL;
 	TypedData_Get_Struct(self, struct IO_Event_Selector_URing, &IO_Event_Selector_URing_Type, data);
 	
-	int descriptor = IO_Event_Selector_io_descriptor(io);
+	FilePathValue(path);
 	
-	const void *base;
-	size_t size;
-	rb_io_buffer_get_bytes_for_reading(buffer, &base, &size);
+	// The kernel writes the result when the operation completes, which may be after the fiber has been cancelled, so it can't live on the stack:
+	struct statx *buffer = ALLOC(struct statx);
 	
-	size_t length = NUM2SIZET(_length);
-	size_t offset = NUM2SIZET(_offset);
+	struct io_uring_sqe *sqe = io_get_sqe(data);
+	io_uring_prep_statx(sqe, AT_FDCWD, RSTRING_PTR(path), AT_STATX_SYNC_AS_STAT, STATX_BASIC_STATS, buffer);
 	
-	if (length > size) {
-		rb_raise(rb_eRuntimeError, "Length exceeds size of buffer!");
-	}
+	// If the operation is cancelled, the buffer is (intentionally) leaked:
+	int result = file_operation(data, fiber, sqe);
+	RB_GC_GUARD(path);
 	
-	while (true) {
-		size_t maximum_size = size - offset;
-		int result = io_write(data, fiber, descriptor, (char*)base+offset, maximum_size);
-		
-		if (result > 0) {
-			offset += result;
-			if ((size_t)result >= length) break;
-			length -= result;
-		} else if (result == 0) {
-			break;
-		} else if (length > 0 && IO_Event_try_again(-result)) {
-			IO_Event_Selector_URing_io_wait(self, fiber, io, RB_INT2NUM(IO_EVENT_WRITABLE));
-		} else {
-			return rb_fiber_scheduler_io_result(-1, -result);
-		}
+	if (result < 0) {
+		xfree(buffer);
+		rb_syserr_fail_str(-result, path);
 	}
 	
-	return rb_fiber_scheduler_io_result(offset, 0);
+	struct stat status = {
+		.st_dev = makedev(buffer->stx_dev_major, buffer->stx_dev_minor),
+		.st_ino = buffer->stx_ino,
+		.st_mode = buffer->stx_mode,
+		.st_nlink = buffer->stx_nlink,
+		.st_uid = buffer->stx_uid,
+		.st_gid = buffer->stx_gid,
+		.st_rdev = makedev(buffer->stx_rdev_major, buffer->stx_rdev_minor),
+		.st_size = buffer->stx_size,
+		.st_blksize = buffer->stx_blksize,
+		.st_blocks = buffer->stx_blocks,
+		.st_atim = {.tv_sec = buffer->stx_atime.tv_sec, .tv_nsec = buffer->stx_atime.tv_nsec},
+		.st_mtim = {.tv_sec = buffer->stx_mtime.tv_sec, .tv_nsec = buffer->stx_mtime.tv_nsec},
+		.st_ctim = {.tv_sec = buffer->stx_ctime.tv_sec, .tv_nsec = buffer->stx_ctime.tv_nsec},
+	};
+	
+	xfree(buffer);
+	
+	return rb_stat_new(&status);
 }
 
-static VALUE IO_Event_Selector_URing_io_write_compatible(int argc, VALUE *argv, VALUE self)
-{
-	rb_check_arity(argc, 4, 5);
+static int
+io_fsync_function(VALUE self, VALUE fiber, int descriptor, int datasync) {
+	struct IO_Event_Selector_URing *data = NULL;
+	TypedData_Get_Struct(self, struct IO_Event_Selector_URing, &IO_Event_Selector_URing_Type, data);
 	
-	VALUE _offset = SIZET2NUM(0);
+	struct io_uring_sqe *sqe = io_get_sqe(data);
+	io_uring_prep_fsync(sqe, descriptor, datasync ? IORING_FSYNC_DATASYNC : 0);
 	
-	if (argc == 5) {
-		_offset = argv[4];
+	return file_operation(data, fiber, sqe);
+}
+
+static VALUE
+io_fsync(VALUE self, VALUE fiber, VALUE io, int datasync) {
+	struct IO_Event_Selector_URing *data = NULL;
+	TypedData_Get_Struct(self, struct IO_Event_Selector_URing, &IO_Event_Selector_URing_Type, data);
+	
+	int descriptor = IO_Event_Selector_io_descriptor(io);
+	
+	// Concurrent requests for the same descriptor share a single flush:
+	int result = IO_Event_Selector_sync(&data->backend, &data->syncs, self, fiber, descriptor, datasync, io_fsync_function);
+	
+	if (result < 0) {
+		rb_syserr_fail(-result, "IO_Event_Selector_URing_io_fsync:io_uring_prep_fsync");
 	}
 	
-	return IO_Event_Selector_URing_io_write(self, argv[0], argv[1], argv[2], argv[3], _offset);
+	return INT2NUM(0);
 }
 
-#endif
-
-#pragma mark - IO#close
+// Flush the file's data and metadata to the storage device.
+VALUE IO_Event_Selector_URing_io_fsync(VALUE self, VALUE fiber, VALUE io) {
+	return io_fsync(self, fiber, io, 0);
+}
 
-static const int ASYNC_CLOSE = 1;
+// Flush the file's data (and only the metadata required to read it) to the storage device.
+VALUE IO_Event_Selector_URing_io_fdatasync(VALUE self, VALUE fiber, VALUE io) {
+	return io_fsync(self, fiber, io, 1);
+}
 
-VALUE IO_Event_Selector_URing_io_close(VALUE self, VALUE io) {
+VALUE IO_Event_Selector_URing_file_unlink(VALUE self, VALUE fiber, VALUE path) {
 	struct IO_Event_Selector_URing *data = NULL;
 	TypedData_Get_Struct(self, struct IO_Event_Selector_URing, &IO_Event_Selector_URing_Type, data);
 	
-	int descriptor = IO_Event_Selector_io_descriptor(io);
-
-	if (ASYNC_CLOSE) {
-		struct io_uring_sqe *sqe = io_get_sqe(data);
-		
-		io_uring_prep_close(sqe, descriptor);
-		io_uring_sqe_set_data(sqe, NULL);
-		io_uring_submit_now(data);
-	} else {
-		close(descriptor);
+	FilePathValue(path);
+	
+	struct io_uring_sqe *sqe = io_get_sqe(data);
+	io_uring_prep_unlinkat(sqe, AT_FDCWD, RSTRING_PTR(path), 0);
+	
+	int result = file_operation(data, fiber, sqe);
+	RB_GC_GUARD(path);
+	
+	if (result < 0) {
+		rb_syserr_fail_str(-result, path);
 	}
+	
+	return Qnil;
+}
 
-	// We don't wait for the result of close since it has no use in pratice:
-	return Qtrue;
+VALUE IO_Event_Selector_URing_file_rename(VALUE self, VALUE fiber, VALUE from, VALUE to) {
+	struct IO_Event_Selector_URing *data = NULL;
+	TypedData_Get_Struct(self, struct IO_Event_Selector_URing, &IO_Event_Selector_URing_Type, data);
+	
+	FilePathValue(from);
+	FilePathValue(to);
+	
+	struct io_uring_sqe *sqe = io_get_sqe(data);
+	io_uring_prep_renameat(sqe, AT_FDCWD, RSTRING_PTR(from), AT_FDCWD, RSTRING_PTR(to), 0);
+	
+	int result = file_operation(data, fiber, sqe);
+	RB_GC_GUARD(from);
+	RB_GC_GUARD(to);
+	
+	if (result < 0) {
+		rb_syserr_fail_str(-result, from);
+	}
+	
+	return Qnil;
 }
 
 #pragma mark - Event Loop
@@ -748,13 +2800,69 @@ unsigned select_process_completions(struct io_uring *ring) {
 	io_uring_for_each_cqe(ring, head, cqe) {
 		++completed;
 		
+		uintptr_t tag = cqe->user_data & IO_EVENT_URING_TAG_MASK;
+		
+		if (tag == IO_EVENT_URING_WAIT_MANY_TAG) {
+			struct io_wait_many_entry *entry = (struct io_wait_many_entry *)(uintptr_t)(cqe->user_data & ~(uint64_t)IO_EVENT_URING_TAG_MASK);
+			int result = cqe->res;
+			
+			io_uring_cq_advance(ring, 1);
+			
+			io_wait_many_complete(entry, result);
+			continue;
+		}
+		
+		if (tag == IO_EVENT_URING_ACCEPT_TAG) {
+			struct io_accept_state *state = (struct io_accept_state *)(uintptr_t)(cqe->user_data & ~(uint64_t)IO_EVENT_URING_TAG_MASK);
+			int result = cqe->res;
+			unsigned flags = cqe->flags;
+			
+			io_uring_cq_advance(ring, 1);
+			
+			io_accept_complete(state, result, flags);
+			continue;
+		}
+
+#ifdef HAVE_RUBY_IO_BUFFER_H
+		if (tag == IO_EVENT_URING_ZEROCOPY_TAG) {
+			struct io_write_zerocopy_state *state = (struct io_write_zerocopy_state *)(uintptr_t)(cqe->user_data & ~(uint64_t)IO_EVENT_URING_TAG_MASK);
+			int result = cqe->res;
+			unsigned flags = cqe->flags;
+			
+			io_uring_cq_advance(ring, 1);
+			
+			io_write_zerocopy_complete(state, result, flags);
+			continue;
+		}
+		
+		if (tag == IO_EVENT_URING_MESSAGE_TAG) {
+			struct io_message *message = (struct io_message *)(uintptr_t)(cqe->user_data & ~(uint64_t)IO_EVENT_URING_TAG_MASK);
+			int result = cqe->res;
+			
+			io_uring_cq_advance(ring, 1);
+			
+			io_message_complete(message, result);
+			continue;
+		}
+#endif
+
+		if (tag == IO_EVENT_URING_OPERATION_TAG || tag == IO_EVENT_URING_TIMEOUT_TAG) {
+			struct io_operation *operation = (struct io_operation *)(uintptr_t)(cqe->user_data & ~(uint64_t)IO_EVENT_URING_TAG_MASK);
+			int result = cqe->res;
+			
+			io_uring_cq_advance(ring, 1);
+			
+			io_operation_complete(operation, result, tag == IO_EVENT_URING_TIMEOUT_TAG);
+			continue;
+		}
+		
 		// If the operation was cancelled, or the operation has no user data (fiber):
 		if (cqe->res == -ECANCELED || cqe->user_data == 0 || cqe->user_data == LIBURING_UDATA_TIMEOUT) {
 			io_uring_cq_advance(ring, 1);
 			continue;
 		}
 		
-		VALUE fiber = (VALUE)cqe->user_data;
+		VALUE fiber = (VALUE)(cqe->user_data & ~(uint64_t)IO_EVENT_URING_TAG_MASK);
 		VALUE result = RB_INT2NUM(cqe->res);
 		
 		if (DEBUG) fprintf(stderr, "cqe res=%d user_data=%p\n", cqe->res, (void*)cqe->user_data);
@@ -860,14 +2968,42 @@ void Init_IO_Event_Selector_URing(VALUE IO_Event_Selector) {
 	rb_define_method(IO_Event_Selector_URing, "wakeup", IO_Event_Selector_URing_wakeup, 0);
 	rb_define_method(IO_Event_Selector_URing, "close", IO_Event_Selector_URing_close, 0);
 	
-	rb_define_method(IO_Event_Selector_URing, "io_wait", IO_Event_Selector_URing_io_wait, 3);
-	
+	rb_define_method(IO_Event_Selector_URing, "io_wait", IO_Event_Selector_URing_io_wait_compatible, -1);
+	rb_define_method(IO_Event_Selector_URing, "io_cancel", IO_Event_Selector_URing_io_cancel, 1);
+	rb_define_method(IO_Event_Selector_URing, "io_wait_many", IO_Event_Selector_URing_io_wait_many, -1);
+	rb_define_method(IO_Event_Selector_URing, "io_select", IO_Event_Selector_URing_io_select, 4);
+	rb_define_method(IO_Event_Selector_URing, "io_accept", IO_Event_Selector_URing_io_accept, 2);
+
 #ifdef HAVE_RUBY_IO_BUFFER_H
 	rb_define_method(IO_Event_Selector_URing, "io_read", IO_Event_Selector_URing_io_read_compatible, -1);
 	rb_define_method(IO_Event_Selector_URing, "io_write", IO_Event_Selector_URing_io_write_compatible, -1);
-#endif
+	rb_define_method(IO_Event_Selector_URing, "io_read_until", IO_Event_Selector_URing_io_read_until, -1);
 	
+	rb_define_method(IO_Event_Selector_URing, "io_pread", IO_Event_Selector_URing_io_pread, 6);
+	rb_define_method(IO_Event_Selector_URing, "io_pwrite", IO_Event_Selector_URing_io_pwrite, 6);
+	
+	rb_define_method(IO_Event_Selector_URing, "io_readv", IO_Event_Selector_URing_io_readv, 4);
+	rb_define_method(IO_Event_Selector_URing, "io_writev", IO_Event_Selector_URing_io_writev, 4);
+	
+	rb_define_method(IO_Event_Selector_URing, "io_sendfile", IO_Event_Selector_URing_io_sendfile, 5);
+	rb_define_method(IO_Event_Selector_URing, "io_copy", IO_Event_Selector_URing_io_copy, 4);
+	
+	rb_define_method(IO_Event_Selector_URing, "io_write_zerocopy", IO_Event_Selector_URing_io_write_zerocopy, 5);
+	
+	rb_define_method(IO_Event_Selector_URing, "io_recvmsg", IO_Event_Selector_URing_io_recvmsg, 3);
+	rb_define_method(IO_Event_Selector_URing, "io_sendmsg", IO_Event_Selector_URing_io_sendmsg, 3);
+#endif
+
 	rb_define_method(IO_Event_Selector_URing, "io_close", IO_Event_Selector_URing_io_close, 1);
 	
-	rb_define_method(IO_Event_Selector_URing, "process_wait", IO_Event_Selector_URing_process_wait, 3);
+	rb_define_method(IO_Event_Selector_URing, "file_open", IO_Event_Selector_URing_file_open, 4);
+	rb_define_method(IO_Event_Selector_URing, "file_stat", IO_Event_Selector_URing_file_stat, 2);
+	rb_define_method(IO_Event_Selector_URing, "file_unlink", IO_Event_Selector_URing_file_unlink, 2);
+	rb_define_method(IO_Event_Selector_URing, "file_rename", IO_Event_Selector_URing_file_rename, 3);
+	
+	rb_define_method(IO_Event_Selector_URing, "io_fsync", IO_Event_Selector_URing_io_fsync, 2);
+	rb_define_method(IO_Event_Selector_URing, "io_fdatasync", IO_Event_Selector_URing_io_fdatasync, 2);
+	
+	rb_define_method(IO_Event_Selector_URing, "process_wait", IO_Event_Selector_URing_process_wait, -1);
+	rb_define_method(IO_Event_Selector_URing, "process_spawn", IO_Event_Selector_URing_process_spawn, -1);
 }
@@ -0,0 +1,302 @@
+// Copyright, 2021, by Samuel G. D. Williams. <http://www.codeotaku.com>
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+
+#include "worker.h"
+
+#include <ruby/thread.h>
+#include <signal.h>
+#include <time.h>
+
+// Ruby installs a handler for this signal which does nothing, and uses it to interrupt blocking system calls on its own threads. We do the same to interrupt jobs which are cancelled while running:
+#define IO_EVENT_WORKER_INTERRUPT SIGVTALRM
+
+// How often (in nanoseconds) to interrupt a cancelled job, in case it had not yet entered a blocking system call:
+#define IO_EVENT_WORKER_INTERRUPT_INTERVAL (10 * 1000 * 1000)
+
+static
+void IO_Event_Worker_List_push(struct IO_Event_Worker_List *list, struct IO_Event_Worker_Job *job)
+{
+	job->previous = list->tail;
+	job->next = NULL;
+	
+	if (list->tail) {
+		list->tail->next = job;
+	} else {
+		list->head = job;
+	}
+	
+	list->tail = job;
+}
+
+static
+void IO_Event_Worker_List_remove(struct IO_Event_Worker_List *list, struct IO_Event_Worker_Job *job)
+{
+	if (job->previous) {
+		job->previous->next = job->next;
+	} else {
+		list->head = job->next;
+	}
+	
+	if (job->next) {
+		job->next->previous = job->previous;
+	} else {
+		list->tail = job->previous;
+	}
+	
+	job->previous = job->next = NULL;
+}
+
+void IO_Event_Worker_Pool_initialize(struct IO_Event_Worker_Pool *pool, struct IO_Event_Interrupt *interrupt, size_t maximum)
+{
+	pthread_mutex_init(&pool->mutex, NULL);
+	pthread_cond_init(&pool->condition, NULL);
+	
+	pool->pending.head = pool->pending.tail = NULL;
+	pool->completed.head = pool->completed.tail = NULL;
+	
+	pool->interrupt = interrupt;
+	
+	pool->count = pool->idle = 0;
+	pool->maximum = maximum;
+	pool->threads = NULL;
+	pool->pid = getpid();
+	
+	pool->closed = 0;
+}
+
+static
+void * IO_Event_Worker_Pool_thread(void *_pool)
+{
+	struct IO_Event_Worker_Pool *pool = _pool;
+	
+	pthread_mutex_lock(&pool->mutex);
+	
+	while (true) {
+		while (!pool->closed && pool->pending.head == NULL) {
+			pool->idle += 1;
+			pthread_cond_wait(&pool->condition, &pool->mutex);
+			pool->idle -= 1;
+		}
+		
+		if (pool->closed) break;
+		
+		struct IO_Event_Worker_Job *job = pool->pending.head;
+		IO_Event_Worker_List_remove(&pool->pending, job);
+		job->thread = pthread_self();
+		job->cancelled = 0;
+		job->state = IO_EVENT_WORKER_JOB_RUNNING;
+		
+		pthread_mutex_unlock(&pool->mutex);
+		job->function(job);
+		pthread_mutex_lock(&pool->mutex);
+		
+		job->state = IO_EVENT_WORKER_JOB_COMPLETED;
+		IO_Event_Worker_List_push(&pool->completed, job);
+		
+		// Wake up anyone waiting in `IO_Event_Worker_Pool_cancel`:
+		pthread_cond_broadcast(&pool->condition);
+		
+		IO_Event_Interrupt_signal(pool->interrupt);
+	}
+	
+	pthread_mutex_unlock(&pool->mutex);
+	
+	return NULL;
+}
+
+// Must be called with the mutex held. Returns 0 on success, or the error from `pthread_create`.
+static
+int IO_Event_Worker_Pool_spawn(struct IO_Event_Worker_Pool *pool)
+{
+	if (pool->threads == NULL) {
+		pool->threads = xcalloc(pool->maximum, sizeof(pthread_t));
+	}
+	
+	// Signals should be handled by Ruby threads, so we block them all in the worker, except the one used to interrupt cancelled jobs:
+	sigset_t mask, previous;
+	sigfillset(&mask);
+	sigdelset(&mask, IO_EVENT_WORKER_INTERRUPT);
+	pthread_sigmask(SIG_SETMASK, &mask, &previous);
+	
+	int result = pthread_create(&pool->threads[pool->count], NULL, IO_Event_Worker_Pool_thread, pool);
+	
+	pthread_sigmask(SIG_SETMASK, &previous, NULL);
+	
+	if (result == 0) {
+		pool->count += 1;
+	}
+	
+	return result;
+}
+
+void IO_Event_Worker_Pool_submit(struct IO_Event_Worker_Pool *pool, struct IO_Event_Worker_Job *job)
+{
+	// After forking, none of the threads exist, and the mutex may have been held by one of them:
+	if (pool->pid != getpid()) {
+		pthread_t *threads = pool->threads;
+		IO_Event_Worker_Pool_initialize(pool, pool->interrupt, pool->maximum);
+		pool->threads = threads;
+	}
+	
+	pthread_mutex_lock(&pool->mutex);
+	
+	if (pool->closed) {
+		pthread_mutex_unlock(&pool->mutex);
+		rb_raise(rb_eIOError, "Worker pool is closed!");
+	}
+	
+	if (pool->idle == 0 && pool->count < pool->maximum) {
+		int result = IO_Event_Worker_Pool_spawn(pool);
+		
+		// If we can't create a thread, any existing threads will execute the job. Without any threads, fail before the job is added to the pending list:
+		if (result != 0 && pool->count == 0) {
+			pthread_mutex_unlock(&pool->mutex);
+			rb_syserr_fail(result, "IO_Event_Worker_Pool_spawn:pthread_create");
+		}
+	}
+	
+	job->state = IO_EVENT_WORKER_JOB_PENDING;
+	IO_Event_Worker_List_push(&pool->pending, job);
+	
+	pthread_cond_signal(&pool->condition);
+	
+	pthread_mutex_unlock(&pool->mutex);
+}
+
+struct IO_Event_Worker_Job * IO_Event_Worker_Pool_pop(struct IO_Event_Worker_Pool *pool)
+{
+	struct IO_Event_Worker_Job *job = NULL;
+	
+	pthread_mutex_lock(&pool->mutex);
+	
+	if (pool->completed.head) {
+		job = pool->completed.head;
+		IO_Event_Worker_List_remove(&pool->completed, job);
+		job->state = IO_EVENT_WORKER_JOB_FINISHED;
+	}
+	
+	pthread_mutex_unlock(&pool->mutex);
+	
+	return job;
+}
+
+struct IO_Event_Worker_Pool_cancel_arguments {
+	struct IO_Event_Worker_Pool *pool;
+	struct IO_Event_Worker_Job *job;
+};
+
+// Make any blocking system call in the job fail with `EINTR`. Also used as the unblocking function while waiting, so it must not take the mutex, which the waiting thread holds when it is interrupted.
+static
+void IO_Event_Worker_Pool_cancel_interrupt(void *_arguments)
+{
+	struct IO_Event_Worker_Pool_cancel_arguments *arguments = _arguments;
+	
+	pthread_kill(arguments->job->thread, IO_EVENT_WORKER_INTERRUPT);
+}
+
+static
+void * IO_Event_Worker_Pool_cancel_wait(void *_arguments)
+{
+	struct IO_Event_Worker_Pool_cancel_arguments *arguments = _arguments;
+	
+	while (arguments->job->state == IO_EVENT_WORKER_JOB_RUNNING) {
+		IO_Event_Worker_Pool_cancel_interrupt(arguments);
+		
+		struct timespec deadline;
+		clock_gettime(CLOCK_REALTIME, &deadline);
+		deadline.tv_nsec += IO_EVENT_WORKER_INTERRUPT_INTERVAL;
+		if (deadline.tv_nsec >= 1000000000) {
+			deadline.tv_sec += 1;
+			deadline.tv_nsec -= 1000000000;
+		}
+		
+		pthread_cond_timedwait(&arguments->pool->condition, &arguments->pool->mutex, &deadline);
+	}
+	
+	return NULL;
+}
+
+int IO_Event_Worker_Pool_cancel(struct IO_Event_Worker_Pool *pool, struct IO_Event_Worker_Job *job)
+{
+	int executed = 1;
+	
+	pthread_mutex_lock(&pool->mutex);
+	
+	switch (job->state) {
+		case IO_EVENT_WORKER_JOB_PENDING:
+			IO_Event_Worker_List_remove(&pool->pending, job);
+			executed = 0;
+			break;
+		case IO_EVENT_WORKER_JOB_RUNNING: {
+			// The job refers to memory owned by the caller, so we interrupt it and wait for it to finish:
+			struct IO_Event_Worker_Pool_cancel_arguments arguments = {.pool = pool, .job = job};
+			job->cancelled = 1;
+			rb_thread_call_without_gvl(IO_Event_Worker_Pool_cancel_wait, &arguments, IO_Event_Worker_Pool_cancel_interrupt, &arguments);
+			
+			IO_Event_Worker_List_remove(&pool->completed, job);
+			break;
+		}
+		case IO_EVENT_WORKER_JOB_COMPLETED:
+			IO_Event_Worker_List_remove(&pool->completed, job);
+			break;
+		case IO_EVENT_WORKER_JOB_FINISHED:
+			break;
+	}
+	
+	job->state = IO_EVENT_WORKER_JOB_FINISHED;
+	
+	pthread_mutex_unlock(&pool->mutex);
+	
+	return executed;
+}
+
+void IO_Event_Worker_Pool_close(struct IO_Event_Worker_Pool *pool)
+{
+	// The threads belong to the parent process:
+	if (pool->pid != getpid()) {
+		pool->count = 0;
+		return;
+	}
+	
+	pthread_mutex_lock(&pool->mutex);
+	pool->closed = 1;
+	pthread_cond_broadcast(&pool->condition);
+	pthread_mutex_unlock(&pool->mutex);
+	
+	for (size_t i = 0; i < pool->count; i += 1) {
+		pthread_join(pool->threads[i], NULL);
+	}
+	
+	pool->count = 0;
+}
+
+void IO_Event_Worker_Pool_free(struct IO_Event_Worker_Pool *pool)
+{
+	IO_Event_Worker_Pool_close(pool);
+	
+	if (pool->threads) {
+		xfree(pool->threads);
+		pool->threads = NULL;
+	}
+	
+	pthread_cond_destroy(&pool->condition);
+	pthread_mutex_destroy(&pool->mutex);
+}
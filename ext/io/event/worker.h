@@ -0,0 +1,97 @@
+// Copyright, 2021, by Samuel G. D. Williams. <http://www.codeotaku.com>
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+
+#pragma once
+
+#include <ruby.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#include "interrupt.h"
+
+enum IO_Event_Worker_Job_State {
+	IO_EVENT_WORKER_JOB_PENDING = 1,
+	IO_EVENT_WORKER_JOB_RUNNING = 2,
+	IO_EVENT_WORKER_JOB_COMPLETED = 3,
+	IO_EVENT_WORKER_JOB_FINISHED = 4,
+};
+
+struct IO_Event_Worker_Job;
+
+// Invoked on a worker thread, without the GVL, so it must not use any Ruby APIs:
+typedef void (*IO_Event_Worker_Function)(struct IO_Event_Worker_Job *job);
+
+// A unit of work, which is usually embedded at the start of a larger structure which holds the arguments and results.
+struct IO_Event_Worker_Job {
+	// The job is in at most one list (pending or completed) at a time:
+	struct IO_Event_Worker_Job *previous, *next;
+	
+	enum IO_Event_Worker_Job_State state;
+	
+	IO_Event_Worker_Function function;
+	
+	// The fiber to resume once the job is completed:
+	VALUE fiber;
+	
+	// The thread executing the job, while it is running:
+	pthread_t thread;
+	
+	// Set when the job is cancelled while running. Jobs which retry on `EINTR` should check this and give up instead:
+	volatile int cancelled;
+};
+
+struct IO_Event_Worker_List {
+	struct IO_Event_Worker_Job *head, *tail;
+};
+
+// A pool of native threads which execute blocking operations on behalf of an event loop. Completed jobs are reported back to the event loop by signalling the given interrupt.
+struct IO_Event_Worker_Pool {
+	pthread_mutex_t mutex;
+	pthread_cond_t condition;
+	
+	// Jobs waiting to be executed, and jobs which are waiting for their fibers to be resumed:
+	struct IO_Event_Worker_List pending, completed;
+	
+	struct IO_Event_Interrupt *interrupt;
+	
+	size_t count, maximum, idle;
+	pthread_t *threads;
+	
+	// Threads are not inherited by child processes, so we track which process started them:
+	pid_t pid;
+	
+	int closed;
+};
+
+void IO_Event_Worker_Pool_initialize(struct IO_Event_Worker_Pool *pool, struct IO_Event_Interrupt *interrupt, size_t maximum);
+
+// Stop and join all threads. Jobs which have not started will never be executed.
+void IO_Event_Worker_Pool_close(struct IO_Event_Worker_Pool *pool);
+void IO_Event_Worker_Pool_free(struct IO_Event_Worker_Pool *pool);
+
+// Submit a job for execution, starting a new thread if none are idle.
+void IO_Event_Worker_Pool_submit(struct IO_Event_Worker_Pool *pool, struct IO_Event_Worker_Job *job);
+
+// Take the next completed job, if any, marking it as finished.
+struct IO_Event_Worker_Job * IO_Event_Worker_Pool_pop(struct IO_Event_Worker_Pool *pool);
+
+// Ensure the job is no longer referenced by the pool, e.g. because the waiting fiber was cancelled. If the job is running, it is interrupted, and this waits for it to complete. Returns true if the job was executed.
+int IO_Event_Worker_Pool_cancel(struct IO_Event_Worker_Pool *pool, struct IO_Event_Worker_Job *job);
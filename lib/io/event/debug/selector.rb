@@ -63,8 +63,36 @@ module IO::Event
 				@selector.process_wait(*arguments)
 			end
 			
-			def io_wait(fiber, io, events)
-				@selector.io_wait(fiber, io, events)
+			def process_spawn(...)
+				@selector.process_spawn(...)
+			end
+			
+			def blocking_operation_wait(...)
+				@selector.blocking_operation_wait(...)
+			end
+			
+			def io_wait(...)
+				@selector.io_wait(...)
+			end
+			
+			def io_cancel(...)
+				@selector.io_cancel(...)
+			end
+			
+			def io_close(...)
+				@selector.io_close(...)
+			end
+			
+			def io_wait_many(...)
+				@selector.io_wait_many(...)
+			end
+			
+			def io_select(...)
+				@selector.io_select(...)
+			end
+			
+			def io_accept(...)
+				@selector.io_accept(...)
 			end
 			
 			def io_read(...)
@@ -75,6 +103,74 @@ module IO::Event
 				@selector.io_write(...)
 			end
 			
+			def io_read_until(...)
+				@selector.io_read_until(...)
+			end
+			
+			def io_read_adaptive(...)
+				@selector.io_read_adaptive(...)
+			end
+			
+			def io_write_zerocopy(...)
+				@selector.io_write_zerocopy(...)
+			end
+			
+			def io_recvmsg(...)
+				@selector.io_recvmsg(...)
+			end
+			
+			def io_sendmsg(...)
+				@selector.io_sendmsg(...)
+			end
+			
+			def io_pread(...)
+				@selector.io_pread(...)
+			end
+			
+			def io_pwrite(...)
+				@selector.io_pwrite(...)
+			end
+			
+			def io_readv(...)
+				@selector.io_readv(...)
+			end
+			
+			def io_writev(...)
+				@selector.io_writev(...)
+			end
+			
+			def io_sendfile(...)
+				@selector.io_sendfile(...)
+			end
+			
+			def io_copy(...)
+				@selector.io_copy(...)
+			end
+			
+			def io_fsync(...)
+				@selector.io_fsync(...)
+			end
+			
+			def io_fdatasync(...)
+				@selector.io_fdatasync(...)
+			end
+			
+			def file_open(...)
+				@selector.file_open(...)
+			end
+			
+			def file_stat(...)
+				@selector.file_stat(...)
+			end
+			
+			def file_unlink(...)
+				@selector.file_unlink(...)
+			end
+			
+			def file_rename(...)
+				@selector.file_rename(...)
+			end
+			
 			def respond_to?(name, include_private = false)
 				@selector.respond_to?(name, include_private)
 			end
@@ -0,0 +1,206 @@
+# frozen_string_literal: true
+
+# Released under the MIT License.
+# Copyright, 2021-2022, by Samuel Williams.
+
+module IO::Event
+	# Waits for child processes on behalf of a selector, using a single `SIGCHLD` handler which is shared by all waiting fibers.
+	class Reaper
+		# Whether the platform can notify us when a child process changes state.
+		def self.supported?
+			Signal.list.key?("CHLD")
+		end
+		
+		@reapers = [].freeze
+		@mutex = Thread::Mutex.new
+		@installed = false
+		@previous = nil
+		
+		class << self
+			# Whether the shared signal handler is installed. If child processes are being ignored (and therefore reaped automatically), it is not, and reapers must poll instead.
+			def installed?
+				@installed
+			end
+			
+			# Register a reaper to be signalled when any child process changes state. Installs the shared signal handler if required.
+			def register(reaper)
+				@mutex.synchronize do
+					if @reapers.empty?
+						@previous = Signal.trap(:CHLD) {|signo| handle(signo)}
+						@installed = true
+						
+						# Replacing an ignored handler would stop child processes from being reaped automatically, which the application may depend on:
+						if @previous.nil? or @previous == "IGNORE"
+							Signal.trap(:CHLD, @previous)
+							@installed = false
+						end
+					end
+					
+					# The signal handler can't take a lock, so we replace the array rather than modifying it:
+					@reapers = [*@reapers, reaper].freeze
+				end
+			end
+			
+			# Deregister a reaper, restoring the previous signal handler once there are none left.
+			def deregister(reaper)
+				@mutex.synchronize do
+					reapers = @reapers.reject{|other| other.equal?(reaper)}.freeze
+					
+					if reapers.empty? and !@reapers.empty?
+						Signal.trap(:CHLD, @previous) if @installed
+						
+						@previous = nil
+						@installed = false
+					end
+					
+					@reapers = reapers
+				end
+			end
+			
+			private def handle(signo)
+				@reapers.each(&:signal)
+				
+				# Preserve any existing handler:
+				if @previous.respond_to?(:call)
+					@previous.call(signo)
+				end
+			end
+		end
+		
+		Waiter = Struct.new(:fiber, :pid, :flags, :status, :error) do
+			def finished?
+				self.status or self.error
+			end
+			
+			# Check (without blocking) whether the process has changed state.
+			# @returns [Boolean] If the waiter is finished.
+			def reap
+				return true if finished?
+				
+				if status = ::Process::Status.wait(self.pid, self.flags | ::Process::WNOHANG)
+					self.status = status
+				end
+			rescue SystemCallError => error
+				self.error = error
+			end
+			
+			def result
+				::Kernel.raise self.error if self.error
+				
+				return self.status
+			end
+		end
+		
+		def self.attach(selector)
+			self.new(selector)
+		end
+		
+		def initialize(selector)
+			@selector = selector
+			@waiting = Hash.new.compare_by_identity
+			
+			# Guards the waiting processes and the poller, which is only used if there is no signal handler:
+			@mutex = Thread::Mutex.new
+			@poller = nil
+			
+			@input, @output = ::IO.pipe
+			
+			@closed = false
+			
+			@fiber = Fiber.new do
+				until @closed
+					if @selector.io_wait(@fiber, @input, IO::READABLE)
+						@input.read_nonblock(1024, exception: false)
+						self.reap
+					end
+				end
+			end
+			
+			# We may be attached from any fiber, so start waiting on the next iteration of the event loop:
+			@selector.push(@fiber)
+			
+			self.class.register(self)
+		end
+		
+		# Wait for the given process to change state, transferring to the event loop until it does.
+		def wait(fiber, pid, flags)
+			waiter = Waiter.new(fiber, pid, flags)
+			@mutex.synchronize{@waiting[waiter] = true}
+			
+			# The process may have already changed state before we started waiting, in which case there will be no signal:
+			until waiter.reap
+				poll unless self.class.installed?
+				
+				@selector.transfer
+			end
+			
+			return waiter.result
+		ensure
+			@mutex.synchronize{@waiting.delete(waiter)} if waiter
+		end
+		
+		# How often (in seconds) to check waiting processes if there is no signal handler.
+		POLL_INTERVAL = 0.1
+		
+		# Without a signal handler, wake up the reaper periodically until there are no more waiting processes.
+		private def poll
+			@mutex.synchronize do
+				@poller ||= Thread.new do
+					while true
+						sleep(POLL_INTERVAL)
+						
+						@mutex.synchronize do
+							if @waiting.empty?
+								@poller = nil
+								break
+							end
+						end
+						
+						self.signal
+					end
+				end
+			end
+		end
+		
+		# Invoked from the signal handler (on any thread), so it must not block or take any locks.
+		def signal
+			@output.write_nonblock(".", exception: false)
+		rescue IOError
+			# Ignore.
+		end
+		
+		# Check all waiting processes, resuming the fibers of the ones which have changed state.
+		def reap
+			@mutex.synchronize do
+				@waiting.each_key do |waiter|
+					# Fibers which have already been resumed should not be resumed again:
+					next if waiter.finished?
+					
+					if waiter.reap
+						@selector.push(waiter.fiber)
+					end
+				end
+			end
+		end
+		
+		def close
+			self.class.deregister(self)
+			
+			@mutex.synchronize do
+				@poller&.kill
+				@poller = nil
+			end
+			
+			# Stop the reaper fiber, which is otherwise left waiting on the pipe forever (`Fiber#kill` requires Ruby 3.3):
+			@closed = true
+			if @fiber.alive? and @fiber.respond_to?(:kill)
+				@fiber.kill
+			end
+			
+			@input.close
+			@output.close
+		end
+	end
+	
+	private_constant :Reaper
+end
@@ -8,6 +8,12 @@ require_relative 'debug/selector'
 require_relative 'support'
 
 module IO::Event
+	# May be requested in addition to `IO::READABLE`, `IO::PRIORITY` and `IO::WRITABLE`, in which case a hangup (including the peer shutting down its side of the connection) is reported separately. Selectors which can't distinguish hangups report them as `IO::READABLE`.
+	HANGUP = 16
+	
+	# May be requested in the same way as `HANGUP`, in which case a pending error is reported separately.
+	ERROR = 8
+	
 	module Selector
 		def self.default(env = ENV)
 			if name = env['IO_EVENT_SELECTOR']&.to_sym
@@ -24,6 +30,8 @@ module IO::Event
 				EPoll
 			elsif self.const_defined?(:KQueue)
 				KQueue
+			elsif self.const_defined?(:Poll)
+				Poll
 			else
 				Select
 			end
@@ -13,5 +13,14 @@ module IO::Event
 			# Windows.
 			yield
 		end
+		
+		def self.notsent_lowat(io, size)
+			io.setsockopt(::Socket::IPPROTO_TCP, ::Socket::TCP_NOTSENT_LOWAT, size)
+			
+			return true
+		rescue NameError, SystemCallError
+			# Only TCP sockets support this option, and not on every platform.
+			return false
+		end
 	end
 end
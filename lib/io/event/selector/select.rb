@@ -4,6 +4,7 @@
 # Copyright, 2021-2022, by Samuel Williams.
 
 require_relative '../interrupt'
+require_relative '../reaper'
 require_relative '../support'
 
 module IO::Event
@@ -35,6 +36,7 @@ module IO::Event
 			
 			def close
 				@interrupt.close
+				@reaper&.close
 				
 				@loop = nil
 				@waiting = nil
@@ -109,7 +111,7 @@ module IO::Event
 						
 						fiber.transfer(events & self.events) if fiber.alive?
 					end
-				
+					
 					self.tail&.transfer(events)
 				end
 				
@@ -153,8 +155,8 @@ module IO::Event
 					
 					Selector.nonblock(io) do
 						while true
-							maximum_size = buffer.size - offset
-							result = Fiber.blocking{buffer.read(io, maximum_size, offset)}
+							# A length of zero performs a single system call. Any larger length is the minimum to transfer, and a partial transfer followed by `EAGAIN` would be reported as a failure:
+							result = Fiber.blocking{buffer.read(io, 0, offset)}
 							
 							if again?(result)
 								if length > 0
@@ -164,6 +166,8 @@ module IO::Event
 								end
 							elsif result < 0
 								return result
+							elsif result == 0
+								break
 							else
 								total += result
 								offset += result
@@ -180,12 +184,11 @@ module IO::Event
 					
 					Selector.nonblock(io) do
 						while true
-							maximum_size = buffer.size - offset
-							result = Fiber.blocking{buffer.write(io, maximum_size, offset)}
+							result = Fiber.blocking{buffer.write(io, 0, offset)}
 							
 							if again?(result)
 								if length > 0
-									self.io_wait(fiber, io, IO::READABLE)
+									self.io_wait(fiber, io, IO::WRITABLE)
 								else
 									return result
 								end
@@ -285,9 +288,14 @@ module IO::Event
 			end
 			
 			def process_wait(fiber, pid, flags)
-				Thread.new do
-					Process::Status.wait(pid, flags)
-				end.value
+				if Reaper.supported?
+					@reaper ||= Reaper.attach(self)
+					@reaper.wait(fiber, pid, flags)
+				else
+					Thread.new do
+						Process::Status.wait(pid, flags)
+					end.value
+				end
 			end
 			
 			private def pop_ready
@@ -315,7 +323,8 @@ module IO::Event
 				
 				@waiting.each do |io, waiter|
 					waiter.each do |fiber, events|
-						if (events & IO::READABLE) > 0
+						# Hangups and errors can only be detected by attempting to read:
+						if (events & (IO::READABLE | HANGUP | ERROR)) > 0
 							readable << io
 						end
 						
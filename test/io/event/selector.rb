@@ -9,6 +9,8 @@ require 'io/event/debug/selector'
 
 require 'socket'
 require 'fiber'
+require 'io/nonblock'
+require 'tempfile'
 
 require 'unix_socket'
 
@@ -115,6 +117,63 @@ Selector = Sus::Shared("a selector") do
 			]
 		end
 		
+		it "can wait for the peer to hang up" do
+			skip "Selector can't distinguish hangups!" if selector.is_a?(IO::Event::Selector::Select)
+			
+			result = nil
+			
+			fiber = Fiber.new do
+				result = selector.io_wait(Fiber.current, local, IO::READABLE | IO::Event::HANGUP)
+			end
+			
+			fiber.transfer
+			
+			remote.close
+			
+			while fiber.alive?
+				selector.select(1)
+			end
+			
+			expect(result & IO::Event::HANGUP).to be == IO::Event::HANGUP
+			expect(result & IO::READABLE).to be == IO::READABLE
+		end
+		
+		it "doesn't report hangups unless requested" do
+			result = nil
+			
+			fiber = Fiber.new do
+				result = selector.io_wait(Fiber.current, local, IO::READABLE)
+			end
+			
+			fiber.transfer
+			
+			remote.close
+			
+			while fiber.alive?
+				selector.select(1)
+			end
+			
+			expect(result).to be == IO::READABLE
+		end
+		
+		it "can wait for an io with a timeout" do
+			skip "Selector does not support timeouts!" unless selector.method(:io_wait).arity < 0
+			
+			result = nil
+			
+			fiber = Fiber.new do
+				result = selector.io_wait(Fiber.current, local, IO::READABLE, 0.01)
+			end
+			
+			fiber.transfer
+			
+			while fiber.alive?
+				selector.select(1)
+			end
+			
+			expect(result).to be == false
+		end
+		
 		it "can wait for an io to become writable" do
 			fiber = Fiber.new do
 				events << :wait_writable
@@ -253,7 +312,7 @@ Selector = Sus::Shared("a selector") do
 		
 		it "can read a single message" do
 			return unless selector.respond_to?(:io_read)
-
+			
 			fiber = Fiber.new do
 				events << :io_read
 				offset = selector.io_read(Fiber.current, local, buffer, message.bytesize)
@@ -272,9 +331,27 @@ Selector = Sus::Shared("a selector") do
 			]
 		end
 		
+		it "can read with a timeout" do
+			skip "Selector does not support timeouts!" unless selector.method(:io_wait).arity < 0
+			
+			result = nil
+			
+			fiber = Fiber.new do
+				result = selector.io_read(Fiber.current, local, buffer, message.bytesize, 0, 0.01)
+			end
+			
+			fiber.transfer
+			
+			while fiber.alive?
+				selector.select(1)
+			end
+			
+			expect(result).to be == -Errno::ETIMEDOUT::Errno
+		end
+		
 		it "can handle partial reads" do
 			return unless selector.respond_to?(:io_read)
-
+			
 			fiber = Fiber.new do
 				events << :io_read
 				offset = selector.io_read(Fiber.current, local, buffer, message.bytesize)
@@ -293,6 +370,23 @@ Selector = Sus::Shared("a selector") do
 				:io_read, :write
 			]
 		end
+		
+		it "can read from a blocking socket without changing its mode" do
+			return unless selector.respond_to?(:io_read)
+			
+			local.nonblock = false
+			
+			fiber = Fiber.new do
+				offset = selector.io_read(Fiber.current, local, buffer, message.bytesize)
+				expect(buffer.get_string(0, offset)).to be == message
+				expect(local).not.to be(:nonblock?)
+			end
+			
+			fiber.transfer
+			
+			remote.write(message)
+			selector.select(1)
+		end
 	end
 	
 	with '#io_write' do
@@ -304,7 +398,7 @@ Selector = Sus::Shared("a selector") do
 		
 		it "can write a single message" do
 			return unless selector.respond_to?(:io_write)
-
+			
 			fiber = Fiber.new do
 				events << :io_write
 				buffer = IO::Buffer.for(message.dup)
@@ -324,72 +418,905 @@ Selector = Sus::Shared("a selector") do
 				:io_write, :read
 			]
 		end
+		
+		it "waits until the socket is writable" do
+			return unless selector.respond_to?(:io_write)
+			
+			# More than the socket buffers can hold, so the write must wait for the peer to read:
+			message = "." * 1024 * 1024
+			result = nil
+			
+			fiber = Fiber.new do
+				buffer = IO::Buffer.for(message)
+				result = selector.io_write(Fiber.current, local, buffer, buffer.size)
+			end
+			
+			fiber.transfer
+			expect(fiber).to be(:alive?)
+			
+			received = String.new
+			
+			while fiber.alive? or received.bytesize < message.bytesize
+				selector.select(0)
+				
+				while chunk = remote.read_nonblock(64 * 1024, exception: false) and chunk.is_a?(String)
+					received << chunk
+				end
+			end
+			
+			expect(result).to be == message.bytesize
+			expect(received.bytesize).to be == message.bytesize
+		end
 	end
 	
-	with '#process_wait' do
-		it "can wait for a process which has terminated already" do
+	with '#io_read_until' do
+		let(:sockets) {UNIXSocket.pair}
+		let(:local) {sockets.first}
+		let(:remote) {sockets.last}
+		
+		let(:buffer) {IO::Buffer.new(64)}
+		
+		it "reads until the delimiter arrives" do
+			return unless selector.respond_to?(:io_read_until)
+			
 			result = nil
-			events = []
 			
 			fiber = Fiber.new do
-				pid = Process.spawn("true")
-				result = selector.process_wait(Fiber.current, pid, 0)
-				expect(result).to be(:success?)
-				events << :process_finished
+				result = selector.io_read_until(Fiber.current, local, buffer, "\r\n", buffer.size)
 			end
 			
 			fiber.transfer
 			
+			# The delimiter straddles the two writes:
+			remote.write("GET foo\r")
+			selector.select(0.1)
+			expect(fiber).to be(:alive?)
+			
+			remote.write("\nGET")
+			
 			while fiber.alive?
 				selector.select(1)
 			end
 			
-			expect(events).to be == [:process_finished]
-			expect(result.success?).to be == true
+			expect(result).to be == [7, 12]
+			expect(buffer.get_string(0, 7)).to be == "GET foo"
+			
+			# The data following the delimiter is moved to the start of the buffer and searched before reading again:
+			buffer.copy(buffer, 0, 3, 9)
+			remote.write(" bar\r\n")
+			
+			fiber = Fiber.new do
+				result = selector.io_read_until(Fiber.current, local, buffer, "\r\n", buffer.size, 3)
+			end
+			
+			fiber.transfer
+			
+			while fiber.alive?
+				selector.select(1)
+			end
+			
+			expect(result).to be == [7, 9]
+			expect(buffer.get_string(0, 7)).to be == "GET bar"
 		end
 		
-		it "can wait for a process to terminate" do
+		it "stops at the end of the stream or the maximum length" do
+			return unless selector.respond_to?(:io_read_until)
+			
+			results = []
+			
+			fiber = Fiber.new do
+				results << selector.io_read_until(Fiber.current, local, buffer, "\n", 4)
+				results << selector.io_read_until(Fiber.current, local, buffer, "\n", buffer.size)
+			end
+			
+			remote.write("Hello World")
+			remote.close
+			
+			fiber.transfer
+			
+			while fiber.alive?
+				selector.select(1)
+			end
+			
+			expect(results).to be == [[nil, 4], [nil, 7]]
+		end
+	end
+	
+	with '#io_read_adaptive' do
+		let(:sockets) {UNIXSocket.pair}
+		let(:local) {sockets.first}
+		let(:remote) {sockets.last}
+		
+		it "grows the buffer to fit the pending data" do
+			return unless selector.respond_to?(:io_read_adaptive)
+			
+			buffer = IO::Buffer.new(16)
+			message = "." * 2000
+			results = []
+			
+			fiber = Fiber.new do
+				results << selector.io_read_adaptive(Fiber.current, local, buffer, 4096)
+				expect(buffer.size).to be == 2000
+				expect(buffer.get_string(0, 2000)).to be == message
+				
+				results << selector.io_read_adaptive(Fiber.current, local, buffer, 4096, 2000)
+			end
+			
+			fiber.transfer
+			remote.write(message)
+			
+			selector.select(1)
+			expect(results).to be == [2000]
+			
+			# The buffer can't grow beyond the maximum size:
+			remote.write(message * 2)
+			
+			while fiber.alive?
+				selector.select(1)
+			end
+			
+			expect(results).to be == [2000, 2096]
+			expect(buffer.size).to be == 4096
+		end
+		
+		it "doesn't read beyond the maximum into a larger buffer" do
+			return unless selector.respond_to?(:io_read_adaptive)
+			
+			buffer = IO::Buffer.new(4096)
 			result = nil
-			events = []
 			
 			fiber = Fiber.new do
-				pid = Process.spawn("sleep 0.1")
-				result = selector.process_wait(Fiber.current, pid, 0)
-				expect(result).to be(:success?)
-				events << :process_finished
+				result = selector.io_read_adaptive(Fiber.current, local, buffer, 1024)
 			end
 			
 			fiber.transfer
+			remote.write("." * 2000)
 			
 			while fiber.alive?
 				selector.select(1)
 			end
 			
-			expect(events).to be == [:process_finished]
-			expect(result).to be(:success?)
+			expect(result).to be == 1024
+			expect(local.read_nonblock(4096).bytesize).to be == 976
 		end
 	end
-end
-
-IO::Event::Selector.constants.each do |name|
-	klass = IO::Event::Selector.const_get(name)
 	
-	describe(klass, unique: name) do
-		with '.new' do
-			let(:count) {8}
-			let(:loop) {Fiber.current}
+	with '#io_readv' do
+		let(:sockets) {UNIXSocket.pair}
+		let(:local) {sockets.first}
+		let(:remote) {sockets.last}
+		
+		it "can read into several buffers" do
+			return unless selector.respond_to?(:io_readv)
 			
-			it "can create multiple selectors" do
-				selectors = count.times.map do |i|
-					subject.new(loop)
+			buffers = [IO::Buffer.new(6), IO::Buffer.new(1024)]
+			
+			fiber = Fiber.new do
+				result = selector.io_readv(Fiber.current, local, buffers, 11)
+				expect(result).to be == 11
+				expect(buffers[0].get_string).to be == "Hello "
+				expect(buffers[1].get_string(0, 5)).to be == "World"
+			end
+			
+			fiber.transfer
+			
+			remote.write("Hello ")
+			selector.select(1)
+			remote.write("World")
+			selector.select(1)
+			
+			expect(fiber).not.to be(:alive?)
+		end
+	end
+	
+	with '#io_writev' do
+		let(:sockets) {UNIXSocket.pair}
+		let(:local) {sockets.first}
+		let(:remote) {sockets.last}
+		
+		it "can write several buffers" do
+			return unless selector.respond_to?(:io_writev)
+			
+			fiber = Fiber.new do
+				buffers = [IO::Buffer.for(+"Hello "), IO::Buffer.for(+"World").slice(0, 5)]
+				result = selector.io_writev(Fiber.current, local, buffers, 11)
+				expect(result).to be == 11
+				local.close
+			end
+			
+			fiber.transfer
+			
+			selector.select(1)
+			
+			expect(remote.read).to be == "Hello World"
+		end
+	end
+	
+	with '#io_cancel' do
+		let(:pipe) {IO.pipe}
+		let(:input) {pipe.first}
+		let(:output) {pipe.last}
+		
+		it "wakes every fiber waiting on the io" do
+			return unless selector.respond_to?(:io_cancel)
+			
+			errors = []
+			
+			fibers = 2.times.map do
+				Fiber.new do
+					selector.io_wait(Fiber.current, input, IO::READABLE)
+				rescue Errno::ECANCELED => error
+					errors << error
 				end
-				
-				expect(selectors.size).to be == count
-				
-				selectors.each(&:close)
 			end
+			
+			fibers.each(&:transfer)
+			
+			expect(selector.io_cancel(input)).to be == 2
+			expect(selector.io_cancel(input)).to be == 0
+			
+			while fibers.any?(&:alive?)
+				selector.select(1)
+			end
+			
+			expect(errors.size).to be == 2
+		ensure
+			input.close
+			output.close
 		end
-
+		
+		it "fails reads with ECANCELED" do
+			return unless selector.respond_to?(:io_cancel)
+			
+			result = nil
+			
+			fiber = Fiber.new do
+				buffer = IO::Buffer.new(64)
+				result = selector.io_read(Fiber.current, input, buffer, 1)
+			end
+			
+			fiber.transfer
+			
+			expect(selector.io_cancel(input)).to be == 1
+			
+			while fiber.alive?
+				selector.select(1)
+			end
+			
+			expect(result).to be == -Errno::ECANCELED::Errno
+		ensure
+			input.close
+			output.close
+		end
+	end
+	
+	with '#io_wait_many' do
+		let(:pipe) {IO.pipe}
+		let(:input) {pipe.first}
+		let(:output) {pipe.last}
+		
+		it "resumes once with the first ready io" do
+			return unless selector.respond_to?(:io_wait_many)
+			
+			other = IO.pipe
+			result = nil
+			
+			fiber = Fiber.new do
+				result = selector.io_wait_many(Fiber.current, [[other.first, IO::READABLE], [input, IO::READABLE]])
+			end
+			
+			fiber.transfer
+			expect(fiber).to be(:alive?)
+			
+			output.write("Hello World")
+			
+			while fiber.alive?
+				selector.select(1)
+			end
+			
+			expect(result).to be == [input, IO::READABLE]
+			
+			# The remaining registrations should have been removed, so waiting again works as normal:
+			other.last.write("Hello World")
+			
+			fiber = Fiber.new do
+				result = selector.io_wait(Fiber.current, other.first, IO::READABLE)
+			end
+			
+			fiber.transfer
+			
+			while fiber.alive?
+				selector.select(1)
+			end
+			
+			expect(result).to be == IO::READABLE
+		ensure
+			other&.each(&:close)
+			input.close
+			output.close
+		end
+		
+		it "can time out" do
+			return unless selector.respond_to?(:io_wait_many)
+			
+			other = IO.pipe
+			result = :pending
+			
+			fiber = Fiber.new do
+				result = selector.io_wait_many(Fiber.current, [[other.first, IO::READABLE], [input, IO::READABLE]], 0.01)
+			end
+			
+			fiber.transfer
+			
+			while fiber.alive?
+				selector.select(1)
+			end
+			
+			expect(result).to be == false
+		ensure
+			other&.each(&:close)
+			input.close
+			output.close
+		end
+		
+		it "rejects an empty list of ios" do
+			return unless selector.respond_to?(:io_wait_many)
+			
+			fiber = Fiber.new do
+				expect do
+					selector.io_wait_many(Fiber.current, [])
+				end.to raise_exception(ArgumentError)
+			end
+			
+			fiber.transfer
+			
+			expect(fiber).not.to be(:alive?)
+		end
+	end
+	
+	with '#io_select' do
+		let(:pipe) {IO.pipe}
+		let(:input) {pipe.first}
+		let(:output) {pipe.last}
+		
+		it "can wait for any of several ios" do
+			return unless selector.respond_to?(:io_select)
+			skip "Selector blocks the event loop while waiting!" if selector.is_a?(IO::Event::Selector::Select)
+			
+			other = IO.pipe
+			result = nil
+			
+			fiber = Fiber.new do
+				result = selector.io_select([other.first, input], nil, nil, 1)
+			end
+			
+			fiber.transfer
+			expect(fiber).to be(:alive?)
+			
+			output.write("Hello World")
+			
+			while fiber.alive?
+				selector.select(1)
+			end
+			
+			expect(result).to be == [[input], [], []]
+		ensure
+			other&.each(&:close)
+			input.close
+			output.close
+		end
+		
+		it "can time out" do
+			return unless selector.respond_to?(:io_select)
+			
+			result = :pending
+			
+			fiber = Fiber.new do
+				result = selector.io_select([input], nil, nil, 0.01)
+			end
+			
+			fiber.transfer
+			
+			while fiber.alive?
+				selector.select(1)
+			end
+			
+			expect(result).to be_nil
+		ensure
+			input.close
+			output.close
+		end
+	end
+	
+	with '#io_accept' do
+		let(:server) {TCPServer.new('127.0.0.1', 0)}
+		let(:port) {server.local_address.ip_port}
+		
+		it "can accept several pending connections" do
+			return unless selector.respond_to?(:io_accept)
+			
+			clients = 3.times.map{TCPSocket.new('127.0.0.1', port)}
+			peers = []
+			
+			fiber = Fiber.new do
+				clients.size.times do
+					peers << selector.io_accept(Fiber.current, server)
+				end
+			end
+			
+			fiber.transfer
+			
+			while fiber.alive?
+				selector.select(1)
+			end
+			
+			expect(peers.size).to be == 3
+			expect(peers.map(&:class).uniq).to be == [Socket]
+			
+			clients.each_with_index do |client, index|
+				client.write(index.to_s)
+				client.close
+			end
+			
+			expect(peers.map(&:read).sort).to be == ["0", "1", "2"]
+		ensure
+			clients&.each(&:close)
+			peers&.each(&:close)
+			server.close
+		end
+	end
+	
+	with '#io_write_zerocopy' do
+		let(:server) {TCPServer.new('127.0.0.1', 0)}
+		let(:local) {TCPSocket.new('127.0.0.1', server.local_address.ip_port)}
+		let(:remote) {server.accept}
+		
+		it "can write a large buffer" do
+			return unless selector.respond_to?(:io_write_zerocopy)
+			
+			size = 1024 * 256
+			buffer = IO::Buffer.new(size)
+			buffer.set_string("." * size)
+			
+			result = nil
+			
+			# Connect before accepting:
+			local
+			remote
+			
+			fiber = Fiber.new do
+				result = selector.io_write_zerocopy(Fiber.current, local, buffer, size, 0)
+				local.close
+			end
+			
+			fiber.transfer
+			
+			data = String.new
+			
+			while fiber.alive?
+				selector.select(0)
+				
+				while chunk = remote.read_nonblock(size, exception: false) and chunk.is_a?(String)
+					data << chunk
+				end
+			end
+			
+			data << remote.read
+			
+			expect(result).to be == size
+			expect(data.bytesize).to be == size
+			expect(buffer.locked?).to be == false
+		ensure
+			server.close
+		end
+	end
+	
+	with '#io_recvmsg' do
+		let(:receiver) {UDPSocket.new.tap{|socket| socket.bind('127.0.0.1', 0)}}
+		let(:sender) {UDPSocket.new.tap{|socket| socket.bind('127.0.0.1', 0)}}
+		
+		it "can send and receive several datagrams at once" do
+			return unless selector.respond_to?(:io_recvmsg)
+			
+			address = receiver.local_address
+			messages = ["Hello", "World", "!"].map{|string| [IO::Buffer.for(string), string.bytesize, address]}
+			buffers = 4.times.map{IO::Buffer.new(64)}
+			
+			sent = received = nil
+			
+			fiber = Fiber.new do
+				sent = selector.io_sendmsg(Fiber.current, sender, messages)
+				received = selector.io_recvmsg(Fiber.current, receiver, buffers)
+			end
+			
+			fiber.transfer
+			
+			while fiber.alive?
+				selector.select(1)
+			end
+			
+			expect(sent).to be == 3
+			expect(received.size).to be == 3
+			expect(received.map{|length, _| length}).to be == [5, 5, 1]
+			expect(buffers.first.get_string(0, 5)).to be == "Hello"
+			expect(received.first[1].ip_port).to be == sender.local_address.ip_port
+		ensure
+			receiver.close
+			sender.close
+		end
+		
+		it "can send and receive segmented datagrams" do
+			return unless selector.respond_to?(:io_recvmsg)
+			
+			# UDP_GRO, which is not defined by the socket extension:
+			receiver.setsockopt(Socket::IPPROTO_UDP, 104, 1)
+			
+			data = "." * 3000
+			buffers = 4.times.map{IO::Buffer.new(4096)}
+			
+			sent = received = nil
+			
+			fiber = Fiber.new do
+				sent = selector.io_sendmsg(Fiber.current, sender, [[IO::Buffer.for(data), data.bytesize, receiver.local_address, 1000]])
+				received = selector.io_recvmsg(Fiber.current, receiver, buffers)
+			end
+			
+			fiber.transfer
+			
+			while fiber.alive?
+				selector.select(1)
+			end
+			
+			expect(sent).to be == 1
+			
+			# The datagrams are coalesced on receipt, so we get them back as a single buffer with the segment size:
+			expect(received.map{|length, _, segment_size| [length, segment_size]}).to be == [[3000, 1000]]
+		ensure
+			receiver.close
+			sender.close
+		end
+	end
+	
+	with '#io_sendfile' do
+		let(:sockets) {UNIXSocket.pair}
+		let(:local) {sockets.first}
+		let(:remote) {sockets.last}
+		let(:file) {Tempfile.new}
+		
+		it "can send part of a file" do
+			return unless selector.respond_to?(:io_sendfile)
+			
+			file.write("Hello World")
+			file.flush
+			
+			fiber = Fiber.new do
+				result = selector.io_sendfile(Fiber.current, local, file, 6, 5)
+				expect(result).to be == 5
+				local.close
+			end
+			
+			fiber.transfer
+			
+			while fiber.alive?
+				selector.select(1)
+			end
+			
+			expect(remote.read).to be == "World"
+			expect(file.pos).to be == 11
+		end
+	end
+	
+	with '#io_copy' do
+		let(:input) {UNIXSocket.pair}
+		let(:output) {UNIXSocket.pair}
+		
+		it "can copy from one socket to another" do
+			return unless selector.respond_to?(:io_copy)
+			
+			result = nil
+			
+			fiber = Fiber.new do
+				result = selector.io_copy(Fiber.current, input.first, output.first, nil)
+				output.first.close
+			end
+			
+			fiber.transfer
+			
+			input.last.write("Hello ")
+			selector.select(1)
+			input.last.write("World")
+			input.last.close
+			
+			while fiber.alive?
+				selector.select(1)
+			end
+			
+			expect(result).to be == 11
+			expect(output.last.read).to be == "Hello World"
+		end
+		
+		it "can copy a limited amount of data" do
+			return unless selector.respond_to?(:io_copy)
+			
+			input.last.write("Hello World")
+			
+			fiber = Fiber.new do
+				expect(selector.io_copy(Fiber.current, input.first, output.first, 5)).to be == 5
+				output.first.close
+			end
+			
+			fiber.transfer
+			
+			while fiber.alive?
+				selector.select(1)
+			end
+			
+			expect(output.last.read).to be == "Hello"
+			expect(input.first.read_nonblock(1024)).to be == " World"
+		end
+	end
+	
+	with '#process_wait' do
+		it "can wait for a process which has terminated already" do
+			result = nil
+			events = []
+			
+			fiber = Fiber.new do
+				pid = Process.spawn("true")
+				result = selector.process_wait(Fiber.current, pid, 0)
+				expect(result).to be(:success?)
+				events << :process_finished
+			end
+			
+			fiber.transfer
+			
+			while fiber.alive?
+				selector.select(1)
+			end
+			
+			expect(events).to be == [:process_finished]
+			expect(result.success?).to be == true
+		end
+		
+		it "can wait for a process to terminate" do
+			result = nil
+			events = []
+			
+			fiber = Fiber.new do
+				pid = Process.spawn("sleep 0.1")
+				result = selector.process_wait(Fiber.current, pid, 0)
+				expect(result).to be(:success?)
+				events << :process_finished
+			end
+			
+			fiber.transfer
+			
+			while fiber.alive?
+				selector.select(1)
+			end
+			
+			expect(events).to be == [:process_finished]
+			expect(result).to be(:success?)
+		end
+		
+		it "can wait for a process with a timeout" do
+			skip "Selector does not support timeouts!" unless selector.method(:process_wait).arity < 0
+			
+			pid = Process.spawn("sleep 1")
+			result = :pending
+			
+			fiber = Fiber.new do
+				result = selector.process_wait(Fiber.current, pid, 0, 0.01)
+			end
+			
+			fiber.transfer
+			
+			while fiber.alive?
+				selector.select(1)
+			end
+			
+			expect(result).to be_nil
+		ensure
+			if pid
+				Process.kill(:KILL, pid)
+				Process.wait(pid)
+			end
+		end
+		
+		it "can wait for a process to stop" do
+			pid = Process.spawn("sleep 10")
+			Process.kill(:STOP, pid)
+			
+			# A stopped process can only be noticed by checking its status, so make sure it has stopped before we start waiting:
+			sleep 0.1
+			
+			result = nil
+			
+			fiber = Fiber.new do
+				result = selector.process_wait(Fiber.current, pid, Process::WUNTRACED)
+			end
+			
+			fiber.transfer
+			
+			while fiber.alive?
+				selector.select(1)
+			end
+			
+			expect(result).to be(:stopped?)
+		ensure
+			if pid
+				Process.kill(:KILL, pid)
+				Process.wait(pid)
+			end
+		end
+		
+		it "can wait for several processes concurrently" do
+			results = []
+			
+			fibers = 8.times.map do
+				Fiber.new do
+					pid = Process.spawn("sleep 0.1")
+					results << selector.process_wait(Fiber.current, pid, 0)
+				end
+			end
+			
+			fibers.each(&:transfer)
+			
+			while fibers.any?(&:alive?)
+				selector.select(1)
+			end
+			
+			expect(results.size).to be == 8
+			expect(results.all?(&:success?)).to be == true
+		end
+		
+		it "preserves an existing SIGCHLD handler" do
+			signals = Thread::Queue.new
+			previous = Signal.trap(:CHLD) {|signo| signals << signo}
+			
+			fiber = Fiber.new do
+				pid = Process.spawn("sleep 0.1")
+				expect(selector.process_wait(Fiber.current, pid, 0)).to be(:success?)
+			end
+			
+			fiber.transfer
+			
+			while fiber.alive?
+				selector.select(1)
+			end
+			
+			expect(signals.pop(timeout: 1)).to be == Signal.list["CHLD"]
+		ensure
+			Signal.trap(:CHLD, previous)
+		end
+		
+		it "restores the SIGCHLD handler when closed" do
+			handler = proc{}
+			previous = Signal.trap(:CHLD, handler)
+			
+			fiber = Fiber.new do
+				pid = Process.spawn("true")
+				selector.process_wait(Fiber.current, pid, 0)
+			end
+			
+			fiber.transfer
+			
+			while fiber.alive?
+				selector.select(1)
+			end
+			
+			@selector.close
+			@selector = nil
+			
+			expect(Signal.trap(:CHLD, previous)).to be(:equal?, handler)
+		end
+		
+		it "can wait for a process while SIGCHLD is ignored" do
+			previous = Signal.trap(:CHLD, "IGNORE")
+			result = :pending
+			
+			fiber = Fiber.new do
+				pid = Process.spawn("sleep 0.1")
+				
+				# The process may be reaped automatically before we can get its status:
+				begin
+					result = selector.process_wait(Fiber.current, pid, 0)
+				rescue Errno::ECHILD
+					result = nil
+				end
+			end
+			
+			fiber.transfer
+			
+			while fiber.alive?
+				selector.select(1)
+			end
+			
+			expect(result).not.to be == :pending
+			expect(Signal.trap(:CHLD, previous)).to be == "IGNORE"
+		end
+	end
+	
+	with '#process_spawn' do
+		it "can spawn and wait for a process" do
+			skip "Selector does not support process_spawn!" unless selector.respond_to?(:process_spawn)
+			
+			result = nil
+			
+			fiber = Fiber.new do
+				pid = selector.process_spawn(Fiber.current, "sleep", "0.1", out: File::NULL)
+				result = selector.process_wait(Fiber.current, pid, 0)
+			end
+			
+			fiber.transfer
+			
+			while fiber.alive?
+				selector.select(1)
+			end
+			
+			expect(result).to be(:success?)
+		end
+		
+		it "closes the pidfds of processes which were reaped elsewhere" do
+			skip "Selector does not support process_spawn!" unless selector.respond_to?(:process_spawn)
+			skip "Can't count open descriptors!" unless File.directory?("/proc/self/fd")
+			
+			# Stale pidfds are discarded once there are enough of them:
+			pids = 16.times.map do
+				selector.process_spawn(Fiber.current, "true")
+			end
+			
+			pids.each{|pid| Process.wait(pid)}
+			
+			# Finalizers of unrelated IOs could otherwise close descriptors while we are counting:
+			GC.start
+			GC.disable
+			
+			begin
+				count = Dir.children("/proc/self/fd").size
+				
+				pid = selector.process_spawn(Fiber.current, "true")
+				expect(Dir.children("/proc/self/fd").size).to be == count - pids.size + 1
+			ensure
+				GC.enable
+			end
+			
+			result = nil
+			
+			fiber = Fiber.new do
+				result = selector.process_wait(Fiber.current, pid, 0)
+			end
+			
+			fiber.transfer
+			
+			while fiber.alive?
+				selector.select(1)
+			end
+			
+			expect(result).to be(:success?)
+		end
+	end
+end
+
+IO::Event::Selector.constants.each do |name|
+	klass = IO::Event::Selector.const_get(name)
+	
+	describe(klass, unique: name) do
+		with '.new' do
+			let(:count) {8}
+			let(:loop) {Fiber.current}
+			
+			it "can create multiple selectors" do
+				selectors = count.times.map do |i|
+					subject.new(loop)
+				end
+				
+				expect(selectors.size).to be == count
+				
+				selectors.each(&:close)
+			end
+		end
+		
 		with 'an instance' do
 			def before
 				@loop = Fiber.current
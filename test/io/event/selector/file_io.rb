@@ -6,6 +6,8 @@
 require 'io/event'
 require 'io/event/selector'
 require 'tempfile'
+require 'tmpdir'
+require 'fileutils'
 
 FileIO = Sus::Shared("file io") do
 	with 'a file' do
@@ -25,7 +27,152 @@ FileIO = Sus::Shared("file io") do
 			end
 			
 			writer.transfer
+			
+			# Depending on the selector, file operations may complete asynchronously:
+			while writer.alive?
+				selector.select(1)
+			end
+			
 			reader.transfer
+			
+			while reader.alive?
+				selector.select(1)
+			end
+			
+			expect(writer).not.to be(:alive?)
+			expect(reader).not.to be(:alive?)
+		end
+		
+		it "can read from a file in several fibers concurrently" do
+			file.write("Hello World")
+			file.flush
+			
+			fibers = 4.times.map do
+				Fiber.new do
+					File.open(file.path) do |io|
+						buffer = IO::Buffer.new(64)
+						expect(selector.io_read(Fiber.current, io, buffer, 11)).to be == 11
+						expect(buffer.get_string(0, 11)).to be == "Hello World"
+					end
+				end
+			end
+			
+			fibers.each(&:transfer)
+			
+			while fibers.any?(&:alive?)
+				selector.select(1)
+			end
+		end
+		
+		it "can read a file which reuses the descriptor of a closed pipe" do
+			skip "Selector does not support io_close!" unless selector.respond_to?(:io_close)
+			
+			file.write("Hello World")
+			file.flush
+			
+			input, output = IO.pipe
+			output.write("Hello")
+			
+			fiber = Fiber.new do
+				buffer = IO::Buffer.new(64)
+				expect(selector.io_read(Fiber.current, input, buffer, 5)).to be == 5
+			end
+			
+			fiber.transfer
+			
+			descriptor = input.fileno
+			
+			# The selector may close the descriptor itself:
+			input.autoclose = false if selector.io_close(input)
+			input.close
+			output.close
+			
+			File.open(file.path) do |io|
+				skip "The descriptor was not reused!" unless io.fileno == descriptor
+				
+				fiber = Fiber.new do
+					buffer = IO::Buffer.new(64)
+					expect(selector.io_read(Fiber.current, io, buffer, 11)).to be == 11
+					expect(buffer.get_string(0, 11)).to be == "Hello World"
+				end
+				
+				fiber.transfer
+				
+				while fiber.alive?
+					selector.select(1)
+				end
+			end
+		end
+		
+		it "can read and write at a specific offset" do
+			skip "Selector does not support io_pread/io_pwrite!" unless selector.respond_to?(:io_pread)
+			
+			file.write("Hello World")
+			file.flush
+			file.seek(0)
+			
+			fiber = Fiber.new do
+				buffer = IO::Buffer.for(+"Ruby!")
+				expect(selector.io_pwrite(Fiber.current, file, buffer, 6, 5, 0)).to be == 5
+				
+				buffer = IO::Buffer.new(16)
+				expect(selector.io_pread(Fiber.current, file, buffer, 6, 5, 0)).to be == 5
+				expect(buffer.get_string(0, 5)).to be == "Ruby!"
+			end
+			
+			fiber.transfer
+			
+			while fiber.alive?
+				selector.select(1)
+			end
+			
+			# Positioned operations don't change the file position:
+			expect(file.pos).to be == 0
+			expect(file.read).to be == "Hello Ruby!"
+		end
+		
+		it "can write and read several buffers" do
+			return unless selector.respond_to?(:io_writev)
+			
+			fiber = Fiber.new do
+				buffers = [IO::Buffer.for(+"Hello "), IO::Buffer.for(+"World")]
+				expect(selector.io_writev(Fiber.current, file, buffers, 11)).to be == 11
+				
+				file.seek(0)
+				
+				buffers = [IO::Buffer.new(5), IO::Buffer.new(6)]
+				expect(selector.io_readv(Fiber.current, file, buffers, 11)).to be == 11
+				expect(buffers.map(&:get_string).join).to be == "Hello World"
+			end
+			
+			fiber.transfer
+			
+			while fiber.alive?
+				selector.select(1)
+			end
+		end
+		
+		it "can coalesce concurrent fsync requests" do
+			skip "File operations are not supported" unless selector.respond_to?(:io_fsync)
+			
+			results = []
+			
+			fibers = 8.times.map do |index|
+				Fiber.new do
+					file.write("Entry #{index}\n")
+					file.flush
+					
+					results << (index.even? ? selector.io_fsync(Fiber.current, file) : selector.io_fdatasync(Fiber.current, file))
+				end
+			end
+			
+			fibers.each(&:transfer)
+			
+			while fibers.any?(&:alive?)
+				selector.select(1)
+			end
+			
+			expect(results).to be == [0] * 8
 		end
 		
 		it "can wait for the file to become writable" do
@@ -40,6 +187,79 @@ FileIO = Sus::Shared("file io") do
 			selector.select(0)
 		end
 	end
+	
+	with 'a path' do
+		let(:directory) {Dir.mktmpdir}
+		let(:file_path) {File.join(directory, "file.txt")}
+		
+		def after
+			FileUtils.rm_rf(directory)
+			super
+		end
+		
+		it "can open, sync, stat, rename and unlink files" do
+			skip "File operations are not supported" unless selector.respond_to?(:file_open)
+			
+			other = File.join(directory, "other.txt")
+			
+			fiber = Fiber.new do
+				file = selector.file_open(Fiber.current, file_path, File::CREAT | File::WRONLY, 0644)
+				file.write("Hello World")
+				file.flush
+				
+				expect(selector.io_fsync(Fiber.current, file)).to be == 0
+				expect(selector.io_fdatasync(Fiber.current, file)).to be == 0
+				file.close
+				
+				expect(selector.file_stat(Fiber.current, file_path).size).to be == 11
+				
+				selector.file_rename(Fiber.current, file_path, other)
+				expect(File.exist?(other)).to be == true
+				
+				selector.file_unlink(Fiber.current, other)
+				expect(File.exist?(other)).to be == false
+				
+				expect do
+					selector.file_stat(Fiber.current, other)
+				end.to raise_exception(Errno::ENOENT)
+			end
+			
+			fiber.transfer
+			
+			while fiber.alive?
+				selector.select(1)
+			end
+		end
+		
+		it "can cancel opening a file which never becomes ready" do
+			skip "File operations are not supported" unless selector.respond_to?(:file_open)
+			skip "Named pipes are not supported" unless File.respond_to?(:mkfifo)
+			
+			# Opening a named pipe for reading blocks until there is a writer:
+			File.mkfifo(file_path)
+			
+			error = nil
+			
+			fiber = Fiber.new do
+				selector.file_open(Fiber.current, file_path, File::RDONLY, 0)
+			rescue Interrupt => error
+				# Expected.
+			end
+			
+			fiber.transfer
+			selector.select(0.01)
+			
+			start_time = Process.clock_gettime(Process::CLOCK_MONOTONIC)
+			fiber.raise(Interrupt) if fiber.alive?
+			
+			while fiber.alive?
+				selector.select(0.01)
+			end
+			
+			expect(error).to be_a(Interrupt)
+			expect(Process.clock_gettime(Process::CLOCK_MONOTONIC) - start_time).to be < 1.0
+		end
+	end
 end
 
 IO::Event::Selector.constants.each do |name|
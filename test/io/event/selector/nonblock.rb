@@ -6,6 +6,7 @@
 require 'io/event'
 require 'io/nonblock'
 require 'io/event/selector'
+require 'socket'
 
 describe IO::Event::Selector do
 	with '.nonblock' do
@@ -30,4 +31,27 @@ describe IO::Event::Selector do
 			expect(executed).to be == true
 		end
 	end
+	
+	with '.notsent_lowat' do
+		it "limits the unsent data of a TCP socket" do
+			skip "TCP_NOTSENT_LOWAT is only checked on Linux!" unless RUBY_PLATFORM =~ /linux/
+			
+			server = TCPServer.new('127.0.0.1', 0)
+			client = TCPSocket.new('127.0.0.1', server.local_address.ip_port)
+			
+			expect(IO::Event::Selector.notsent_lowat(client, 16*1024)).to be == true
+			
+			# Ruby doesn't define `Socket::TCP_NOTSENT_LOWAT`, so use the value from `<netinet/tcp.h>`:
+			expect(client.getsockopt(Socket::IPPROTO_TCP, 25).int).to be == 16*1024
+		ensure
+			client&.close
+			server&.close
+		end
+		
+		it "ignores other kinds of IO" do
+			UNIXSocket.pair do |input, output|
+				expect(IO::Event::Selector.notsent_lowat(input, 16*1024)).to be == false
+			end
+		end
+	end
 end